@@ -19,7 +19,26 @@
 // # error Do not compile Asio library source with ASIO_HEADER_ONLY defined
 // #endif
 
+#include "abnet/buffer_chain.ipp"
+#include "abnet/buffer_pool.ipp"
+#include "abnet/coroutine.ipp"
+#include "abnet/dns_cache.ipp"
+#include "abnet/dns_resolver.ipp"
+#include "abnet/epoll_reactor.ipp"
+#include "abnet/eventfd_interrupter.ipp"
+#include "abnet/hugepage_arena.ipp"
+#include "abnet/io_uring_buffer_ring.ipp"
+#include "abnet/io_uring_proactor.ipp"
+#include "abnet/io_uring_registry.ipp"
+#include "abnet/mirrored_ring_buffer.ipp"
+#include "abnet/numa.ipp"
+#include "abnet/sharded_acceptor.ipp"
 #include "abnet/socket_ops.ipp"
+#include "abnet/splice_relay.ipp"
+#include "abnet/stream_writer.ipp"
+#include "abnet/thread_pool.ipp"
+#include "abnet/timer_wheel.ipp"
 #include "abnet/winsock_init.ipp"
+#include "abnet/zerocopy_sender.ipp"
 
 #endif // ABNET_IMPL_SRC_HPP
\ No newline at end of file
@@ -0,0 +1,148 @@
+//
+// buffer_chain.hpp
+// ~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_BUFFER_CHAIN_HPP
+#define ABNET_BUFFER_CHAIN_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#include "abnet/buffer_pool.hpp"
+#include "abnet/error.hpp"
+#include "abnet/socket_ops.hpp"
+#include "abnet/socket_types.hpp"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// A sequence of bytes held as a chain of slices over reference counted
+// blocks. Copying a chain, appending one chain to another and splitting a
+// chain share the blocks rather than copying the bytes, so a message that
+// arrived over several receives can be handed around without being gathered
+// into one string. Bytes are only copied when a parser asks for a contiguous
+// run that spans slices.
+//
+// Blocks come from a buffer_pool when one is given, and from the heap
+// otherwise or when larger than the pool's largest class. A chain must not be
+// used from two threads at once, but chains sharing blocks may be.
+class buffer_chain {
+public:
+  // Constructor. Blocks are taken from pool if it is not null. The pool must
+  // outlive every chain sharing its blocks.
+  ABNET_DECL explicit buffer_chain(buffer_pool *pool = 0);
+
+  // Copy constructor. Shares the blocks of other.
+  ABNET_DECL buffer_chain(const buffer_chain &other);
+
+  // Move constructor.
+  ABNET_DECL buffer_chain(buffer_chain &&other);
+
+  ABNET_DECL ~buffer_chain();
+
+  ABNET_DECL buffer_chain &operator=(const buffer_chain &other);
+
+  ABNET_DECL buffer_chain &operator=(buffer_chain &&other);
+
+  // The number of bytes in the chain.
+  std::size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  // The number of slices the bytes are spread over.
+  std::size_t slice_count() const { return slices_.size(); }
+
+  // Copy data onto the end of the chain, filling the last block first if no
+  // other chain shares it.
+  ABNET_DECL void append(const void *data, std::size_t size, abnet::error_code &ec);
+
+  // Share the bytes of other onto the end of the chain.
+  ABNET_DECL void append(const buffer_chain &other);
+
+  // Writable space of at least size bytes at the end of the chain, for recv()
+  // to fill. Returns an empty buffer with ec set on failure.
+  ABNET_DECL socket_ops::buf prepare(std::size_t size, abnet::error_code &ec);
+
+  // Add n bytes written into the space returned by prepare().
+  ABNET_DECL void commit(std::size_t n);
+
+  // Drop bytes from the front of the chain.
+  ABNET_DECL void consume(std::size_t n);
+
+  // Remove the first n bytes and return them as a chain sharing the blocks.
+  ABNET_DECL buffer_chain split(std::size_t n);
+
+  // Fill bufs with the slices, for a gathering send(). Returns the number of
+  // buffers filled, at most count.
+  ABNET_DECL std::size_t to_bufs(socket_ops::buf *bufs, std::size_t count) const;
+
+  // The first n bytes as one contiguous run, copying them into a new block
+  // only if they span slices. Returns 0 with ec set if the chain is shorter
+  // than n or memory ran out. The pointer is valid until the chain is next
+  // modified.
+  ABNET_DECL const char *contiguous(std::size_t n, abnet::error_code &ec);
+
+  // Copy the first size bytes out, returning the number copied.
+  ABNET_DECL std::size_t copy_to(void *data, std::size_t size) const;
+
+  // The number of times contiguous() had to copy.
+  std::size_t coalesces() const { return coalesces_; }
+
+  // Drop every byte.
+  ABNET_DECL void clear();
+
+private:
+  struct block {
+    std::atomic<std::size_t> refs_;
+    char *data_;
+    std::size_t capacity_;
+    buffer_pool *pool_;
+  };
+
+  struct slice {
+    block *block_;
+    std::size_t offset_;
+    std::size_t length_;
+  };
+
+  // Allocate a block of at least size bytes, or 0 if memory ran out. Small
+  // requests get a whole page so that later appends can fill it.
+  ABNET_DECL block *new_block(std::size_t size);
+
+  ABNET_DECL static void add_ref(block *b);
+
+  ABNET_DECL static void release(block *b);
+
+  // The free space after the last slice that this chain alone may write to.
+  ABNET_DECL std::size_t tail_space() const;
+
+  buffer_pool *pool_;
+  std::vector<slice> slices_;
+  std::size_t size_;
+  std::size_t coalesces_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/buffer_chain.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#endif // ABNET_BUFFER_CHAIN_HPP
@@ -0,0 +1,294 @@
+//
+// buffer_chain.ipp
+// ~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_BUFFER_CHAIN_IPP
+#define ABNET_BUFFER_CHAIN_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#include <cstring>
+#include <new>
+#include <utility>
+
+#include "abnet/buffer_chain.hpp"
+#include "abnet/error.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+namespace buffer_chain_ops {
+
+enum { min_block_size = 4096 };
+
+} // namespace buffer_chain_ops
+
+buffer_chain::buffer_chain(buffer_pool *pool) : pool_(pool), size_(0), coalesces_(0) {}
+
+buffer_chain::buffer_chain(const buffer_chain &other)
+    : pool_(other.pool_), slices_(other.slices_), size_(other.size_), coalesces_(0) {
+  for (std::size_t i = 0; i < slices_.size(); ++i)
+    add_ref(slices_[i].block_);
+}
+
+buffer_chain::buffer_chain(buffer_chain &&other)
+    : pool_(other.pool_), slices_(std::move(other.slices_)), size_(other.size_), coalesces_(other.coalesces_) {
+  other.slices_.clear();
+  other.size_ = 0;
+}
+
+buffer_chain::~buffer_chain() { clear(); }
+
+buffer_chain &buffer_chain::operator=(const buffer_chain &other) {
+  if (this != &other) {
+    buffer_chain copy(other);
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+buffer_chain &buffer_chain::operator=(buffer_chain &&other) {
+  if (this != &other) {
+    clear();
+    pool_ = other.pool_;
+    slices_.swap(other.slices_);
+    size_ = other.size_;
+    coalesces_ = other.coalesces_;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+void buffer_chain::append(const void *data, std::size_t size, abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  const char *p = static_cast<const char *>(data);
+  while (size > 0) {
+    std::size_t space = tail_space();
+    if (space == 0) {
+      block *b = new_block(size);
+      if (!b) {
+        ec = abnet::error::no_memory;
+        return;
+      }
+      slice s = {b, 0, 0};
+      slices_.push_back(s);
+      space = b->capacity_;
+    }
+
+    slice &last = slices_.back();
+    std::size_t n = size < space ? size : space;
+    std::memcpy(last.block_->data_ + last.offset_ + last.length_, p, n);
+    last.length_ += n;
+    size_ += n;
+    p += n;
+    size -= n;
+  }
+}
+
+void buffer_chain::append(const buffer_chain &other) {
+  // Copy first, in case other is this chain.
+  std::vector<slice> slices(other.slices_);
+  std::size_t size = other.size_;
+  for (std::size_t i = 0; i < slices.size(); ++i) {
+    add_ref(slices[i].block_);
+    slices_.push_back(slices[i]);
+  }
+  size_ += size;
+}
+
+socket_ops::buf buffer_chain::prepare(std::size_t size, abnet::error_code &ec) {
+  socket_ops::buf result;
+  std::size_t space = tail_space();
+  if (space == 0 || space < size) {
+    block *b = new_block(size);
+    if (!b) {
+      ec = abnet::error::no_memory;
+      socket_ops::init_buf(result, static_cast<void *>(0), 0);
+      return result;
+    }
+    slice s = {b, 0, 0};
+    slices_.push_back(s);
+    space = b->capacity_;
+  }
+
+  abnet::error::clear(ec);
+  const slice &last = slices_.back();
+  socket_ops::init_buf(result, last.block_->data_ + last.offset_ + last.length_, space);
+  return result;
+}
+
+void buffer_chain::commit(std::size_t n) {
+  if (slices_.empty())
+    return;
+  slice &last = slices_.back();
+  std::size_t space = tail_space();
+  last.length_ += n < space ? n : space;
+  size_ += n < space ? n : space;
+
+  // Drop a block that prepare() added and nothing was written to.
+  if (last.length_ == 0) {
+    release(last.block_);
+    slices_.pop_back();
+  }
+}
+
+void buffer_chain::consume(std::size_t n) {
+  std::size_t i = 0;
+  for (; i < slices_.size() && n > 0 && n >= slices_[i].length_; ++i) {
+    n -= slices_[i].length_;
+    size_ -= slices_[i].length_;
+    release(slices_[i].block_);
+  }
+  slices_.erase(slices_.begin(), slices_.begin() + i);
+  if (!slices_.empty() && n > 0) {
+    slices_.front().offset_ += n;
+    slices_.front().length_ -= n;
+    size_ -= n;
+  }
+}
+
+buffer_chain buffer_chain::split(std::size_t n) {
+  buffer_chain front(pool_);
+  std::size_t i = 0;
+  for (; i < slices_.size() && n > 0 && n >= slices_[i].length_; ++i) {
+    n -= slices_[i].length_;
+    front.slices_.push_back(slices_[i]);
+    front.size_ += slices_[i].length_;
+  }
+  slices_.erase(slices_.begin(), slices_.begin() + i);
+  size_ -= front.size_;
+
+  // Both chains keep a slice of a block the boundary falls in.
+  if (!slices_.empty() && n > 0) {
+    slice &s = slices_.front();
+    slice head = {s.block_, s.offset_, n};
+    add_ref(s.block_);
+    front.slices_.push_back(head);
+    front.size_ += n;
+    s.offset_ += n;
+    s.length_ -= n;
+    size_ -= n;
+  }
+  return front;
+}
+
+std::size_t buffer_chain::to_bufs(socket_ops::buf *bufs, std::size_t count) const {
+  std::size_t filled = 0;
+  for (std::size_t i = 0; i < slices_.size() && filled < count; ++i) {
+    const slice &s = slices_[i];
+    if (s.length_ > 0)
+      socket_ops::init_buf(bufs[filled++], s.block_->data_ + s.offset_, s.length_);
+  }
+  return filled;
+}
+
+const char *buffer_chain::contiguous(std::size_t n, abnet::error_code &ec) {
+  if (n > size_) {
+    ec = abnet::error::invalid_argument;
+    return 0;
+  }
+  abnet::error::clear(ec);
+  if (slices_.empty())
+    return "";
+  if (slices_.front().length_ >= n)
+    return slices_.front().block_->data_ + slices_.front().offset_;
+
+  block *b = new_block(n);
+  if (!b) {
+    ec = abnet::error::no_memory;
+    return 0;
+  }
+  copy_to(b->data_, n);
+  consume(n);
+  slice s = {b, 0, n};
+  slices_.insert(slices_.begin(), s);
+  size_ += n;
+  ++coalesces_;
+  return b->data_;
+}
+
+std::size_t buffer_chain::copy_to(void *data, std::size_t size) const {
+  char *p = static_cast<char *>(data);
+  std::size_t copied = 0;
+  for (std::size_t i = 0; i < slices_.size() && copied < size; ++i) {
+    const slice &s = slices_[i];
+    std::size_t n = s.length_ < size - copied ? s.length_ : size - copied;
+    std::memcpy(p + copied, s.block_->data_ + s.offset_, n);
+    copied += n;
+  }
+  return copied;
+}
+
+void buffer_chain::clear() {
+  for (std::size_t i = 0; i < slices_.size(); ++i)
+    release(slices_[i].block_);
+  slices_.clear();
+  size_ = 0;
+}
+
+buffer_chain::block *buffer_chain::new_block(std::size_t size) {
+  block *b = new (std::nothrow) block;
+  if (!b)
+    return 0;
+  b->refs_.store(1, std::memory_order_relaxed);
+  b->data_ = 0;
+  b->pool_ = 0;
+  if (size < buffer_chain_ops::min_block_size)
+    size = buffer_chain_ops::min_block_size;
+
+  abnet::error_code ec;
+  buffer_pool::size_class c = buffer_pool::class_of(size, ec);
+  if (pool_ && !ec) {
+    b->data_ = static_cast<char *>(pool_->allocate(size, ec));
+    b->capacity_ = buffer_pool::class_size(c);
+    b->pool_ = pool_;
+  } else {
+    b->data_ = new (std::nothrow) char[size];
+    b->capacity_ = size;
+  }
+  if (!b->data_) {
+    delete b;
+    return 0;
+  }
+  return b;
+}
+
+void buffer_chain::add_ref(block *b) { b->refs_.fetch_add(1, std::memory_order_relaxed); }
+
+void buffer_chain::release(block *b) {
+  if (b->refs_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    return;
+  if (b->pool_)
+    b->pool_->deallocate(b->data_, b->capacity_);
+  else
+    delete[] b->data_;
+  delete b;
+}
+
+std::size_t buffer_chain::tail_space() const {
+  if (slices_.empty())
+    return 0;
+  const slice &last = slices_.back();
+  if (last.block_->refs_.load(std::memory_order_acquire) != 1)
+    return 0;
+  return last.block_->capacity_ - last.offset_ - last.length_;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#endif // ABNET_BUFFER_CHAIN_IPP
@@ -0,0 +1,151 @@
+//
+// buffer_pool.hpp
+// ~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_BUFFER_POOL_HPP
+#define ABNET_BUFFER_POOL_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#include "abnet/error.hpp"
+#include "abnet/noncopyable.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// A pool of I/O buffers in three size classes: 4K, 16K and 64K. Buffers are
+// carved out of 256K slabs and are aligned to 4K, so they can be handed
+// straight to socket_ops::init_buf.
+//
+// Each thread keeps a small cache of free buffers per size class, so that
+// allocating and releasing a buffer normally takes no lock. A thread whose
+// cache runs dry takes a batch from the pool's shared free lists, and one
+// whose cache overflows gives a batch back. Buffers may be released on any
+// thread. Memory is only returned to the system when the pool and every
+// thread that used it have gone.
+//
+// With poisoning on, released buffers are filled with a pattern which is
+// checked when the buffer is handed out again, catching writes made through
+// a stale pointer.
+class buffer_pool : private noncopyable {
+public:
+  enum size_class { small_buffer = 0, medium_buffer = 1, large_buffer = 2, size_class_count = 3 };
+
+  enum { slab_size = 262144, default_thread_cache = 32, poison_byte = 0xdd };
+
+  // Constructor. thread_cache is the most free buffers of each size class a
+  // thread keeps for itself.
+  ABNET_DECL explicit buffer_pool(std::size_t thread_cache = default_thread_cache, bool poison = false);
+
+  // Destructor. Buffers still cached by other threads are freed when those
+  // threads exit.
+  ABNET_DECL ~buffer_pool();
+
+  // The size class of a buffer able to hold size bytes. Sets ec to
+  // invalid_argument if size is larger than the largest class.
+  ABNET_DECL static size_class class_of(std::size_t size, abnet::error_code &ec);
+
+  // The capacity of the buffers in a size class.
+  static std::size_t class_size(size_class c) { return std::size_t(4096) << (2 * c); }
+
+  // Get a buffer of at least size bytes, or 0 with ec set on failure. The
+  // usable capacity is class_size(class_of(size)).
+  ABNET_DECL void *allocate(std::size_t size, abnet::error_code &ec);
+
+  // Release a buffer obtained from allocate(). size must be the size passed
+  // to allocate(), or any size of the same class.
+  ABNET_DECL void deallocate(void *p, std::size_t size);
+
+  // The number of buffers of a class currently handed out.
+  std::size_t in_use(size_class c) const { return depot_->classes_[c].in_use_.load(std::memory_order_relaxed); }
+
+  // The most buffers of a class that have been handed out at once.
+  std::size_t high_water(size_class c) const {
+    return depot_->classes_[c].high_water_.load(std::memory_order_relaxed);
+  }
+
+  // The number of buffers of a class carved out of slabs so far.
+  ABNET_DECL std::size_t buffers_created(size_class c) const;
+
+  // The number of times a released buffer was found to have been written to.
+  std::size_t poison_faults() const { return depot_->poison_faults_.load(std::memory_order_relaxed); }
+
+  // Whether released buffers are poisoned.
+  bool poisoning() const { return depot_->poison_; }
+
+private:
+  // The state shared by the pool and the thread caches, which may outlive
+  // the pool itself.
+  struct depot {
+    ABNET_DECL depot(std::size_t thread_cache, bool poison);
+    ABNET_DECL ~depot();
+
+    struct class_state {
+      class_state() : created_(0), in_use_(0), high_water_(0) {}
+
+      // Guarded by depot::mutex_.
+      std::vector<void *> free_;
+      std::size_t created_;
+
+      std::atomic<std::size_t> in_use_;
+      std::atomic<std::size_t> high_water_;
+    };
+
+    std::size_t thread_cache_;
+    bool poison_;
+    std::atomic<bool> closed_;
+    std::atomic<std::size_t> poison_faults_;
+
+    std::mutex mutex_;
+    std::vector<void *> slabs_;
+    class_state classes_[size_class_count];
+  };
+
+  // The free buffers a thread holds for one pool.
+  struct thread_cache {
+    std::shared_ptr<depot> depot_;
+    std::vector<void *> free_[size_class_count];
+  };
+
+  struct thread_caches;
+
+  // The calling thread's cache for this pool.
+  ABNET_DECL thread_cache &local_cache();
+
+  // Move a batch of free buffers from the depot into a thread cache, carving
+  // a new slab if needed. Returns false if memory ran out.
+  ABNET_DECL static bool refill(depot &d, size_class c, std::vector<void *> &cache);
+
+  // Move the buffers beyond keep from a thread cache back to the depot.
+  ABNET_DECL static void drain(depot &d, size_class c, std::vector<void *> &cache, std::size_t keep);
+
+  std::shared_ptr<depot> depot_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/buffer_pool.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#endif // ABNET_BUFFER_POOL_HPP
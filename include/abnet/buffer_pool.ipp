@@ -0,0 +1,194 @@
+//
+// buffer_pool.ipp
+// ~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_BUFFER_POOL_IPP
+#define ABNET_BUFFER_POOL_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#include <cstring>
+#include <new>
+
+#include "abnet/buffer_pool.hpp"
+#include "abnet/error.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+namespace buffer_pool_ops {
+
+enum { buffer_alignment = 4096 };
+
+inline bool is_poisoned(const void *p, std::size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(p);
+  for (std::size_t i = 0; i < size; ++i)
+    if (bytes[i] != buffer_pool::poison_byte)
+      return false;
+  return true;
+}
+
+} // namespace buffer_pool_ops
+
+// The caches of every pool the thread has used. Each cache is handed back to
+// its depot when the thread exits.
+struct buffer_pool::thread_caches {
+  ~thread_caches() {
+    for (std::size_t i = 0; i < caches_.size(); ++i)
+      for (int c = 0; c < size_class_count; ++c)
+        drain(*caches_[i].depot_, size_class(c), caches_[i].free_[c], 0);
+  }
+
+  std::vector<thread_cache> caches_;
+};
+
+buffer_pool::depot::depot(std::size_t thread_cache, bool poison)
+    : thread_cache_(thread_cache), poison_(poison), closed_(false), poison_faults_(0) {}
+
+buffer_pool::depot::~depot() {
+  for (std::size_t i = 0; i < slabs_.size(); ++i)
+    ::operator delete(slabs_[i], std::align_val_t(buffer_pool_ops::buffer_alignment));
+}
+
+buffer_pool::buffer_pool(std::size_t thread_cache, bool poison)
+    : depot_(std::make_shared<depot>(thread_cache, poison)) {}
+
+buffer_pool::~buffer_pool() { depot_->closed_.store(true, std::memory_order_release); }
+
+buffer_pool::size_class buffer_pool::class_of(std::size_t size, abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  for (int c = 0; c < size_class_count; ++c)
+    if (size <= class_size(size_class(c)))
+      return size_class(c);
+  ec = abnet::error::invalid_argument;
+  return large_buffer;
+}
+
+void *buffer_pool::allocate(std::size_t size, abnet::error_code &ec) {
+  size_class c = class_of(size, ec);
+  if (ec)
+    return 0;
+
+  std::vector<void *> &cache = local_cache().free_[c];
+  if (cache.empty() && !refill(*depot_, c, cache)) {
+    ec = abnet::error::no_memory;
+    return 0;
+  }
+  void *p = cache.back();
+  cache.pop_back();
+
+  if (depot_->poison_ && !buffer_pool_ops::is_poisoned(p, class_size(c)))
+    depot_->poison_faults_.fetch_add(1, std::memory_order_relaxed);
+
+  depot::class_state &state = depot_->classes_[c];
+  std::size_t in_use = state.in_use_.fetch_add(1, std::memory_order_relaxed) + 1;
+  std::size_t high_water = state.high_water_.load(std::memory_order_relaxed);
+  while (in_use > high_water && !state.high_water_.compare_exchange_weak(high_water, in_use)) {
+  }
+  return p;
+}
+
+void buffer_pool::deallocate(void *p, std::size_t size) {
+  abnet::error_code ec;
+  size_class c = class_of(size, ec);
+  if (!p || ec)
+    return;
+
+  if (depot_->poison_)
+    std::memset(p, poison_byte, class_size(c));
+  depot_->classes_[c].in_use_.fetch_sub(1, std::memory_order_relaxed);
+
+  std::vector<void *> &cache = local_cache().free_[c];
+  cache.push_back(p);
+  if (cache.size() > depot_->thread_cache_)
+    drain(*depot_, c, cache, depot_->thread_cache_ / 2);
+}
+
+std::size_t buffer_pool::buffers_created(size_class c) const {
+  std::lock_guard<std::mutex> lock(depot_->mutex_);
+  return depot_->classes_[c].created_;
+}
+
+buffer_pool::thread_cache &buffer_pool::local_cache() {
+  static thread_local thread_caches caches;
+
+  thread_cache *found = 0;
+  for (std::size_t i = 0; i < caches.caches_.size();) {
+    thread_cache &tc = caches.caches_[i];
+    if (tc.depot_ == depot_) {
+      found = &tc;
+      ++i;
+    } else if (tc.depot_->closed_.load(std::memory_order_acquire)) {
+      // Let go of the caches of pools that have been destroyed.
+      for (int c = 0; c < size_class_count; ++c)
+        drain(*tc.depot_, size_class(c), tc.free_[c], 0);
+      caches.caches_.erase(caches.caches_.begin() + i);
+      found = 0;
+      i = 0;
+    } else {
+      ++i;
+    }
+  }
+  if (found)
+    return *found;
+
+  caches.caches_.push_back(thread_cache());
+  caches.caches_.back().depot_ = depot_;
+  return caches.caches_.back();
+}
+
+bool buffer_pool::refill(depot &d, size_class c, std::vector<void *> &cache) {
+  std::lock_guard<std::mutex> lock(d.mutex_);
+  depot::class_state &state = d.classes_[c];
+  if (state.free_.empty()) {
+    void *slab = ::operator new(slab_size, std::align_val_t(buffer_pool_ops::buffer_alignment), std::nothrow);
+    if (!slab)
+      return false;
+    d.slabs_.push_back(slab);
+    if (d.poison_)
+      std::memset(slab, poison_byte, slab_size);
+
+    // Hand out the start of the slab first.
+    std::size_t count = slab_size / class_size(c);
+    for (std::size_t i = count; i > 0; --i)
+      state.free_.push_back(static_cast<char *>(slab) + (i - 1) * class_size(c));
+    state.created_ += count;
+  }
+
+  std::size_t batch = d.thread_cache_ / 2 > 0 ? d.thread_cache_ / 2 : 1;
+  for (; batch > 0 && !state.free_.empty(); --batch) {
+    cache.push_back(state.free_.back());
+    state.free_.pop_back();
+  }
+  return true;
+}
+
+void buffer_pool::drain(depot &d, size_class c, std::vector<void *> &cache, std::size_t keep) {
+  if (cache.size() <= keep)
+    return;
+  // Give back the least recently released buffers, keeping the warm ones.
+  std::vector<void *>::iterator end = cache.end() - keep;
+  std::lock_guard<std::mutex> lock(d.mutex_);
+  std::vector<void *> &free_list = d.classes_[c].free_;
+  free_list.insert(free_list.end(), cache.begin(), end);
+  cache.erase(cache.begin(), end);
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#endif // ABNET_BUFFER_POOL_IPP
@@ -0,0 +1,252 @@
+//
+// coroutine.hpp
+// ~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_COROUTINE_HPP
+#define ABNET_COROUTINE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_CO_AWAIT) && defined(ABNET_HAS_STD_COROUTINE) && defined(ABNET_HAS_EPOLL)
+
+#include "abnet/epoll_reactor.hpp"
+#include "abnet/error.hpp"
+#include "abnet/socket_ops.hpp"
+#include "abnet/socket_types.hpp"
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// Recycles coroutine frames through per-thread free lists, one per 64 byte
+// size class, so that a steady state of coroutines does not touch the heap.
+// Frames larger than max_pooled_size are allocated directly.
+class coro_frame_pool {
+public:
+  enum { granularity = 64, max_pooled_size = 4096 };
+
+  ABNET_DECL static void *allocate(std::size_t size);
+
+  ABNET_DECL static void deallocate(void *p, std::size_t size);
+
+  // The number of allocations on the calling thread served from a free list.
+  ABNET_DECL static std::size_t hits();
+
+  // The number of allocations on the calling thread that reached the heap.
+  ABNET_DECL static std::size_t misses();
+};
+
+// The return type of a detached coroutine. The coroutine starts running when
+// called and its frame is released once it finishes.
+class coro_task {
+public:
+  struct promise_type {
+    coro_task get_return_object() { return coro_task(); }
+
+    std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+
+    std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+
+    void return_void() {}
+
+    void unhandled_exception() { std::terminate(); }
+
+    static void *operator new(std::size_t size) { return coro_frame_pool::allocate(size); }
+
+    static void operator delete(void *p, std::size_t size) { coro_frame_pool::deallocate(p, size); }
+  };
+};
+
+// The result of an awaited receive or send.
+struct io_result {
+  abnet::error_code ec;
+  std::size_t bytes_transferred;
+};
+
+// The result of an awaited accept.
+struct accept_result {
+  abnet::error_code ec;
+  socket_type new_socket;
+};
+
+// Common part of the awaitables. The awaitable is itself the reactor
+// operation, so it lives in the coroutine frame and suspending allocates
+// nothing. When the operation completes, the coroutine is resumed from the
+// reactor's event loop.
+class reactor_awaitable : public reactor_op {
+public:
+  reactor_awaitable(epoll_reactor &reactor, epoll_reactor::per_descriptor_data &data)
+      : reactor_(reactor), data_(data) {}
+
+  ~reactor_awaitable() {}
+
+  void complete() { handle_.resume(); }
+
+  void destroy() { handle_.destroy(); }
+
+protected:
+  // Whether the operation may be tried inline without overtaking queued ones.
+  bool may_try_inline(int op_type) const {
+    return data_ && !data_->shutdown_ && data_->op_queue_[op_type].empty() &&
+           (op_type != epoll_reactor::read_op || data_->op_queue_[epoll_reactor::except_op].empty());
+  }
+
+  void suspend(int op_type, std::coroutine_handle<> handle) {
+    handle_ = handle;
+    reactor_.start_op(op_type, data_, this, false);
+  }
+
+  epoll_reactor &reactor_;
+  epoll_reactor::per_descriptor_data &data_;
+  std::coroutine_handle<> handle_;
+};
+
+class recv_awaitable : public reactor_awaitable {
+public:
+  recv_awaitable(epoll_reactor &reactor, epoll_reactor::per_descriptor_data &data, socket_ops::buf *bufs,
+                 std::size_t count, int flags, bool is_stream)
+      : reactor_awaitable(reactor, data), bufs_(bufs), count_(count), flags_(flags), is_stream_(is_stream) {}
+
+  bool perform() {
+    return socket_ops::non_blocking_recv(data_->descriptor_, bufs_, count_, flags_, is_stream_, ec_,
+                                         bytes_transferred_);
+  }
+
+  bool await_ready() { return may_try_inline(epoll_reactor::read_op) && perform(); }
+
+  void await_suspend(std::coroutine_handle<> handle) { suspend(epoll_reactor::read_op, handle); }
+
+  io_result await_resume() { return io_result{ec_, bytes_transferred_}; }
+
+private:
+  socket_ops::buf *bufs_;
+  std::size_t count_;
+  int flags_;
+  bool is_stream_;
+};
+
+class send_awaitable : public reactor_awaitable {
+public:
+  send_awaitable(epoll_reactor &reactor, epoll_reactor::per_descriptor_data &data, const socket_ops::buf *bufs,
+                 std::size_t count, int flags)
+      : reactor_awaitable(reactor, data), bufs_(bufs), count_(count), flags_(flags) {}
+
+  bool perform() {
+    return socket_ops::non_blocking_send(data_->descriptor_, bufs_, count_, flags_, ec_, bytes_transferred_);
+  }
+
+  bool await_ready() { return may_try_inline(epoll_reactor::write_op) && perform(); }
+
+  void await_suspend(std::coroutine_handle<> handle) { suspend(epoll_reactor::write_op, handle); }
+
+  io_result await_resume() { return io_result{ec_, bytes_transferred_}; }
+
+private:
+  const socket_ops::buf *bufs_;
+  std::size_t count_;
+  int flags_;
+};
+
+class accept_awaitable : public reactor_awaitable {
+public:
+  accept_awaitable(epoll_reactor &reactor, epoll_reactor::per_descriptor_data &data, socket_ops::state_type state,
+                   void *addr, std::size_t *addrlen)
+      : reactor_awaitable(reactor, data), state_(state), addr_(addr), addrlen_(addrlen),
+        new_socket_(invalid_socket) {}
+
+  bool perform() {
+    return socket_ops::non_blocking_accept(data_->descriptor_, state_, addr_, addrlen_, ec_, new_socket_);
+  }
+
+  bool await_ready() { return may_try_inline(epoll_reactor::read_op) && perform(); }
+
+  void await_suspend(std::coroutine_handle<> handle) { suspend(epoll_reactor::read_op, handle); }
+
+  accept_result await_resume() { return accept_result{ec_, new_socket_}; }
+
+private:
+  socket_ops::state_type state_;
+  void *addr_;
+  std::size_t *addrlen_;
+  socket_type new_socket_;
+};
+
+class connect_awaitable : public reactor_awaitable {
+public:
+  connect_awaitable(epoll_reactor &reactor, epoll_reactor::per_descriptor_data &data, const void *addr,
+                    std::size_t addrlen)
+      : reactor_awaitable(reactor, data), addr_(addr), addrlen_(addrlen) {}
+
+  bool perform() { return socket_ops::non_blocking_connect(data_->descriptor_, ec_); }
+
+  bool await_ready() {
+    if (!data_ || data_->shutdown_) {
+      ec_ = abnet::error::bad_descriptor;
+      return true;
+    }
+
+    // The connection is only established asynchronously when in progress.
+    if (socket_ops::connect(data_->descriptor_, addr_, addrlen_, ec_) == 0)
+      return true;
+    return ec_ != abnet::error::in_progress && ec_ != abnet::error::would_block;
+  }
+
+  void await_suspend(std::coroutine_handle<> handle) { suspend(epoll_reactor::connect_op, handle); }
+
+  abnet::error_code await_resume() { return ec_; }
+
+private:
+  const void *addr_;
+  std::size_t addrlen_;
+};
+
+// Receive data on a socket registered with the reactor. Usage:
+// io_result r = co_await async_recv(reactor, data, bufs, count, flags, is_stream);
+inline recv_awaitable async_recv(epoll_reactor &reactor, epoll_reactor::per_descriptor_data &data,
+                                 socket_ops::buf *bufs, std::size_t count, int flags, bool is_stream) {
+  return recv_awaitable(reactor, data, bufs, count, flags, is_stream);
+}
+
+// Send data on a socket registered with the reactor. Usage:
+// io_result r = co_await async_send(reactor, data, bufs, count, flags);
+inline send_awaitable async_send(epoll_reactor &reactor, epoll_reactor::per_descriptor_data &data,
+                                 const socket_ops::buf *bufs, std::size_t count, int flags) {
+  return send_awaitable(reactor, data, bufs, count, flags);
+}
+
+// Accept a connection on a listening socket registered with the reactor.
+// Usage: accept_result r = co_await async_accept(reactor, data, state, addr, addrlen);
+inline accept_awaitable async_accept(epoll_reactor &reactor, epoll_reactor::per_descriptor_data &data,
+                                     socket_ops::state_type state, void *addr, std::size_t *addrlen) {
+  return accept_awaitable(reactor, data, state, addr, addrlen);
+}
+
+// Connect a socket registered with the reactor. Usage:
+// error_code ec = co_await async_connect(reactor, data, addr, addrlen);
+inline connect_awaitable async_connect(epoll_reactor &reactor, epoll_reactor::per_descriptor_data &data,
+                                       const void *addr, std::size_t addrlen) {
+  return connect_awaitable(reactor, data, addr, addrlen);
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/coroutine.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(ABNET_HAS_CO_AWAIT) && defined(ABNET_HAS_STD_COROUTINE) && defined(ABNET_HAS_EPOLL)
+
+#endif // ABNET_COROUTINE_HPP
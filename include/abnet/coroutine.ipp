@@ -0,0 +1,110 @@
+//
+// coroutine.ipp
+// ~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_COROUTINE_IPP
+#define ABNET_COROUTINE_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_CO_AWAIT) && defined(ABNET_HAS_STD_COROUTINE) && defined(ABNET_HAS_EPOLL)
+
+#include <new>
+
+#include "abnet/coroutine.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+namespace coro_frame_pool_ops {
+
+enum { class_count = coro_frame_pool::max_pooled_size / coro_frame_pool::granularity };
+
+struct free_block {
+  free_block *next;
+};
+
+// The free lists of the calling thread. Blocks still listed when the thread
+// exits are returned to the heap.
+struct thread_state {
+  thread_state() : hits(0), misses(0) {
+    for (int i = 0; i < class_count; ++i)
+      free_lists[i] = 0;
+  }
+
+  ~thread_state() {
+    for (int i = 0; i < class_count; ++i) {
+      while (free_block *b = free_lists[i]) {
+        free_lists[i] = b->next;
+        ::operator delete(b);
+      }
+    }
+  }
+
+  free_block *free_lists[class_count];
+  std::size_t hits;
+  std::size_t misses;
+};
+
+inline thread_state &state() {
+  static thread_local thread_state s;
+  return s;
+}
+
+inline std::size_t size_class(std::size_t size) {
+  return (size + coro_frame_pool::granularity - 1) / coro_frame_pool::granularity - 1;
+}
+
+} // namespace coro_frame_pool_ops
+
+void *coro_frame_pool::allocate(std::size_t size) {
+  coro_frame_pool_ops::thread_state &s = coro_frame_pool_ops::state();
+  if (size == 0 || size > max_pooled_size) {
+    ++s.misses;
+    return ::operator new(size);
+  }
+
+  std::size_t c = coro_frame_pool_ops::size_class(size);
+  if (coro_frame_pool_ops::free_block *b = s.free_lists[c]) {
+    s.free_lists[c] = b->next;
+    ++s.hits;
+    return b;
+  }
+
+  ++s.misses;
+  return ::operator new((c + 1) * granularity);
+}
+
+void coro_frame_pool::deallocate(void *p, std::size_t size) {
+  if (size == 0 || size > max_pooled_size) {
+    ::operator delete(p);
+    return;
+  }
+
+  coro_frame_pool_ops::thread_state &s = coro_frame_pool_ops::state();
+  coro_frame_pool_ops::free_block *b = static_cast<coro_frame_pool_ops::free_block *>(p);
+  std::size_t c = coro_frame_pool_ops::size_class(size);
+  b->next = s.free_lists[c];
+  s.free_lists[c] = b;
+}
+
+std::size_t coro_frame_pool::hits() { return coro_frame_pool_ops::state().hits; }
+
+std::size_t coro_frame_pool::misses() { return coro_frame_pool_ops::state().misses; }
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(ABNET_HAS_CO_AWAIT) && defined(ABNET_HAS_STD_COROUTINE) && defined(ABNET_HAS_EPOLL)
+
+#endif // ABNET_COROUTINE_IPP
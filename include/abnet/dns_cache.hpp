@@ -0,0 +1,166 @@
+//
+// dns_cache.hpp
+// ~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_DNS_CACHE_HPP
+#define ABNET_DNS_CACHE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_EVENTFD) && defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#include "abnet/dns_resolver.hpp"
+#include "abnet/error.hpp"
+#include "abnet/eventfd_interrupter.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/socket_types.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// A cache of resolved names in front of a dns_resolver, keyed on host,
+// service and hints. Answers are kept for their record TTL and NXDOMAIN and
+// NODATA answers for their SOA negative TTL, both capped. Transient failures
+// are not cached.
+//
+// A thread owned by the cache drives the resolver. A lookup that misses
+// waits for it, and concurrent misses on one key share a single query. An
+// entry hit often enough is refreshed in the background once a share of its
+// TTL has passed, so that a popular name is replaced before it expires and
+// its callers never wait. resolve() may be called from any thread.
+class dns_cache : private noncopyable {
+public:
+  // A resolved address list, shared by every caller that got it.
+  typedef std::shared_ptr<const addrinfo_type> result_type;
+
+  enum {
+    default_max_entries = 4096,
+    default_max_ttl = 24 * 60 * 60,
+    default_max_negative_ttl = 5 * 60,
+    default_refresh_percent = 75,
+    default_refresh_hits = 2
+  };
+
+  // Constructor. The cache takes over the resolver, which should already
+  // have its nameservers. Starts the resolving thread, setting ec on failure.
+  ABNET_DECL dns_cache(std::unique_ptr<dns_resolver> resolver, abnet::error_code &ec);
+
+  // Destructor. Stops the resolving thread. No call to resolve() may be
+  // waiting.
+  ABNET_DECL ~dns_cache();
+
+  // Look up host and service, as getaddrinfo would with hints. Returns the
+  // cached answer while it is fresh, or waits for the resolver. On failure
+  // returns null with ec set.
+  ABNET_DECL result_type resolve(const char *host, const char *service, const addrinfo_type &hints,
+                                 abnet::error_code &ec);
+
+  // Drop every entry. Queries in flight still complete their waiters.
+  ABNET_DECL void clear();
+
+  // Limits on the number of entries and, in seconds, on the TTL of positive
+  // and negative answers. Apply to entries stored afterwards.
+  ABNET_DECL void set_limits(std::size_t max_entries, uint32_t max_ttl, uint32_t max_negative_ttl);
+
+  // Refresh an entry in the background once percent of its TTL has passed,
+  // if it has been hit at least hits times since it was stored.
+  ABNET_DECL void set_refresh(unsigned percent, std::size_t hits);
+
+  // The number of entries.
+  ABNET_DECL std::size_t size() const;
+
+  // The number of lookups answered from the cache, including negative
+  // answers.
+  std::size_t hits() const { return hits_.load(std::memory_order_relaxed); }
+
+  // The number of lookups answered with a cached NXDOMAIN or NODATA.
+  std::size_t negative_hits() const { return negative_hits_.load(std::memory_order_relaxed); }
+
+  // The number of lookups that had to wait for the resolver.
+  std::size_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+  // The number of background refreshes started.
+  std::size_t refreshes() const { return refreshes_.load(std::memory_order_relaxed); }
+
+  // The number of entries dropped to make room.
+  std::size_t evictions() const { return evictions_.load(std::memory_order_relaxed); }
+
+private:
+  struct entry;
+
+  // Body of the resolving thread.
+  ABNET_DECL void run();
+
+  // Hand an entry to the resolving thread. Called with the lock held.
+  ABNET_DECL void start_query(const std::shared_ptr<entry> &e);
+
+  // Store the outcome of a query and wake its waiters.
+  ABNET_DECL void store(const std::shared_ptr<entry> &e, const abnet::error_code &ec, addrinfo_type *result,
+                        uint32_t ttl);
+
+  // Drop expired entries, then the least recently used, until there is room
+  // for one more. Called with the lock held.
+  ABNET_DECL void make_room(uint64_t now);
+
+  // Build the key of a lookup.
+  ABNET_DECL static std::string make_key(const char *host, const char *service, const addrinfo_type &hints);
+
+  std::unique_ptr<dns_resolver> resolver_;
+  eventfd_interrupter interrupter_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable completed_;
+  std::unordered_map<std::string, std::shared_ptr<entry>> entries_;
+
+  // Entries waiting to be handed to the resolver.
+  std::vector<std::shared_ptr<entry>> queued_;
+  bool stopped_;
+
+  std::size_t max_entries_;
+  uint32_t max_ttl_;
+  uint32_t max_negative_ttl_;
+  unsigned refresh_percent_;
+  std::size_t refresh_hits_;
+
+  // Counts lookups, to order entries by last use.
+  uint64_t uses_;
+
+  std::atomic<std::size_t> hits_;
+  std::atomic<std::size_t> negative_hits_;
+  std::atomic<std::size_t> misses_;
+  std::atomic<std::size_t> refreshes_;
+  std::atomic<std::size_t> evictions_;
+
+  std::thread thread_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/dns_cache.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(ABNET_HAS_EVENTFD) && defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#endif // ABNET_DNS_CACHE_HPP
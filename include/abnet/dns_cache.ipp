@@ -0,0 +1,294 @@
+//
+// dns_cache.ipp
+// ~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_DNS_CACHE_IPP
+#define ABNET_DNS_CACHE_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_EVENTFD) && defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+#include <utility>
+
+#include "abnet/dns_cache.hpp"
+#include "abnet/error.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+namespace dns_cache_ops {
+
+inline uint64_t now_msec() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+} // namespace dns_cache_ops
+
+struct dns_cache::entry {
+  std::string host;
+  std::string service;
+  addrinfo_type hints;
+
+  // Whether the entry holds an answer, which is fresh until expires.
+  bool ready;
+  result_type result;
+  abnet::error_code ec;
+  uint64_t expires;
+
+  // When a background refresh may start, and the hits since the answer was
+  // stored.
+  uint64_t refresh_at;
+  std::size_t hits;
+
+  // Whether a query is in flight, and the number that have completed, which
+  // waiters watch for.
+  bool resolving;
+  std::size_t completions;
+
+  // The value of the use counter at the last lookup, for eviction.
+  uint64_t last_used;
+};
+
+dns_cache::dns_cache(std::unique_ptr<dns_resolver> resolver, abnet::error_code &ec)
+    : resolver_(std::move(resolver)), interrupter_(ec), stopped_(false), max_entries_(default_max_entries),
+      max_ttl_(default_max_ttl), max_negative_ttl_(default_max_negative_ttl),
+      refresh_percent_(default_refresh_percent), refresh_hits_(default_refresh_hits), uses_(0), hits_(0),
+      negative_hits_(0), misses_(0), refreshes_(0), evictions_(0) {
+  if (ec)
+    return;
+  if (!resolver_) {
+    ec = abnet::error::invalid_argument;
+    return;
+  }
+  thread_ = std::thread([this] { run(); });
+}
+
+dns_cache::~dns_cache() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  if (thread_.joinable()) {
+    interrupter_.interrupt();
+    thread_.join();
+  }
+}
+
+dns_cache::result_type dns_cache::resolve(const char *host, const char *service, const addrinfo_type &hints,
+                                          abnet::error_code &ec) {
+  std::string key = make_key(host, service, hints);
+  uint64_t now = dns_cache_ops::now_msec();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (!thread_.joinable() || stopped_) {
+    ec = abnet::error::bad_descriptor;
+    return result_type();
+  }
+
+  std::shared_ptr<entry> e;
+  std::unordered_map<std::string, std::shared_ptr<entry>>::iterator it = entries_.find(key);
+  if (it != entries_.end()) {
+    e = it->second;
+    e->last_used = ++uses_;
+    if (e->ready && now < e->expires) {
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      if (e->ec)
+        negative_hits_.fetch_add(1, std::memory_order_relaxed);
+      if (++e->hits >= refresh_hits_ && now >= e->refresh_at && !e->resolving) {
+        refreshes_.fetch_add(1, std::memory_order_relaxed);
+        start_query(e);
+      }
+      ec = e->ec;
+      return e->result;
+    }
+  } else {
+    make_room(now);
+    e.reset(new entry);
+    e->host = host ? host : "";
+    e->service = service ? service : "";
+    std::memset(&e->hints, 0, sizeof(e->hints));
+    e->hints.ai_flags = hints.ai_flags;
+    e->hints.ai_family = hints.ai_family;
+    e->hints.ai_socktype = hints.ai_socktype;
+    e->hints.ai_protocol = hints.ai_protocol;
+    e->ready = false;
+    e->expires = 0;
+    e->refresh_at = 0;
+    e->hits = 0;
+    e->resolving = false;
+    e->completions = 0;
+    e->last_used = ++uses_;
+    entries_[key] = e;
+  }
+
+  // A refresh already in flight for an expired entry is waited for rather
+  // than duplicated.
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  if (!e->resolving)
+    start_query(e);
+  std::size_t completions = e->completions;
+  while (e->completions == completions && !stopped_)
+    completed_.wait(lock);
+  if (e->completions == completions) {
+    ec = abnet::error::operation_aborted;
+    return result_type();
+  }
+  ec = e->ec;
+  return e->result;
+}
+
+void dns_cache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+void dns_cache::set_limits(std::size_t max_entries, uint32_t max_ttl, uint32_t max_negative_ttl) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_entries_ = max_entries > 0 ? max_entries : 1;
+  max_ttl_ = max_ttl;
+  max_negative_ttl_ = max_negative_ttl;
+}
+
+void dns_cache::set_refresh(unsigned percent, std::size_t hits) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  refresh_percent_ = percent < 100 ? percent : 100;
+  refresh_hits_ = hits;
+}
+
+std::size_t dns_cache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+void dns_cache::run() {
+  std::vector<pollfd> fds;
+  for (;;) {
+    std::vector<std::shared_ptr<entry>> queued;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopped_)
+        break;
+      queued.swap(queued_);
+    }
+
+    for (std::size_t i = 0; i < queued.size(); ++i) {
+      std::shared_ptr<entry> e = queued[i];
+      resolver_->async_resolve(e->host.c_str(), e->service.c_str(), e->hints,
+                               [this, e](const abnet::error_code &ec, addrinfo_type *result, uint32_t ttl) {
+                                 store(e, ec, result, ttl);
+                               });
+    }
+
+    fds.clear();
+    pollfd wakeup;
+    wakeup.fd = interrupter_.read_descriptor();
+    wakeup.events = POLLIN;
+    wakeup.revents = 0;
+    fds.push_back(wakeup);
+    resolver_->fill_pollfds(fds);
+    ::poll(fds.data(), fds.size(), resolver_->timeout_msec());
+    interrupter_.reset();
+    resolver_->process();
+  }
+
+  // Complete whatever is still in flight.
+  resolver_->cancel();
+  resolver_->process();
+}
+
+void dns_cache::start_query(const std::shared_ptr<entry> &e) {
+  e->resolving = true;
+  queued_.push_back(e);
+  interrupter_.interrupt();
+}
+
+void dns_cache::store(const std::shared_ptr<entry> &e, const abnet::error_code &ec, addrinfo_type *result,
+                      uint32_t ttl) {
+  result_type shared;
+  if (result)
+    shared.reset(result, dns_resolver::freeaddrinfo);
+  uint64_t now = dns_cache_ops::now_msec();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  e->resolving = false;
+  ++e->completions;
+  bool negative = ec == abnet::error::host_not_found || ec == abnet::error::no_data;
+  if (!ec || negative) {
+    uint32_t limit = negative ? max_negative_ttl_ : max_ttl_;
+    uint64_t lifetime = uint64_t(ttl < limit ? ttl : limit) * 1000;
+    e->ready = true;
+    e->result = shared;
+    e->ec = ec;
+    e->expires = now + lifetime;
+    e->refresh_at = now + lifetime * refresh_percent_ / 100;
+    e->hits = 0;
+  } else if (!e->ready || now >= e->expires) {
+    // A transient failure is only handed to the waiters.
+    e->ready = false;
+    e->result.reset();
+    e->ec = ec;
+  } else {
+    // Keep serving the fresh answer, and try again halfway to its expiry.
+    e->refresh_at = now + (e->expires - now) / 2;
+  }
+  completed_.notify_all();
+}
+
+void dns_cache::make_room(uint64_t now) {
+  if (entries_.size() < max_entries_)
+    return;
+
+  std::unordered_map<std::string, std::shared_ptr<entry>>::iterator it = entries_.begin();
+  while (it != entries_.end()) {
+    if (!it->second->resolving && now >= it->second->expires) {
+      it = entries_.erase(it);
+      evictions_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      ++it;
+    }
+  }
+
+  while (entries_.size() >= max_entries_) {
+    std::unordered_map<std::string, std::shared_ptr<entry>>::iterator oldest = entries_.begin();
+    for (it = entries_.begin(); it != entries_.end(); ++it)
+      if (it->second->last_used < oldest->second->last_used)
+        oldest = it;
+    entries_.erase(oldest);
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+std::string dns_cache::make_key(const char *host, const char *service, const addrinfo_type &hints) {
+  // Names are case insensitive; services are not.
+  std::string key(host ? host : "");
+  for (std::size_t i = 0; i < key.size(); ++i)
+    if (key[i] >= 'A' && key[i] <= 'Z')
+      key[i] = key[i] - 'A' + 'a';
+  key += '\0';
+  key += service ? service : "";
+  key += '\0';
+  int fields[4] = {hints.ai_flags, hints.ai_family, hints.ai_socktype, hints.ai_protocol};
+  key.append(reinterpret_cast<const char *>(fields), sizeof(fields));
+  return key;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(ABNET_HAS_EVENTFD) && defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_MUTEX_AND_CONDVAR)
+
+#endif // ABNET_DNS_CACHE_IPP
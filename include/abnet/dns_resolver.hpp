@@ -0,0 +1,248 @@
+//
+// dns_resolver.hpp
+// ~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_DNS_RESOLVER_HPP
+#define ABNET_DNS_RESOLVER_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(__linux__)
+
+#include "abnet/error.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/socket_ops.hpp"
+#include "abnet/socket_types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+namespace dns_ops {
+
+enum {
+  type_a = 1,
+  type_cname = 5,
+  type_soa = 6,
+  type_aaaa = 28,
+  type_opt = 41,
+  class_in = 1,
+  header_size = 12,
+  max_name_size = 255,
+  max_label_size = 63
+};
+
+enum { rcode_ok = 0, rcode_format_error = 1, rcode_server_failure = 2, rcode_nxdomain = 3 };
+
+// Encode a recursive query for name into packet, with an EDNS0 OPT record
+// advertising payload_size unless it is 0. Returns false if name is not a
+// valid domain name.
+ABNET_DECL bool encode_query(const std::string &name, uint16_t id, uint16_t type, uint16_t payload_size,
+                             std::vector<unsigned char> &packet);
+
+// The outcome of decoding a response.
+struct answer {
+  // The response code of the header.
+  int rcode;
+
+  // Whether the response was truncated.
+  bool truncated;
+
+  // The end of the CNAME chain starting at the question name.
+  std::string canonical_name;
+
+  // The addresses the chain leads to, 4 or 16 bytes each.
+  std::vector<std::string> addresses;
+
+  // The smallest TTL of the records used, or for a negative answer the
+  // negative caching TTL taken from the SOA record, if any.
+  uint32_t ttl;
+};
+
+// Decode a response to the query for name, id and type. Returns false if the
+// response is malformed or does not answer that question.
+ABNET_DECL bool decode_response(const unsigned char *data, std::size_t size, const std::string &name, uint16_t id,
+                                uint16_t type, answer &result);
+
+} // namespace dns_ops
+
+// A stub resolver that sends A and AAAA queries to the nameservers over UDP,
+// or TCP when a response is truncated, without blocking the calling thread.
+// Each query has its own socket and a random id. A server that times out,
+// refuses the connection or answers SERVFAIL or REFUSED is skipped in favour
+// of the next one, for attempts rounds over the server list. CNAME chains are
+// followed within the response. /etc/hosts and search domains are not used.
+//
+// The resolver is driven by the caller: poll the descriptors from
+// fill_pollfds() for up to timeout_msec(), then call process(), which also
+// runs the handlers of resolutions that finished. run() does this until
+// nothing is outstanding, blocking the calling thread. The resolver is not
+// thread safe.
+class dns_resolver : private noncopyable {
+public:
+  // Handler invoked when a resolution finishes. On success result holds the
+  // addresses, owned by the handler and released with
+  // dns_resolver::freeaddrinfo(), and ttl is the smallest TTL of the records
+  // used. On host_not_found or no_data ttl is the negative caching TTL from
+  // the SOA record, or 0 if the server sent none.
+  typedef std::function<void(const abnet::error_code &ec, addrinfo_type *result, uint32_t ttl)> handler_type;
+
+  enum { default_port = 53, default_timeout_msec = 5000, default_attempts = 2, edns_payload_size = 1232 };
+
+  // The TTL reported for a numeric host, which never expires.
+  static constexpr uint32_t literal_ttl = 0xffffffff;
+
+  // Constructor. The resolver starts without nameservers.
+  ABNET_DECL dns_resolver();
+
+  // Destructor. Closes the sockets of outstanding queries without running
+  // their handlers.
+  ABNET_DECL ~dns_resolver();
+
+  // Add a nameserver given as a numeric IPv4 or IPv6 address.
+  ABNET_DECL void add_nameserver(const char *address, unsigned short port, abnet::error_code &ec);
+
+  // Read the nameserver lines and the timeout and attempts options of a
+  // resolv.conf file. With no nameserver listed, 127.0.0.1 is used as libc
+  // does.
+  ABNET_DECL void load_resolv_conf(const char *path, abnet::error_code &ec);
+
+  // The number of nameservers.
+  std::size_t nameserver_count() const { return servers_.size(); }
+
+  // The time to wait for a response before trying the next server.
+  int timeout() const { return timeout_msec_; }
+  void set_timeout(int msec) { timeout_msec_ = msec > 0 ? msec : 1; }
+
+  // The number of rounds over the server list.
+  int attempts() const { return attempts_; }
+  void set_attempts(int attempts) { attempts_ = attempts > 0 ? attempts : 1; }
+
+  // Start resolving host and service, as getaddrinfo would with hints. A
+  // numeric host or a failure to start completes without a query, on the
+  // next call to process().
+  ABNET_DECL void async_resolve(const char *host, const char *service, const addrinfo_type &hints,
+                                handler_type handler);
+
+  // Append the descriptors of the outstanding queries and the events to
+  // wait for. Returns the number appended.
+  ABNET_DECL std::size_t fill_pollfds(std::vector<pollfd> &fds) const;
+
+  // The milliseconds until the next query times out, 0 if a resolution is
+  // ready to be delivered, or -1 if nothing is outstanding.
+  ABNET_DECL int timeout_msec() const;
+
+  // Read whatever responses have arrived, retry queries that timed out and
+  // run the handlers of finished resolutions. Never blocks. Returns the
+  // number of handlers run.
+  ABNET_DECL std::size_t process();
+
+  // Poll and process until nothing is outstanding. Returns the number of
+  // handlers run.
+  ABNET_DECL std::size_t run(abnet::error_code &ec);
+
+  // Finish every outstanding resolution with operation_aborted, on the next
+  // call to process().
+  ABNET_DECL void cancel();
+
+  // The number of resolutions whose handlers have not run.
+  std::size_t outstanding() const { return resolutions_ + ready_.size(); }
+
+  // The number of query packets sent, over UDP or TCP.
+  std::size_t queries_sent() const { return queries_sent_; }
+
+  // The number of times a query was sent again, to another server or
+  // without EDNS0.
+  std::size_t retries() const { return retries_; }
+
+  // The number of truncated responses retried over TCP.
+  std::size_t tcp_fallbacks() const { return tcp_fallbacks_; }
+
+  // The number of queries that got no response in time.
+  std::size_t timeouts() const { return timeouts_; }
+
+  // Release a result passed to a handler.
+  ABNET_DECL static void freeaddrinfo(addrinfo_type *ai);
+
+private:
+  struct resolution;
+  struct query;
+
+  // Start the next try of a query, on the next server. Returns false once
+  // every try is used up.
+  ABNET_DECL bool start_try(query &q);
+
+  // Open the socket for the current try and send or queue the packet.
+  ABNET_DECL bool open_socket(query &q, abnet::error_code &ec);
+
+  // Make progress on a query. Returns true once it has finished.
+  ABNET_DECL bool service(query &q, uint64_t now);
+
+  // Act on a complete response. Returns true once the query has finished.
+  ABNET_DECL bool handle_response(query &q, const unsigned char *data, std::size_t size);
+
+  // Move on after a failed try. Returns true once the query has finished.
+  ABNET_DECL bool fail_try(query &q, const abnet::error_code &ec);
+
+  // Record the outcome of a query in its resolution.
+  ABNET_DECL void finish(query &q, const abnet::error_code &ec, const dns_ops::answer *result);
+
+  // Queue a resolution whose queries have all finished for delivery.
+  ABNET_DECL void complete(const std::shared_ptr<resolution> &r);
+
+  // Close the socket of a query.
+  ABNET_DECL void close_socket(query &q);
+
+  // Build the addrinfo list of a resolution.
+  ABNET_DECL static addrinfo_type *make_result(const resolution &r, abnet::error_code &ec);
+
+  // Milliseconds on the monotonic clock.
+  ABNET_DECL static uint64_t now_msec();
+
+  struct server {
+    sockaddr_storage_type address_;
+    std::size_t length_;
+  };
+
+  std::vector<server> servers_;
+  int timeout_msec_;
+  int attempts_;
+
+  std::vector<std::unique_ptr<query>> queries_;
+  std::vector<std::shared_ptr<resolution>> ready_;
+  std::size_t resolutions_;
+  std::mt19937 random_;
+
+  std::size_t queries_sent_;
+  std::size_t retries_;
+  std::size_t tcp_fallbacks_;
+  std::size_t timeouts_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/dns_resolver.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(__linux__)
+
+#endif // ABNET_DNS_RESOLVER_HPP
@@ -0,0 +1,867 @@
+//
+// dns_resolver.ipp
+// ~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_DNS_RESOLVER_IPP
+#define ABNET_DNS_RESOLVER_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netdb.h>
+#include <time.h>
+
+#include "abnet/dns_resolver.hpp"
+#include "abnet/error.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+namespace dns_ops {
+
+enum { rcode_not_implemented = 4, max_pointer_jumps = 64, max_servers = 3 };
+
+inline void put16(std::vector<unsigned char> &packet, unsigned value) {
+  packet.push_back(static_cast<unsigned char>(value >> 8));
+  packet.push_back(static_cast<unsigned char>(value));
+}
+
+inline uint16_t get16(const unsigned char *p) { return static_cast<uint16_t>(p[0] << 8 | p[1]); }
+
+inline uint32_t get32(const unsigned char *p) {
+  return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+inline char lower(char c) { return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c; }
+
+// Lowercase a name and strip its trailing dot, the form names are compared in.
+inline std::string normalize(const std::string &name) {
+  std::string result(name, 0, !name.empty() && name[name.size() - 1] == '.' ? name.size() - 1 : name.size());
+  for (std::size_t i = 0; i < result.size(); ++i)
+    result[i] = lower(result[i]);
+  return result;
+}
+
+// Read a possibly compressed name at offset, leaving offset past it.
+inline bool read_name(const unsigned char *data, std::size_t size, std::size_t &offset, std::string &name) {
+  name.clear();
+  std::size_t pos = offset;
+  bool jumped = false;
+  for (int jumps = 0;;) {
+    if (pos >= size)
+      return false;
+    unsigned length = data[pos];
+    if ((length & 0xc0) == 0xc0) {
+      if (pos + 1 >= size || ++jumps > max_pointer_jumps)
+        return false;
+      if (!jumped)
+        offset = pos + 2;
+      jumped = true;
+      pos = (length & 0x3f) << 8 | data[pos + 1];
+      continue;
+    }
+    if (length & 0xc0)
+      return false;
+    ++pos;
+    if (length == 0)
+      break;
+    if (pos + length > size || name.size() + length + 1 > max_name_size)
+      return false;
+    if (!name.empty())
+      name += '.';
+    for (unsigned i = 0; i < length; ++i)
+      name += lower(static_cast<char>(data[pos + i]));
+    pos += length;
+  }
+  if (!jumped)
+    offset = pos;
+  return true;
+}
+
+bool encode_query(const std::string &name, uint16_t id, uint16_t type, uint16_t payload_size,
+                  std::vector<unsigned char> &packet) {
+  std::size_t length = name.size();
+  if (length > 0 && name[length - 1] == '.')
+    --length;
+  if (length == 0 || length + 2 > max_name_size)
+    return false;
+
+  packet.clear();
+  put16(packet, id);
+  put16(packet, 0x0100); // RD
+  put16(packet, 1);
+  put16(packet, 0);
+  put16(packet, 0);
+  put16(packet, payload_size ? 1 : 0);
+
+  for (std::size_t start = 0; start <= length;) {
+    std::size_t dot = name.find('.', start);
+    if (dot == std::string::npos || dot > length)
+      dot = length;
+    if (dot == start || dot - start > max_label_size)
+      return false;
+    packet.push_back(static_cast<unsigned char>(dot - start));
+    packet.insert(packet.end(), name.begin() + start, name.begin() + dot);
+    start = dot + 1;
+  }
+  packet.push_back(0);
+  put16(packet, type);
+  put16(packet, class_in);
+
+  if (payload_size) {
+    // The OPT pseudo-record: root owner, payload size in the class field and
+    // no options.
+    packet.push_back(0);
+    put16(packet, type_opt);
+    put16(packet, payload_size);
+    put16(packet, 0);
+    put16(packet, 0);
+    put16(packet, 0);
+  }
+  return true;
+}
+
+bool decode_response(const unsigned char *data, std::size_t size, const std::string &name, uint16_t id,
+                     uint16_t type, answer &result) {
+  if (size < header_size || get16(data) != id)
+    return false;
+  unsigned flags = get16(data + 2);
+  if (!(flags & 0x8000) || (flags >> 11 & 0xf) != 0)
+    return false;
+  result.rcode = flags & 0xf;
+  result.truncated = (flags & 0x0200) != 0;
+  result.canonical_name.clear();
+  result.addresses.clear();
+  result.ttl = 0;
+
+  // A server rejecting the query need not repeat the question.
+  std::size_t questions = get16(data + 4);
+  if (questions == 0)
+    return result.rcode != rcode_ok;
+  if (questions != 1)
+    return false;
+
+  std::string target = normalize(name);
+  std::size_t offset = header_size;
+  std::string owner;
+  if (!read_name(data, size, offset, owner) || offset + 4 > size || owner != target || get16(data + offset) != type ||
+      get16(data + offset + 2) != class_in)
+    return false;
+  offset += 4;
+
+  // The rest is incomplete in a truncated response, which is retried over TCP.
+  if (result.truncated)
+    return true;
+
+  struct record {
+    std::string owner;
+    uint16_t type;
+    uint32_t ttl;
+    std::size_t rdata;
+    std::size_t rdlength;
+  };
+  std::vector<record> answers;
+  bool have_soa = false;
+  uint32_t negative_ttl = 0;
+  std::size_t records = get16(data + 6) + get16(data + 8);
+  for (std::size_t i = 0; i < records; ++i) {
+    record r;
+    if (!read_name(data, size, offset, r.owner) || offset + 10 > size)
+      return false;
+    r.type = get16(data + offset);
+    unsigned rclass = get16(data + offset + 2);
+    r.ttl = get32(data + offset + 4) & 0x7fffffff;
+    r.rdlength = get16(data + offset + 8);
+    r.rdata = offset + 10;
+    offset = r.rdata + r.rdlength;
+    if (offset > size)
+      return false;
+    if (rclass != class_in)
+      continue;
+
+    if (i < get16(data + 6)) {
+      answers.push_back(r);
+    } else if (r.type == type_soa && !have_soa) {
+      // RFC 2308: negative answers are cached for the lesser of the SOA
+      // record's TTL and its MINIMUM field.
+      std::size_t pos = r.rdata;
+      std::string mname, rname;
+      if (!read_name(data, size, pos, mname) || !read_name(data, size, pos, rname) || pos + 20 > offset)
+        return false;
+      uint32_t minimum = get32(data + pos + 16);
+      negative_ttl = minimum < r.ttl ? minimum : r.ttl;
+      have_soa = true;
+    }
+  }
+
+  uint32_t ttl = 0xffffffff;
+  for (std::size_t hops = 0; hops < answers.size(); ++hops) {
+    std::size_t i = 0;
+    while (i < answers.size() && (answers[i].type != type_cname || answers[i].owner != target))
+      ++i;
+    if (i == answers.size())
+      break;
+    std::size_t pos = answers[i].rdata;
+    if (!read_name(data, size, pos, target))
+      return false;
+    if (answers[i].ttl < ttl)
+      ttl = answers[i].ttl;
+  }
+
+  std::size_t address_size = type == type_aaaa ? 16 : 4;
+  for (std::size_t i = 0; i < answers.size(); ++i) {
+    const record &r = answers[i];
+    if (r.type != type || r.owner != target || r.rdlength != address_size)
+      continue;
+    result.addresses.push_back(std::string(reinterpret_cast<const char *>(data + r.rdata), r.rdlength));
+    if (r.ttl < ttl)
+      ttl = r.ttl;
+  }
+
+  result.canonical_name = target;
+  result.ttl = result.addresses.empty() ? (have_soa ? negative_ttl : 0) : ttl;
+  return true;
+}
+
+// A node of a result list, with its address in the same allocation.
+struct result_node {
+  addrinfo_type info;
+  union {
+    sockaddr_in4_type v4;
+    sockaddr_in6_type v6;
+  } address;
+};
+
+// How a failure ranks when the A and AAAA queries of a name disagree: a
+// transient failure hides a negative answer, which must not be cached.
+inline int failure_rank(const abnet::error_code &ec) {
+  if (!ec)
+    return 0;
+  if (ec == abnet::error::no_data)
+    return 1;
+  if (ec == abnet::error::host_not_found)
+    return 2;
+  return 3;
+}
+
+} // namespace dns_ops
+
+struct dns_resolver::resolution {
+  std::string name;
+  unsigned short port;
+  unsigned long scope_id;
+  addrinfo_type hints;
+  handler_type handler;
+
+  // The queries not yet finished.
+  std::size_t pending;
+
+  std::vector<std::string> v4;
+  std::vector<std::string> v6;
+  std::string canonical_name;
+
+  // The outcome so far, and once complete the result to deliver.
+  abnet::error_code ec;
+  uint32_t ttl;
+  uint32_t negative_ttl;
+  addrinfo_type *result;
+};
+
+struct dns_resolver::query {
+  enum phase_type { connecting, writing, reading };
+
+  std::shared_ptr<resolution> owner;
+  uint16_t type;
+  uint16_t id;
+  bool edns;
+  bool tcp;
+  phase_type phase;
+
+  // The tries started, which also selects the server.
+  std::size_t tries;
+  std::size_t server;
+
+  socket_type socket;
+  uint64_t deadline;
+
+  // The query, preceded by its length over TCP, and how much has been sent.
+  std::vector<unsigned char> packet;
+  std::size_t sent;
+
+  // A response being read over TCP, including its length.
+  std::vector<unsigned char> buffer;
+  std::size_t received;
+};
+
+dns_resolver::dns_resolver()
+    : timeout_msec_(default_timeout_msec), attempts_(default_attempts), resolutions_(0),
+      random_(std::random_device()()), queries_sent_(0), retries_(0), tcp_fallbacks_(0), timeouts_(0) {}
+
+dns_resolver::~dns_resolver() {
+  for (std::size_t i = 0; i < queries_.size(); ++i)
+    close_socket(*queries_[i]);
+  for (std::size_t i = 0; i < ready_.size(); ++i)
+    freeaddrinfo(ready_[i]->result);
+}
+
+void dns_resolver::add_nameserver(const char *address, unsigned short port, abnet::error_code &ec) {
+  server s;
+  std::memset(&s, 0, sizeof(s));
+  sockaddr_in4_type *v4 = reinterpret_cast<sockaddr_in4_type *>(&s.address_);
+  sockaddr_in6_type *v6 = reinterpret_cast<sockaddr_in6_type *>(&s.address_);
+  unsigned long scope_id = 0;
+  if (socket_ops::inet_pton(AF_INET, address, &v4->sin_addr, 0, ec) > 0) {
+    v4->sin_family = AF_INET;
+    v4->sin_port = socket_ops::host_to_network_short(port);
+    s.length_ = sizeof(sockaddr_in4_type);
+  } else if (socket_ops::inet_pton(AF_INET6, address, &v6->sin6_addr, &scope_id, ec) > 0) {
+    v6->sin6_family = AF_INET6;
+    v6->sin6_port = socket_ops::host_to_network_short(port);
+    v6->sin6_scope_id = static_cast<uint32_t>(scope_id);
+    s.length_ = sizeof(sockaddr_in6_type);
+  } else {
+    ec = abnet::error::invalid_argument;
+    return;
+  }
+  servers_.push_back(s);
+  abnet::error::clear(ec);
+}
+
+void dns_resolver::load_resolv_conf(const char *path, abnet::error_code &ec) {
+  std::FILE *f = std::fopen(path, "r");
+  if (!f) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return;
+  }
+
+  // Like libc, use at most three nameservers and ignore any that do not parse.
+  std::size_t added = 0;
+  char line[512];
+  while (std::fgets(line, sizeof(line), f)) {
+    const char *separators = " \t\r\n";
+    char *save = 0;
+    char *word = ::strtok_r(line, separators, &save);
+    if (!word || *word == '#' || *word == ';')
+      continue;
+    if (std::strcmp(word, "nameserver") == 0) {
+      char *address = ::strtok_r(0, separators, &save);
+      abnet::error_code address_ec;
+      if (address && added < dns_ops::max_servers) {
+        add_nameserver(address, default_port, address_ec);
+        if (!address_ec)
+          ++added;
+      }
+    } else if (std::strcmp(word, "options") == 0) {
+      while ((word = ::strtok_r(0, separators, &save))) {
+        if (std::strncmp(word, "timeout:", 8) == 0)
+          set_timeout(std::atoi(word + 8) * 1000);
+        else if (std::strncmp(word, "attempts:", 9) == 0)
+          set_attempts(std::atoi(word + 9));
+      }
+    }
+  }
+  std::fclose(f);
+
+  if (added == 0)
+    add_nameserver("127.0.0.1", default_port, ec);
+  else
+    abnet::error::clear(ec);
+}
+
+void dns_resolver::async_resolve(const char *host, const char *service, const addrinfo_type &hints,
+                                 handler_type handler) {
+  std::shared_ptr<resolution> r(new resolution);
+  r->port = 0;
+  r->scope_id = 0;
+  r->hints = hints;
+  r->handler = handler;
+  r->pending = 0;
+  r->ttl = literal_ttl;
+  r->negative_ttl = literal_ttl;
+  r->result = 0;
+  ++resolutions_;
+
+  abnet::error_code ec;
+  if (service && *service) {
+    char *end = 0;
+    unsigned long port = std::strtoul(service, &end, 10);
+    if (*end == 0 && port <= 0xffff) {
+      r->port = static_cast<unsigned short>(port);
+    } else if (hints.ai_flags & AI_NUMERICSERV) {
+      ec = abnet::error::service_not_found;
+    } else {
+      servent entry;
+      servent *found = 0;
+      char buffer[1024];
+      const char *protocol = hints.ai_socktype == SOCK_DGRAM ? "udp" : "tcp";
+      if (::getservbyname_r(service, protocol, &entry, buffer, sizeof(buffer), &found) != 0 || !found)
+        ec = abnet::error::service_not_found;
+      else
+        r->port = socket_ops::network_to_host_short(static_cast<u_short_type>(found->s_port));
+    }
+  }
+
+  int family = hints.ai_family;
+  if (!ec && family != AF_UNSPEC && family != AF_INET && family != AF_INET6)
+    ec = abnet::error::address_family_not_supported;
+
+  if (ec) {
+    r->ec = ec;
+    complete(r);
+    return;
+  }
+
+  in6_addr_type address;
+  abnet::error_code literal_ec;
+  if (!host || !*host) {
+    // No host names the loopback address, or the wildcard for AI_PASSIVE.
+    bool passive = (hints.ai_flags & AI_PASSIVE) != 0;
+    unsigned char v4[4] = {127, 0, 0, 1};
+    unsigned char v6[16] = {0};
+    if (passive)
+      v4[0] = 0;
+    else
+      v6[15] = 1;
+    if (family != AF_INET6)
+      r->v4.push_back(std::string(reinterpret_cast<char *>(v4), 4));
+    if (family != AF_INET)
+      r->v6.push_back(std::string(reinterpret_cast<char *>(v6), 16));
+  } else if (socket_ops::inet_pton(AF_INET, host, &address, 0, literal_ec) > 0) {
+    r->canonical_name = host;
+    if (family == AF_INET6)
+      ec = abnet::error::host_not_found;
+    else
+      r->v4.push_back(std::string(reinterpret_cast<char *>(&address), 4));
+  } else if (socket_ops::inet_pton(AF_INET6, host, &address, &r->scope_id, literal_ec) > 0) {
+    r->canonical_name = host;
+    if (family == AF_INET)
+      ec = abnet::error::host_not_found;
+    else
+      r->v6.push_back(std::string(reinterpret_cast<char *>(&address), 16));
+  } else if (hints.ai_flags & AI_NUMERICHOST) {
+    ec = abnet::error::host_not_found;
+  } else if (servers_.empty()) {
+    ec = abnet::error::host_not_found_try_again;
+  } else {
+    r->name = dns_ops::normalize(host);
+    std::vector<unsigned char> packet;
+    if (!dns_ops::encode_query(r->name, 0, dns_ops::type_a, 0, packet)) {
+      ec = abnet::error::host_not_found;
+    } else {
+      uint16_t types[2];
+      std::size_t count = 0;
+      if (family != AF_INET6)
+        types[count++] = dns_ops::type_a;
+      if (family != AF_INET)
+        types[count++] = dns_ops::type_aaaa;
+
+      // Count every query before starting any, so the resolution cannot
+      // complete while queries are still being added.
+      r->pending = count;
+      for (std::size_t i = 0; i < count; ++i) {
+        std::unique_ptr<query> q(new query);
+        q->owner = r;
+        q->type = types[i];
+        q->id = 0;
+        q->edns = true;
+        q->tcp = false;
+        q->phase = query::reading;
+        q->tries = 0;
+        q->server = 0;
+        q->socket = invalid_socket;
+        q->deadline = 0;
+        q->sent = 0;
+        q->received = 0;
+        if (start_try(*q))
+          queries_.push_back(std::move(q));
+        else
+          finish(*q, abnet::error::host_not_found_try_again, 0);
+      }
+      return;
+    }
+  }
+
+  r->ec = ec;
+  complete(r);
+}
+
+std::size_t dns_resolver::fill_pollfds(std::vector<pollfd> &fds) const {
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < queries_.size(); ++i) {
+    const query &q = *queries_[i];
+    if (q.socket == invalid_socket)
+      continue;
+    pollfd fd;
+    fd.fd = q.socket;
+    fd.events = q.phase == query::reading ? POLLIN : POLLOUT;
+    fd.revents = 0;
+    fds.push_back(fd);
+    ++count;
+  }
+  return count;
+}
+
+int dns_resolver::timeout_msec() const {
+  if (!ready_.empty())
+    return 0;
+  if (queries_.empty())
+    return -1;
+  uint64_t next = queries_[0]->deadline;
+  for (std::size_t i = 1; i < queries_.size(); ++i)
+    if (queries_[i]->deadline < next)
+      next = queries_[i]->deadline;
+  uint64_t now = now_msec();
+  return next > now ? static_cast<int>(next - now) : 0;
+}
+
+std::size_t dns_resolver::process() {
+  uint64_t now = now_msec();
+  for (std::size_t i = 0; i < queries_.size();) {
+    if (service(*queries_[i], now))
+      queries_.erase(queries_.begin() + i);
+    else
+      ++i;
+  }
+
+  // Handlers may start or cancel resolutions, so take the list first.
+  std::vector<std::shared_ptr<resolution>> ready;
+  ready.swap(ready_);
+  for (std::size_t i = 0; i < ready.size(); ++i) {
+    resolution &r = *ready[i];
+    addrinfo_type *result = r.result;
+    r.result = 0;
+    r.handler(r.ec, result, r.ttl);
+  }
+  return ready.size();
+}
+
+std::size_t dns_resolver::run(abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  std::size_t handled = 0;
+  std::vector<pollfd> fds;
+  while (outstanding() > 0) {
+    fds.clear();
+    fill_pollfds(fds);
+    if (::poll(fds.data(), fds.size(), timeout_msec()) < 0 && errno != EINTR) {
+      ec = abnet::error_code(errno, abnet::error::get_system_category());
+      return handled;
+    }
+    handled += process();
+  }
+  return handled;
+}
+
+void dns_resolver::cancel() {
+  std::vector<std::unique_ptr<query>> queries;
+  queries.swap(queries_);
+  for (std::size_t i = 0; i < queries.size(); ++i) {
+    query &q = *queries[i];
+    close_socket(q);
+    q.owner->ec = abnet::error::operation_aborted;
+    q.owner->v4.clear();
+    q.owner->v6.clear();
+    if (--q.owner->pending == 0)
+      complete(q.owner);
+  }
+}
+
+void dns_resolver::freeaddrinfo(addrinfo_type *ai) {
+  while (ai) {
+    addrinfo_type *next = ai->ai_next;
+    std::free(ai->ai_canonname);
+    std::free(ai);
+    ai = next;
+  }
+}
+
+bool dns_resolver::start_try(query &q) {
+  close_socket(q);
+  std::size_t limit = servers_.size() * attempts_;
+  while (q.tries < limit) {
+    q.server = q.tries % servers_.size();
+    if (q.tries++ > 0)
+      ++retries_;
+    q.edns = true;
+    q.tcp = false;
+    abnet::error_code ec;
+    if (open_socket(q, ec))
+      return true;
+  }
+  return false;
+}
+
+bool dns_resolver::open_socket(query &q, abnet::error_code &ec) {
+  close_socket(q);
+  const server &s = servers_[q.server];
+
+  // A fresh id, and with a fresh socket a fresh source port, for every try.
+  q.id = static_cast<uint16_t>(random_());
+  dns_ops::encode_query(q.owner->name, q.id, q.type, q.edns ? edns_payload_size : 0, q.packet);
+  q.sent = 0;
+  q.buffer.clear();
+  q.received = 0;
+  q.deadline = now_msec() + timeout_msec_;
+
+  q.socket = socket_ops::socket(s.address_.ss_family, q.tcp ? SOCK_STREAM : SOCK_DGRAM, 0, ec);
+  if (q.socket == invalid_socket)
+    return false;
+  socket_ops::state_type state = 0;
+  if (!socket_ops::set_internal_non_blocking(q.socket, state, true, ec) ||
+      (socket_ops::connect(q.socket, &s.address_, s.length_, ec) != 0 && ec != abnet::error::in_progress &&
+       ec != abnet::error::would_block)) {
+    close_socket(q);
+    return false;
+  }
+
+  if (q.tcp) {
+    std::size_t size = q.packet.size();
+    q.packet.insert(q.packet.begin(), static_cast<unsigned char>(size));
+    q.packet.insert(q.packet.begin(), static_cast<unsigned char>(size >> 8));
+    q.phase = query::connecting;
+    return true;
+  }
+
+  if (socket_ops::send1(q.socket, q.packet.data(), q.packet.size(), 0, ec) < 0) {
+    close_socket(q);
+    return false;
+  }
+  ++queries_sent_;
+  q.phase = query::reading;
+  return true;
+}
+
+bool dns_resolver::service(query &q, uint64_t now) {
+  abnet::error_code ec;
+  if (q.phase == query::connecting && socket_ops::non_blocking_connect(q.socket, ec)) {
+    if (ec)
+      return fail_try(q, abnet::error::host_not_found_try_again);
+    q.phase = query::writing;
+  }
+
+  if (q.phase == query::writing) {
+    signed_size_type n = socket_ops::send1(q.socket, q.packet.data() + q.sent, q.packet.size() - q.sent, 0, ec);
+    if (n < 0 && ec != abnet::error::would_block && ec != abnet::error::try_again)
+      return fail_try(q, abnet::error::host_not_found_try_again);
+    if (n > 0 && (q.sent += n) == q.packet.size()) {
+      ++queries_sent_;
+      q.phase = query::reading;
+    }
+  }
+
+  if (q.phase == query::reading && !q.tcp) {
+    // Drain the socket, skipping datagrams that do not answer the query.
+    socket_type s = q.socket;
+    unsigned char data[4096];
+    while (q.socket == s && !q.tcp) {
+      signed_size_type n = socket_ops::recv1(q.socket, data, sizeof(data), 0, ec);
+      if (n < 0) {
+        // A connected UDP socket reports an ICMP port unreachable from the
+        // server as connection_refused.
+        if (ec != abnet::error::would_block && ec != abnet::error::try_again)
+          return fail_try(q, abnet::error::host_not_found_try_again);
+        break;
+      }
+      if (handle_response(q, data, n))
+        return true;
+    }
+  } else if (q.phase == query::reading) {
+    for (;;) {
+      std::size_t want = q.received < 2 ? 2 : 2 + dns_ops::get16(q.buffer.data());
+      if (want == 2 && q.received == 2)
+        return fail_try(q, abnet::error::no_recovery);
+      if (q.received == want)
+        return handle_response(q, q.buffer.data() + 2, want - 2);
+      if (q.buffer.size() < want)
+        q.buffer.resize(want);
+      signed_size_type n = socket_ops::recv1(q.socket, q.buffer.data() + q.received, want - q.received, 0, ec);
+      if (n == 0 || (n < 0 && ec != abnet::error::would_block && ec != abnet::error::try_again))
+        return fail_try(q, abnet::error::host_not_found_try_again);
+      if (n < 0)
+        break;
+      q.received += n;
+    }
+  }
+
+  if (now >= q.deadline) {
+    ++timeouts_;
+    return fail_try(q, abnet::error::host_not_found_try_again);
+  }
+  return false;
+}
+
+bool dns_resolver::handle_response(query &q, const unsigned char *data, std::size_t size) {
+  dns_ops::answer result;
+  if (!dns_ops::decode_response(data, size, q.owner->name, q.id, q.type, result)) {
+    // Over UDP this may be a stray or forged datagram, so keep waiting.
+    return q.tcp ? fail_try(q, abnet::error::no_recovery) : false;
+  }
+
+  abnet::error_code ec;
+  if (result.truncated) {
+    // The answer section was not decoded, so a truncated reply must never be
+    // taken as an empty answer.
+    if (q.tcp)
+      return fail_try(q, abnet::error::no_recovery);
+    ++tcp_fallbacks_;
+    q.tcp = true;
+    return open_socket(q, ec) ? false : fail_try(q, abnet::error::host_not_found_try_again);
+  }
+
+  switch (result.rcode) {
+  case dns_ops::rcode_ok:
+    finish(q, result.addresses.empty() ? abnet::error_code(abnet::error::no_data) : abnet::error_code(), &result);
+    return true;
+  case dns_ops::rcode_nxdomain:
+    finish(q, abnet::error::host_not_found, &result);
+    return true;
+  case dns_ops::rcode_format_error:
+    // Servers predating EDNS0 reject the OPT record.
+    if (q.edns) {
+      ++retries_;
+      q.edns = false;
+      return open_socket(q, ec) ? false : fail_try(q, abnet::error::host_not_found_try_again);
+    }
+    return fail_try(q, abnet::error::no_recovery);
+  case dns_ops::rcode_not_implemented:
+    return fail_try(q, abnet::error::no_recovery);
+  default: // SERVFAIL, REFUSED and the rest.
+    return fail_try(q, abnet::error::host_not_found_try_again);
+  }
+}
+
+bool dns_resolver::fail_try(query &q, const abnet::error_code &ec) {
+  if (start_try(q))
+    return false;
+  finish(q, ec, 0);
+  return true;
+}
+
+void dns_resolver::finish(query &q, const abnet::error_code &ec, const dns_ops::answer *result) {
+  close_socket(q);
+  resolution &r = *q.owner;
+  if (!ec) {
+    std::vector<std::string> &addresses = q.type == dns_ops::type_a ? r.v4 : r.v6;
+    addresses.insert(addresses.end(), result->addresses.begin(), result->addresses.end());
+    if (result->ttl < r.ttl)
+      r.ttl = result->ttl;
+    if (r.canonical_name.empty() || q.type == dns_ops::type_a)
+      r.canonical_name = result->canonical_name;
+  } else {
+    if (result && result->ttl < r.negative_ttl)
+      r.negative_ttl = result->ttl;
+    if (dns_ops::failure_rank(ec) > dns_ops::failure_rank(r.ec))
+      r.ec = ec;
+  }
+  if (--r.pending == 0)
+    complete(q.owner);
+}
+
+void dns_resolver::complete(const std::shared_ptr<resolution> &r) {
+  --resolutions_;
+  if (r->ec != abnet::error::operation_aborted && (!r->v4.empty() || !r->v6.empty())) {
+    // Either family answering is a success.
+    r->result = make_result(*r, r->ec);
+  } else {
+    bool negative = r->ec == abnet::error::host_not_found || r->ec == abnet::error::no_data;
+    r->ttl = negative && r->negative_ttl != literal_ttl ? r->negative_ttl : 0;
+  }
+  ready_.push_back(r);
+}
+
+void dns_resolver::close_socket(query &q) {
+  if (q.socket == invalid_socket)
+    return;
+  socket_ops::state_type state = 0;
+  abnet::error_code ec;
+  socket_ops::close(q.socket, state, true, ec);
+  q.socket = invalid_socket;
+}
+
+addrinfo_type *dns_resolver::make_result(const resolution &r, abnet::error_code &ec) {
+  int socktypes[2] = {r.hints.ai_socktype, 0};
+  int protocols[2] = {r.hints.ai_protocol, 0};
+  std::size_t socktype_count = 1;
+  if (r.hints.ai_socktype == 0) {
+    socktypes[0] = SOCK_STREAM;
+    protocols[0] = IPPROTO_TCP;
+    socktypes[1] = SOCK_DGRAM;
+    protocols[1] = IPPROTO_UDP;
+    socktype_count = 2;
+  }
+
+  addrinfo_type *head = 0;
+  addrinfo_type **tail = &head;
+  const std::vector<std::string> *families[2] = {&r.v4, &r.v6};
+  for (std::size_t f = 0; f < 2; ++f) {
+    for (std::size_t i = 0; i < families[f]->size(); ++i) {
+      const std::string &address = (*families[f])[i];
+      for (std::size_t t = 0; t < socktype_count; ++t) {
+        dns_ops::result_node *node = static_cast<dns_ops::result_node *>(std::calloc(1, sizeof(*node)));
+        if (!node) {
+          freeaddrinfo(head);
+          ec = abnet::error::no_memory;
+          return 0;
+        }
+        addrinfo_type &ai = node->info;
+        ai.ai_socktype = socktypes[t];
+        ai.ai_protocol = protocols[t];
+        ai.ai_addr = reinterpret_cast<socket_addr_type *>(&node->address);
+        if (f == 0) {
+          ai.ai_family = AF_INET;
+          ai.ai_addrlen = sizeof(sockaddr_in4_type);
+          node->address.v4.sin_family = AF_INET;
+          node->address.v4.sin_port = socket_ops::host_to_network_short(r.port);
+          std::memcpy(&node->address.v4.sin_addr, address.data(), 4);
+        } else {
+          ai.ai_family = AF_INET6;
+          ai.ai_addrlen = sizeof(sockaddr_in6_type);
+          node->address.v6.sin6_family = AF_INET6;
+          node->address.v6.sin6_port = socket_ops::host_to_network_short(r.port);
+          node->address.v6.sin6_scope_id = static_cast<uint32_t>(r.scope_id);
+          std::memcpy(&node->address.v6.sin6_addr, address.data(), 16);
+        }
+        *tail = &ai;
+        tail = &ai.ai_next;
+      }
+    }
+  }
+
+  if (head && (r.hints.ai_flags & AI_CANONNAME)) {
+    head->ai_canonname = ::strdup(r.canonical_name.empty() ? r.name.c_str() : r.canonical_name.c_str());
+    if (!head->ai_canonname) {
+      freeaddrinfo(head);
+      ec = abnet::error::no_memory;
+      return 0;
+    }
+  }
+  abnet::error::clear(ec);
+  return head;
+}
+
+uint64_t dns_resolver::now_msec() {
+  timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(__linux__)
+
+#endif // ABNET_DNS_RESOLVER_IPP
@@ -0,0 +1,459 @@
+//
+// epoll_reactor.hpp
+// ~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_EPOLL_REACTOR_HPP
+#define ABNET_EPOLL_REACTOR_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_EPOLL)
+
+#include "abnet/error.hpp"
+#include "abnet/eventfd_interrupter.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/op_queue.hpp"
+#include "abnet/socket_ops.hpp"
+#include "abnet/socket_types.hpp"
+#include "abnet/timer_wheel.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <sys/epoll.h>
+#include <utility>
+
+#if defined(ABNET_HAS_EVENTFD)
+#include <atomic>
+#include <mutex>
+#endif // defined(ABNET_HAS_EVENTFD)
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// Base class for all operations queued on the reactor. The reactor calls
+// perform() whenever the descriptor becomes ready, and complete() once
+// perform() has reported that the operation is finished. complete() is
+// responsible for releasing the operation object, destroy() is used when the
+// reactor is torn down with the operation still pending.
+class reactor_op {
+public:
+  reactor_op() : bytes_transferred_(0), next_(0) {}
+
+  virtual bool perform() = 0;
+
+  virtual void complete() = 0;
+
+  // Release the operation without invoking its handler.
+  virtual void destroy() { delete this; }
+
+  // The error code to be passed to the completion handler.
+  abnet::error_code ec_;
+
+  // The number of bytes transferred, to be passed to the completion handler.
+  std::size_t bytes_transferred_;
+
+  // Intrusive link used by op_queue.
+  reactor_op *next_;
+
+protected:
+  virtual ~reactor_op() {}
+};
+
+class epoll_reactor : private noncopyable {
+public:
+  enum op_types { read_op = 0, write_op = 1, connect_op = 1, except_op = 2, max_ops = 3 };
+
+  // Per-descriptor queues.
+  struct descriptor_state {
+    descriptor_state *next_;
+    socket_type descriptor_;
+    uint32_t registered_events_;
+    op_queue<reactor_op> op_queue_[max_ops];
+    bool shutdown_;
+  };
+
+  // Per-descriptor data.
+  typedef descriptor_state *per_descriptor_data;
+
+  // Constructor. Creates the epoll descriptor, setting ec on failure.
+  ABNET_DECL explicit epoll_reactor(abnet::error_code &ec);
+
+  // Destructor. Destroys completed operations without invoking them. All
+  // descriptors must have been deregistered beforehand.
+  ABNET_DECL ~epoll_reactor();
+
+  // Whether the epoll descriptor was created successfully.
+  bool is_open() const { return epoll_fd_ != -1; }
+
+  // Register a socket with the reactor. The socket is switched to internal
+  // non-blocking mode, which is required by the non_blocking_* operations.
+  ABNET_DECL int register_descriptor(socket_type s, socket_ops::state_type &state, per_descriptor_data &data,
+                                     abnet::error_code &ec);
+
+  // Remove a socket from the reactor. Pending operations complete with
+  // operation_aborted. Must be called before the socket is closed.
+  ABNET_DECL void deregister_descriptor(socket_type s, per_descriptor_data &data);
+
+  // Start a new operation. The operation is performed immediately when
+  // allow_speculative is set and no other operation of the same type is
+  // queued, otherwise it is performed when the descriptor becomes ready.
+  ABNET_DECL void start_op(int op_type, per_descriptor_data &data, reactor_op *op, bool allow_speculative);
+
+  // Queue an operation which has already finished for completion.
+  ABNET_DECL void post_immediate_completion(reactor_op *op);
+
+  // Cancel all operations associated with the given descriptor. The handlers
+  // will be invoked with the operation_aborted error.
+  ABNET_DECL void cancel_ops(per_descriptor_data &data);
+
+#if defined(ABNET_HAS_EVENTFD)
+  // Queue a handler to run on the thread running the event loop, waking it if
+  // it is blocked in epoll_wait. Thread safe. Handler: void().
+  template <typename Handler> void post(Handler handler);
+
+  // Queue an operation for completion from any thread. Thread safe.
+  ABNET_DECL void post_deferred_completion(reactor_op *op);
+
+  // Wake the event loop if it is blocked in epoll_wait. Thread safe.
+  void interrupt() { interrupter_.interrupt(); }
+
+  // The interrupter used to wake the event loop, for its statistics.
+  const eventfd_interrupter &interrupter() const { return interrupter_; }
+#endif // defined(ABNET_HAS_EVENTFD)
+
+#if defined(ABNET_HAS_TIMERFD)
+  // Service a timer wheel from the event loop. Expired timer callbacks run on
+  // the loop thread, and armed timers keep run() going. At most one wheel may
+  // be registered, and it must be deregistered before it is destroyed.
+  ABNET_DECL int register_timer_wheel(timer_wheel &wheel, abnet::error_code &ec);
+
+  // Stop servicing the registered timer wheel.
+  ABNET_DECL void deregister_timer_wheel();
+#endif // defined(ABNET_HAS_TIMERFD)
+
+  // Receive data on a registered socket. Handler: void(const error_code&, size_t).
+  // The buffers must remain valid until the handler is called.
+  template <typename Handler>
+  void async_recv(per_descriptor_data &data, socket_ops::buf *bufs, std::size_t count, int flags, bool is_stream,
+                  Handler handler);
+
+  // Send data on a registered socket. Handler: void(const error_code&, size_t).
+  // The buffers must remain valid until the handler is called.
+  template <typename Handler>
+  void async_send(per_descriptor_data &data, const socket_ops::buf *bufs, std::size_t count, int flags,
+                  Handler handler);
+
+  // Accept a new connection on a registered listening socket.
+  // Handler: void(const error_code&, socket_type).
+  template <typename Handler>
+  void async_accept(per_descriptor_data &data, socket_ops::state_type state, void *addr, std::size_t *addrlen,
+                    Handler handler);
+
+  // Accept every connection waiting in the backlog of a registered listening
+  // socket, up to max_sockets, each time the socket becomes readable.
+  // Handler: void(const error_code&, socket_type *new_sockets, size_t count).
+  // The array must remain valid until the handler is called.
+  template <typename Handler>
+  void async_accept_batch(per_descriptor_data &data, socket_ops::state_type state, socket_type *new_sockets,
+                          std::size_t max_sockets, Handler handler);
+
+  // Connect a registered socket. Handler: void(const error_code&).
+  template <typename Handler>
+  void async_connect(per_descriptor_data &data, const void *addr, std::size_t addrlen, Handler handler);
+
+  // Run the event loop until stopped or there is no more outstanding work.
+  // Returns the number of handlers that were executed.
+  ABNET_DECL std::size_t run(abnet::error_code &ec);
+
+  // Run at most one handler, waiting up to msec milliseconds (-1 waits
+  // indefinitely) for a descriptor to become ready.
+  ABNET_DECL std::size_t run_one(int msec, abnet::error_code &ec);
+
+  // Run all handlers that are ready to run without blocking.
+  ABNET_DECL std::size_t poll(abnet::error_code &ec);
+
+  // Make run() and run_one() return as soon as possible.
+  void stop() { stopped_ = true; }
+
+  // Whether the reactor has been stopped.
+  bool stopped() const { return stopped_; }
+
+  // Prepare the reactor for a subsequent run() after being stopped.
+  void restart() { stopped_ = false; }
+
+  // The number of operations started but not yet completed.
+  std::size_t outstanding_work() const { return outstanding_work_; }
+
+private:
+  // Whether there is work which keeps run() going.
+  bool has_work() const {
+#if defined(ABNET_HAS_EVENTFD)
+    if (posted_work_.load(std::memory_order_acquire) > 0)
+      return true;
+#endif // defined(ABNET_HAS_EVENTFD)
+#if defined(ABNET_HAS_TIMERFD)
+    if (timer_wheel_ && timer_wheel_->size() > 0)
+      return true;
+#endif // defined(ABNET_HAS_TIMERFD)
+    return outstanding_work_ > 0;
+  }
+
+#if defined(ABNET_HAS_EVENTFD)
+  // Move operations posted from other threads to the ready queue.
+  ABNET_DECL void drain_posted();
+#endif // defined(ABNET_HAS_EVENTFD)
+
+  // Wait for events and move finished operations to the ready queue.
+  ABNET_DECL void run_reactor(int msec, abnet::error_code &ec);
+
+  // Perform queued operations on a descriptor after readiness was reported.
+  ABNET_DECL void perform_io(descriptor_state *d, uint32_t events);
+
+  // Run one handler from the ready queue, if any.
+  ABNET_DECL std::size_t do_one();
+
+  // Release descriptor states whose deregistration was deferred.
+  ABNET_DECL void free_descriptor_states();
+
+  // The maximum number of events fetched by a single epoll_wait.
+  enum { max_events = 128 };
+
+  // The epoll descriptor.
+  int epoll_fd_;
+
+  // Operations that are finished and waiting for their handler to run.
+  op_queue<reactor_op> ready_queue_;
+
+  // Deregistered states, freed once no event can still refer to them.
+  descriptor_state *pending_free_;
+
+  // The number of outstanding operations.
+  std::size_t outstanding_work_;
+
+  // Whether the event loop has been stopped.
+  bool stopped_;
+
+#if defined(ABNET_HAS_EVENTFD)
+  // Wakes epoll_wait when operations are posted from other threads. Its
+  // registration uses the interrupter's address as the epoll data, which can
+  // never collide with a descriptor_state.
+  eventfd_interrupter interrupter_;
+
+  // Protects posted_queue_.
+  std::mutex mutex_;
+
+  // Operations posted from other threads, not yet seen by the event loop.
+  op_queue<reactor_op> posted_queue_;
+
+  // The number of operations in posted_queue_.
+  std::atomic<std::size_t> posted_work_;
+#endif // defined(ABNET_HAS_EVENTFD)
+
+#if defined(ABNET_HAS_TIMERFD)
+  // The registered timer wheel, if any. Its address is used as the epoll data.
+  timer_wheel *timer_wheel_;
+#endif // defined(ABNET_HAS_TIMERFD)
+};
+
+template <typename Handler> class reactor_recv_op : public reactor_op {
+public:
+  reactor_recv_op(socket_type s, socket_ops::buf *bufs, std::size_t count, int flags, bool is_stream,
+                  Handler &handler)
+      : s_(s), bufs_(bufs), count_(count), flags_(flags), is_stream_(is_stream), handler_(std::move(handler)) {}
+
+  bool perform() {
+    return socket_ops::non_blocking_recv(s_, bufs_, count_, flags_, is_stream_, ec_, bytes_transferred_);
+  }
+
+  void complete() {
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    std::size_t bytes_transferred = bytes_transferred_;
+    delete this;
+    handler(ec, bytes_transferred);
+  }
+
+private:
+  socket_type s_;
+  socket_ops::buf *bufs_;
+  std::size_t count_;
+  int flags_;
+  bool is_stream_;
+  Handler handler_;
+};
+
+template <typename Handler> class reactor_send_op : public reactor_op {
+public:
+  reactor_send_op(socket_type s, const socket_ops::buf *bufs, std::size_t count, int flags, Handler &handler)
+      : s_(s), bufs_(bufs), count_(count), flags_(flags), handler_(std::move(handler)) {}
+
+  bool perform() { return socket_ops::non_blocking_send(s_, bufs_, count_, flags_, ec_, bytes_transferred_); }
+
+  void complete() {
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    std::size_t bytes_transferred = bytes_transferred_;
+    delete this;
+    handler(ec, bytes_transferred);
+  }
+
+private:
+  socket_type s_;
+  const socket_ops::buf *bufs_;
+  std::size_t count_;
+  int flags_;
+  Handler handler_;
+};
+
+template <typename Handler> class reactor_accept_op : public reactor_op {
+public:
+  reactor_accept_op(socket_type s, socket_ops::state_type state, void *addr, std::size_t *addrlen, Handler &handler)
+      : s_(s), state_(state), addr_(addr), addrlen_(addrlen), new_socket_(invalid_socket),
+        handler_(std::move(handler)) {}
+
+  bool perform() { return socket_ops::non_blocking_accept(s_, state_, addr_, addrlen_, ec_, new_socket_); }
+
+  void complete() {
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    socket_type new_socket = new_socket_;
+    delete this;
+    handler(ec, new_socket);
+  }
+
+private:
+  socket_type s_;
+  socket_ops::state_type state_;
+  void *addr_;
+  std::size_t *addrlen_;
+  socket_type new_socket_;
+  Handler handler_;
+};
+
+template <typename Handler> class reactor_accept_batch_op : public reactor_op {
+public:
+  reactor_accept_batch_op(socket_type s, socket_ops::state_type state, socket_type *new_sockets,
+                          std::size_t max_sockets, Handler &handler)
+      : s_(s), state_(state), new_sockets_(new_sockets), max_sockets_(max_sockets), handler_(std::move(handler)) {}
+
+  bool perform() {
+    return socket_ops::non_blocking_accept_batch(s_, state_, new_sockets_, max_sockets_, ec_, bytes_transferred_);
+  }
+
+  void complete() {
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    socket_type *new_sockets = new_sockets_;
+    std::size_t count = bytes_transferred_;
+    delete this;
+    handler(ec, new_sockets, count);
+  }
+
+private:
+  socket_type s_;
+  socket_ops::state_type state_;
+  socket_type *new_sockets_;
+  std::size_t max_sockets_;
+  Handler handler_;
+};
+
+template <typename Handler> class reactor_connect_op : public reactor_op {
+public:
+  reactor_connect_op(socket_type s, Handler &handler) : s_(s), handler_(std::move(handler)) {}
+
+  bool perform() { return socket_ops::non_blocking_connect(s_, ec_); }
+
+  void complete() {
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    delete this;
+    handler(ec);
+  }
+
+private:
+  socket_type s_;
+  Handler handler_;
+};
+
+#if defined(ABNET_HAS_EVENTFD)
+template <typename Handler> class reactor_post_op : public reactor_op {
+public:
+  explicit reactor_post_op(Handler &handler) : handler_(std::move(handler)) {}
+
+  bool perform() { return true; }
+
+  void complete() {
+    Handler handler(std::move(handler_));
+    delete this;
+    handler();
+  }
+
+private:
+  Handler handler_;
+};
+
+template <typename Handler> void epoll_reactor::post(Handler handler) {
+  post_deferred_completion(new reactor_post_op<Handler>(handler));
+}
+#endif // defined(ABNET_HAS_EVENTFD)
+
+template <typename Handler>
+void epoll_reactor::async_recv(per_descriptor_data &data, socket_ops::buf *bufs, std::size_t count, int flags,
+                               bool is_stream, Handler handler) {
+  reactor_op *op = new reactor_recv_op<Handler>(data->descriptor_, bufs, count, flags, is_stream, handler);
+  start_op((flags & MSG_OOB) ? except_op : read_op, data, op, (flags & MSG_OOB) == 0);
+}
+
+template <typename Handler>
+void epoll_reactor::async_send(per_descriptor_data &data, const socket_ops::buf *bufs, std::size_t count, int flags,
+                               Handler handler) {
+  reactor_op *op = new reactor_send_op<Handler>(data->descriptor_, bufs, count, flags, handler);
+  start_op(write_op, data, op, true);
+}
+
+template <typename Handler>
+void epoll_reactor::async_accept(per_descriptor_data &data, socket_ops::state_type state, void *addr,
+                                 std::size_t *addrlen, Handler handler) {
+  reactor_op *op = new reactor_accept_op<Handler>(data->descriptor_, state, addr, addrlen, handler);
+  start_op(read_op, data, op, true);
+}
+
+template <typename Handler>
+void epoll_reactor::async_accept_batch(per_descriptor_data &data, socket_ops::state_type state,
+                                       socket_type *new_sockets, std::size_t max_sockets, Handler handler) {
+  reactor_op *op = new reactor_accept_batch_op<Handler>(data->descriptor_, state, new_sockets, max_sockets, handler);
+  start_op(read_op, data, op, true);
+}
+
+template <typename Handler>
+void epoll_reactor::async_connect(per_descriptor_data &data, const void *addr, std::size_t addrlen, Handler handler) {
+  reactor_op *op = new reactor_connect_op<Handler>(data->descriptor_, handler);
+  if (socket_ops::connect(data->descriptor_, addr, addrlen, op->ec_) != 0) {
+    if (op->ec_ == abnet::error::in_progress || op->ec_ == abnet::error::would_block) {
+      // The connection is established asynchronously.
+      start_op(connect_op, data, op, false);
+      return;
+    }
+  }
+  post_immediate_completion(op);
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/epoll_reactor.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(ABNET_HAS_EPOLL)
+
+#endif // ABNET_EPOLL_REACTOR_HPP
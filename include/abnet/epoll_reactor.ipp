@@ -0,0 +1,336 @@
+//
+// epoll_reactor.ipp
+// ~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_EPOLL_REACTOR_IPP
+#define ABNET_EPOLL_REACTOR_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_EPOLL)
+
+#include <cerrno>
+#include <unistd.h>
+
+#include "abnet/epoll_reactor.hpp"
+#include "abnet/error.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+epoll_reactor::epoll_reactor(abnet::error_code &ec)
+    : epoll_fd_(-1), pending_free_(0), outstanding_work_(0), stopped_(false)
+#if defined(ABNET_HAS_EVENTFD)
+      ,
+      interrupter_(ec), posted_work_(0)
+#endif // defined(ABNET_HAS_EVENTFD)
+#if defined(ABNET_HAS_TIMERFD)
+      ,
+      timer_wheel_(0)
+#endif // defined(ABNET_HAS_TIMERFD)
+{
+#if defined(ABNET_HAS_EVENTFD)
+  if (ec)
+    return;
+#endif // defined(ABNET_HAS_EVENTFD)
+
+  epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ == -1) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return;
+  }
+
+#if defined(ABNET_HAS_EVENTFD)
+  epoll_event ev = {0, {0}};
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.ptr = &interrupter_;
+  if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, interrupter_.read_descriptor(), &ev) != 0) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    ::close(epoll_fd_);
+    epoll_fd_ = -1;
+    return;
+  }
+#endif // defined(ABNET_HAS_EVENTFD)
+
+  abnet::error::clear(ec);
+}
+
+epoll_reactor::~epoll_reactor() {
+  while (reactor_op *op = ready_queue_.pop())
+    op->destroy();
+#if defined(ABNET_HAS_EVENTFD)
+  while (reactor_op *op = posted_queue_.pop())
+    op->destroy();
+#endif // defined(ABNET_HAS_EVENTFD)
+  free_descriptor_states();
+  if (epoll_fd_ != -1)
+    ::close(epoll_fd_);
+}
+
+int epoll_reactor::register_descriptor(socket_type s, socket_ops::state_type &state, per_descriptor_data &data,
+                                       abnet::error_code &ec) {
+  if (!socket_ops::set_internal_non_blocking(s, state, true, ec))
+    return socket_error_retval;
+
+  data = new descriptor_state;
+  data->next_ = 0;
+  data->descriptor_ = s;
+  data->shutdown_ = false;
+
+  // Edge-triggered registration for all event types means the descriptor never
+  // needs to be modified while operations come and go.
+  epoll_event ev = {0, {0}};
+  ev.events = EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLPRI | EPOLLOUT | EPOLLET;
+  data->registered_events_ = ev.events;
+  ev.data.ptr = data;
+  int result = ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, s, &ev);
+  if (result != 0) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    delete data;
+    data = 0;
+    return result;
+  }
+
+  abnet::error::clear(ec);
+  return 0;
+}
+
+void epoll_reactor::deregister_descriptor(socket_type s, per_descriptor_data &data) {
+  if (!data)
+    return;
+
+  epoll_event ev = {0, {0}};
+  ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, s, &ev);
+
+  cancel_ops(data);
+  data->shutdown_ = true;
+
+  // Events for this descriptor may still be pending in the current batch, so
+  // the state is only released once the batch has been processed.
+  data->next_ = pending_free_;
+  pending_free_ = data;
+  data = 0;
+}
+
+void epoll_reactor::start_op(int op_type, per_descriptor_data &data, reactor_op *op, bool allow_speculative) {
+  ++outstanding_work_;
+
+  if (!data || data->shutdown_) {
+    op->ec_ = abnet::error::bad_descriptor;
+    ready_queue_.push(op);
+    return;
+  }
+
+  if (data->op_queue_[op_type].empty()) {
+    if (allow_speculative && (op_type != read_op || data->op_queue_[except_op].empty())) {
+      if (op->perform()) {
+        ready_queue_.push(op);
+        return;
+      }
+    }
+  }
+
+  data->op_queue_[op_type].push(op);
+}
+
+void epoll_reactor::post_immediate_completion(reactor_op *op) {
+  ++outstanding_work_;
+  ready_queue_.push(op);
+}
+
+#if defined(ABNET_HAS_EVENTFD)
+void epoll_reactor::post_deferred_completion(reactor_op *op) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    posted_queue_.push(op);
+    posted_work_.fetch_add(1, std::memory_order_release);
+  }
+  interrupter_.interrupt();
+}
+
+void epoll_reactor::drain_posted() {
+  op_queue<reactor_op> ops;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ops.push(posted_queue_);
+  }
+
+  // Count the operations as outstanding before they leave posted_work_, so
+  // run() never sees both counters at zero in between.
+  std::size_t n = 0;
+  while (reactor_op *op = ops.pop()) {
+    ready_queue_.push(op);
+    ++n;
+  }
+  outstanding_work_ += n;
+  posted_work_.fetch_sub(n, std::memory_order_release);
+}
+#endif // defined(ABNET_HAS_EVENTFD)
+
+#if defined(ABNET_HAS_TIMERFD)
+int epoll_reactor::register_timer_wheel(timer_wheel &wheel, abnet::error_code &ec) {
+  if (timer_wheel_) {
+    ec = abnet::error::already_open;
+    return socket_error_retval;
+  }
+
+  epoll_event ev = {0, {0}};
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.ptr = &wheel;
+  int result = ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wheel.descriptor(), &ev);
+  if (result != 0) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return result;
+  }
+
+  timer_wheel_ = &wheel;
+  abnet::error::clear(ec);
+  return 0;
+}
+
+void epoll_reactor::deregister_timer_wheel() {
+  if (!timer_wheel_)
+    return;
+
+  epoll_event ev = {0, {0}};
+  ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, timer_wheel_->descriptor(), &ev);
+  timer_wheel_ = 0;
+}
+#endif // defined(ABNET_HAS_TIMERFD)
+
+void epoll_reactor::cancel_ops(per_descriptor_data &data) {
+  if (!data)
+    return;
+
+  for (int i = 0; i < max_ops; ++i) {
+    while (reactor_op *op = data->op_queue_[i].pop()) {
+      op->ec_ = abnet::error::operation_aborted;
+      ready_queue_.push(op);
+    }
+  }
+}
+
+std::size_t epoll_reactor::run(abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  std::size_t n = 0;
+  while (!stopped_ && has_work()) {
+    if (ready_queue_.empty()) {
+      run_reactor(-1, ec);
+      if (ec)
+        return n;
+    }
+    n += do_one();
+  }
+  return n;
+}
+
+std::size_t epoll_reactor::run_one(int msec, abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  if (stopped_ || !has_work())
+    return 0;
+
+  if (ready_queue_.empty()) {
+    run_reactor(msec, ec);
+    if (ec)
+      return 0;
+  }
+  return do_one();
+}
+
+std::size_t epoll_reactor::poll(abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  if (stopped_ || !has_work())
+    return 0;
+
+  run_reactor(0, ec);
+  if (ec)
+    return 0;
+
+  std::size_t n = 0;
+  while (!stopped_ && !ready_queue_.empty())
+    n += do_one();
+  return n;
+}
+
+void epoll_reactor::run_reactor(int msec, abnet::error_code &ec) {
+  epoll_event events[max_events];
+  int num_events = ::epoll_wait(epoll_fd_, events, max_events, msec);
+  if (num_events < 0) {
+    if (errno == EINTR)
+      abnet::error::clear(ec);
+    else
+      ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return;
+  }
+
+  for (int i = 0; i < num_events; ++i) {
+#if defined(ABNET_HAS_EVENTFD)
+    if (events[i].data.ptr == &interrupter_) {
+      // Reset before draining, so that a post racing with the reset is
+      // picked up by the drain below or raises a fresh wakeup.
+      interrupter_.reset();
+      drain_posted();
+      continue;
+    }
+#endif // defined(ABNET_HAS_EVENTFD)
+#if defined(ABNET_HAS_TIMERFD)
+    if (timer_wheel_ && events[i].data.ptr == timer_wheel_) {
+      timer_wheel_->expire();
+      continue;
+    }
+#endif // defined(ABNET_HAS_TIMERFD)
+    descriptor_state *d = static_cast<descriptor_state *>(events[i].data.ptr);
+    if (!d->shutdown_)
+      perform_io(d, events[i].events);
+  }
+
+  free_descriptor_states();
+}
+
+void epoll_reactor::perform_io(descriptor_state *d, uint32_t events) {
+  static const uint32_t flag[max_ops] = {EPOLLIN, EPOLLOUT, EPOLLPRI};
+  for (int j = max_ops - 1; j >= 0; --j) {
+    if (events & (flag[j] | EPOLLERR | EPOLLHUP)) {
+      while (reactor_op *op = d->op_queue_[j].front()) {
+        if (!op->perform())
+          break;
+        d->op_queue_[j].pop();
+        ready_queue_.push(op);
+      }
+    }
+  }
+}
+
+std::size_t epoll_reactor::do_one() {
+  reactor_op *op = ready_queue_.pop();
+  if (!op)
+    return 0;
+
+  --outstanding_work_;
+  op->complete();
+  return 1;
+}
+
+void epoll_reactor::free_descriptor_states() {
+  while (descriptor_state *d = pending_free_) {
+    pending_free_ = d->next_;
+    delete d;
+  }
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(ABNET_HAS_EPOLL)
+
+#endif // ABNET_EPOLL_REACTOR_IPP
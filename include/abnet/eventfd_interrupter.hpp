@@ -0,0 +1,86 @@
+//
+// eventfd_interrupter.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_EVENTFD_INTERRUPTER_HPP
+#define ABNET_EVENTFD_INTERRUPTER_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_EVENTFD)
+
+#include "abnet/error.hpp"
+#include "abnet/noncopyable.hpp"
+#include <atomic>
+#include <cstddef>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// Wakes a thread blocked waiting for readiness on read_descriptor(). May be
+// interrupted from any thread. Interrupts raised before the waiting thread
+// calls reset() are coalesced into a single wakeup, so only the first of them
+// pays for the write to the eventfd.
+class eventfd_interrupter : private noncopyable {
+public:
+  // Constructor. Creates the eventfd, setting ec on failure.
+  ABNET_DECL explicit eventfd_interrupter(abnet::error_code &ec);
+
+  // Destructor.
+  ABNET_DECL ~eventfd_interrupter();
+
+  // Whether the eventfd was created successfully.
+  bool is_open() const { return fd_ != -1; }
+
+  // The descriptor which becomes readable when interrupted.
+  int read_descriptor() const { return fd_; }
+
+  // Make the read descriptor readable, unless it already is. Thread safe.
+  ABNET_DECL void interrupt();
+
+  // Consume the pending wakeup so the next interrupt makes the descriptor
+  // readable again. Called by the waiting thread. Returns true if the
+  // descriptor was readable.
+  ABNET_DECL bool reset();
+
+  // The number of calls to interrupt().
+  std::size_t interrupts() const { return interrupts_.load(std::memory_order_relaxed); }
+
+  // The number of interrupts that wrote to the eventfd.
+  std::size_t wakeups() const { return wakeups_.load(std::memory_order_relaxed); }
+
+  // The number of interrupts folded into a wakeup that was already pending.
+  std::size_t coalesced() const { return interrupts() - wakeups(); }
+
+private:
+  // The eventfd descriptor.
+  int fd_;
+
+  // Set while a wakeup is pending and not yet consumed by reset().
+  std::atomic<bool> pending_;
+
+  // Statistics.
+  std::atomic<std::size_t> interrupts_;
+  std::atomic<std::size_t> wakeups_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/eventfd_interrupter.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(ABNET_HAS_EVENTFD)
+
+#endif // ABNET_EVENTFD_INTERRUPTER_HPP
@@ -0,0 +1,78 @@
+//
+// eventfd_interrupter.ipp
+// ~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_EVENTFD_INTERRUPTER_IPP
+#define ABNET_EVENTFD_INTERRUPTER_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_EVENTFD)
+
+#include <cerrno>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "abnet/error.hpp"
+#include "abnet/eventfd_interrupter.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+eventfd_interrupter::eventfd_interrupter(abnet::error_code &ec)
+    : fd_(-1), pending_(false), interrupts_(0), wakeups_(0) {
+  fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fd_ == -1)
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+  else
+    abnet::error::clear(ec);
+}
+
+eventfd_interrupter::~eventfd_interrupter() {
+  if (fd_ != -1)
+    ::close(fd_);
+}
+
+void eventfd_interrupter::interrupt() {
+  interrupts_.fetch_add(1, std::memory_order_relaxed);
+  if (pending_.exchange(true, std::memory_order_acq_rel))
+    return;
+
+  wakeups_.fetch_add(1, std::memory_order_relaxed);
+  uint64_t counter = 1;
+  ssize_t result = ::write(fd_, &counter, sizeof(counter));
+  (void)result;
+}
+
+bool eventfd_interrupter::reset() {
+  // Drain before clearing the flag. An interrupt racing with the read either
+  // is consumed by it or still sees the flag set; in both cases the caller
+  // picks up its work because it inspects its queue after reset() returns.
+  // Clearing first would let the read swallow a fresh write while the flag
+  // stays set, suppressing every later interrupt().
+  uint64_t counter = 0;
+  ssize_t result;
+  do {
+    result = ::read(fd_, &counter, sizeof(counter));
+  } while (result < 0 && errno == EINTR);
+  pending_.store(false, std::memory_order_release);
+  return result > 0;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(ABNET_HAS_EVENTFD)
+
+#endif // ABNET_EVENTFD_INTERRUPTER_IPP
@@ -0,0 +1,137 @@
+//
+// hugepage_arena.hpp
+// ~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_HUGEPAGE_ARENA_HPP
+#define ABNET_HUGEPAGE_ARENA_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(__linux__)
+
+#include "abnet/error.hpp"
+#include "abnet/noncopyable.hpp"
+#include <cstddef>
+#include <vector>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// An arena of equally sized I/O buffers carved out of 2MB huge pages, so that
+// a large resident set of socket buffers needs far fewer TLB entries than
+// with 4K pages.
+//
+// The arena grows a region of huge pages at a time. A region is mapped with
+// MAP_HUGETLB when the system has huge pages reserved; otherwise it falls back
+// to ordinary memory aligned to 2MB and advised with MADV_HUGEPAGE, which lets
+// transparent huge pages back it where enabled. Released buffers are kept on a
+// free list and memory is only returned when the arena is destroyed.
+//
+// Given a NUMA node, each region is bound to it with mbind before it is
+// touched, so that an arena per node keeps buffers local to the threads of
+// that node.
+//
+// The arena is not thread safe; give each thread its own.
+class hugepage_arena : private noncopyable {
+public:
+  enum { huge_page_size = 2 * 1024 * 1024, default_region_pages = 4, buffer_alignment = 64 };
+
+  // Constructor. buffer_size is rounded up to a multiple of 64 bytes and must
+  // fit in a region. With use_hugetlb false, regions always take the
+  // MADV_HUGEPAGE path. Regions are bound to node unless it is -1. Sets ec on
+  // failure.
+  ABNET_DECL hugepage_arena(std::size_t buffer_size, abnet::error_code &ec,
+                            std::size_t region_pages = default_region_pages, bool use_hugetlb = true, int node = -1);
+
+  // Destructor. Unmaps every region, including buffers not yet released.
+  ABNET_DECL ~hugepage_arena();
+
+  // The size of each buffer.
+  std::size_t buffer_size() const { return buffer_size_; }
+
+  // Get a buffer, mapping a new region if none is free. Returns 0 with ec
+  // set if the region could not be mapped.
+  ABNET_DECL void *allocate(abnet::error_code &ec);
+
+  // Release a buffer obtained from allocate().
+  ABNET_DECL void deallocate(void *p);
+
+  // The NUMA node the regions are bound to, or -1.
+  int node() const { return node_; }
+
+  // The number of buffers handed out.
+  std::size_t buffers_in_use() const { return in_use_; }
+
+  // The number of regions mapped.
+  std::size_t regions() const { return regions_.size(); }
+
+  // The number of bytes mapped across all regions.
+  std::size_t bytes_mapped() const { return regions_.size() * region_size_; }
+
+  // The number of 2MB pages mapped with MAP_HUGETLB.
+  std::size_t hugetlb_pages() const { return hugetlb_pages_; }
+
+  // The number of 2MB pages mapped from ordinary memory and advised with
+  // MADV_HUGEPAGE.
+  std::size_t advised_pages() const { return advised_pages_; }
+
+  // The number of regions that could not use MAP_HUGETLB.
+  std::size_t fallbacks() const { return fallbacks_; }
+
+  // The number of regions left on 4K pages because madvise failed, as it
+  // does when transparent huge pages are disabled.
+  std::size_t advise_failures() const { return advise_failures_; }
+
+  // The number of regions that could not be bound to the node.
+  std::size_t bind_failures() const { return bind_failures_; }
+
+private:
+  // Map one more region to carve buffers from.
+  ABNET_DECL bool grow(abnet::error_code &ec);
+
+  struct region {
+    void *mapping_;
+    std::size_t mapping_size_;
+  };
+
+  std::size_t buffer_size_;
+  std::size_t region_size_;
+  bool use_hugetlb_;
+  int node_;
+  std::vector<region> regions_;
+
+  // The part of the newest region not yet handed out.
+  char *next_;
+  char *end_;
+
+  // Released buffers, linked through their first bytes.
+  void *free_;
+  std::size_t in_use_;
+
+  std::size_t hugetlb_pages_;
+  std::size_t advised_pages_;
+  std::size_t fallbacks_;
+  std::size_t advise_failures_;
+  std::size_t bind_failures_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/hugepage_arena.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(__linux__)
+
+#endif // ABNET_HUGEPAGE_ARENA_HPP
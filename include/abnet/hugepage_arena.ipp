@@ -0,0 +1,142 @@
+//
+// hugepage_arena.ipp
+// ~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_HUGEPAGE_ARENA_IPP
+#define ABNET_HUGEPAGE_ARENA_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <cstdint>
+#include <sys/mman.h>
+
+#include "abnet/error.hpp"
+#include "abnet/hugepage_arena.hpp"
+#include "abnet/numa.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+hugepage_arena::hugepage_arena(std::size_t buffer_size, abnet::error_code &ec, std::size_t region_pages,
+                               bool use_hugetlb, int node)
+    : buffer_size_((buffer_size + buffer_alignment - 1) / buffer_alignment * buffer_alignment),
+      region_size_(region_pages * huge_page_size), use_hugetlb_(use_hugetlb), node_(node), next_(0), end_(0),
+      free_(0), in_use_(0), hugetlb_pages_(0), advised_pages_(0), fallbacks_(0), advise_failures_(0),
+      bind_failures_(0) {
+  if (buffer_size == 0 || region_pages == 0 || buffer_size_ > region_size_)
+    ec = abnet::error::invalid_argument;
+  else
+    abnet::error::clear(ec);
+}
+
+hugepage_arena::~hugepage_arena() {
+  for (std::size_t i = 0; i < regions_.size(); ++i)
+    ::munmap(regions_[i].mapping_, regions_[i].mapping_size_);
+}
+
+void *hugepage_arena::allocate(abnet::error_code &ec) {
+  void *p = free_;
+  if (p) {
+    free_ = *static_cast<void **>(p);
+  } else {
+    // Carve from the newest region, which is only touched as it is used.
+    if (std::size_t(end_ - next_) < buffer_size_ && !grow(ec))
+      return 0;
+    p = next_;
+    next_ += buffer_size_;
+  }
+  abnet::error::clear(ec);
+  ++in_use_;
+  return p;
+}
+
+void hugepage_arena::deallocate(void *p) {
+  if (!p)
+    return;
+  *static_cast<void **>(p) = free_;
+  free_ = p;
+  --in_use_;
+}
+
+bool hugepage_arena::grow(abnet::error_code &ec) {
+  if (buffer_size_ == 0 || buffer_size_ > region_size_) {
+    ec = abnet::error::invalid_argument;
+    return false;
+  }
+
+  region r = {MAP_FAILED, region_size_};
+  char *start = 0;
+#if defined(MAP_HUGETLB)
+  if (use_hugetlb_) {
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+#if defined(MAP_HUGE_2MB)
+    flags |= MAP_HUGE_2MB;
+#endif // defined(MAP_HUGE_2MB)
+    r.mapping_ = ::mmap(0, region_size_, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (r.mapping_ != MAP_FAILED) {
+      start = static_cast<char *>(r.mapping_);
+      hugetlb_pages_ += region_size_ / huge_page_size;
+    }
+  }
+#endif // defined(MAP_HUGETLB)
+
+  if (!start) {
+    // Over-map by one huge page and trim, so the region starts on a 2MB
+    // boundary and every page in it can be backed by a huge page.
+    ++fallbacks_;
+    std::size_t size = region_size_ + huge_page_size;
+    void *mapping = ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      ec = abnet::error_code(errno, abnet::error::get_system_category());
+      return false;
+    }
+    uintptr_t base = reinterpret_cast<uintptr_t>(mapping);
+    uintptr_t aligned = (base + huge_page_size - 1) & ~uintptr_t(huge_page_size - 1);
+    if (aligned > base)
+      ::munmap(mapping, aligned - base);
+    if (aligned + region_size_ < base + size)
+      ::munmap(reinterpret_cast<void *>(aligned + region_size_), base + size - aligned - region_size_);
+    start = reinterpret_cast<char *>(aligned);
+    r.mapping_ = start;
+
+#if defined(MADV_HUGEPAGE)
+    if (::madvise(start, region_size_, MADV_HUGEPAGE) == 0)
+      advised_pages_ += region_size_ / huge_page_size;
+    else
+      ++advise_failures_;
+#else  // defined(MADV_HUGEPAGE)
+    ++advise_failures_;
+#endif // defined(MADV_HUGEPAGE)
+  }
+  regions_.push_back(r);
+
+  // Binding fails on kernels built without NUMA support. The region is still
+  // usable, only not placed.
+  abnet::error_code bind_ec;
+  if (node_ >= 0 && !numa_ops::bind_memory(start, region_size_, node_, bind_ec))
+    ++bind_failures_;
+
+  next_ = start;
+  end_ = start + region_size_;
+  return true;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(__linux__)
+
+#endif // ABNET_HUGEPAGE_ARENA_IPP
@@ -0,0 +1,162 @@
+//
+// io_uring_buffer_ring.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_IO_URING_BUFFER_RING_HPP
+#define ABNET_IO_URING_BUFFER_RING_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_IO_URING)
+
+#include "abnet/error.hpp"
+#include "abnet/io_uring_proactor.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/socket_types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <utility>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// A pool of equally sized receive buffers shared with the kernel through a
+// provided buffer ring. Receives submitted against the ring's group do not pin
+// a buffer while they wait; the kernel takes one from the ring only when data
+// arrives and reports its id in the completion.
+class io_uring_buffer_ring : private noncopyable {
+public:
+  // The buffer id reported when a completion did not consume a buffer. Buffer
+  // ids are 16 bits wide, so this never names a real buffer.
+  enum { no_buffer = 0x10000 };
+
+  // Constructor. Allocates entries buffers of buffer_size bytes and registers
+  // them under group_id, setting ec on failure. entries must be a power of two.
+  ABNET_DECL io_uring_buffer_ring(io_uring_proactor &proactor, uint16_t group_id, unsigned entries,
+                                  std::size_t buffer_size, abnet::error_code &ec);
+
+  // Destructor. Unregisters the ring and releases the buffers.
+  ABNET_DECL ~io_uring_buffer_ring();
+
+  // Whether the ring was registered successfully.
+  bool is_open() const { return registered_; }
+
+  // The buffer group id to select buffers from.
+  uint16_t group_id() const { return group_id_; }
+
+  // The size of each buffer.
+  std::size_t buffer_size() const { return buffer_size_; }
+
+  // The number of buffers in the pool.
+  unsigned entries() const { return entries_; }
+
+  // The data of the buffer with the given id.
+  void *buffer(unsigned bid) const { return buffers_ + bid * buffer_size_; }
+
+  // Hand a buffer back to the kernel once its contents have been consumed.
+  ABNET_DECL void recycle(unsigned bid);
+
+  // The number of buffers currently held by the application.
+  std::size_t buffers_in_use() const { return in_use_; }
+
+  // Receive into a buffer picked by the kernel when data arrives.
+  // Handler: void(const error_code&, unsigned bid, size_t bytes_transferred).
+  // Unless bid is no_buffer, the buffer must be recycled once the handler has
+  // consumed it. Running out of buffers completes with no_buffer_space.
+  template <typename Handler> void async_recv(socket_type s, int flags, bool is_stream, Handler handler);
+
+private:
+  // Mark a buffer as taken by a completion.
+  void acquire() { ++in_use_; }
+
+  // The ring entry at the given position. The entries start at the beginning of
+  // the ring, but the uapi flexible array member is laid out after an empty
+  // struct when compiled as C++, so index from the ring itself.
+  io_uring_buf &ring_entry(unsigned pos) const {
+    return reinterpret_cast<io_uring_buf *>(ring_)[pos & (entries_ - 1)];
+  }
+
+  template <typename Handler> friend class io_uring_buffer_recv_op;
+
+  io_uring_proactor &proactor_;
+  uint16_t group_id_;
+  unsigned entries_;
+  std::size_t buffer_size_;
+  io_uring_buf_ring *ring_;
+  std::size_t ring_size_;
+  char *buffers_;
+  std::size_t buffers_size_;
+  uint16_t tail_;
+  std::size_t in_use_;
+  bool registered_;
+};
+
+template <typename Handler> class io_uring_buffer_recv_op : public io_uring_op {
+public:
+  io_uring_buffer_recv_op(io_uring_buffer_ring &ring, socket_type s, int flags, bool is_stream, Handler &handler)
+      : ring_(ring), s_(s), flags_(flags), is_stream_(is_stream), handler_(std::move(handler)) {}
+
+  void prepare(io_uring_sqe *sqe) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = s_;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = ring_.group_id();
+    sqe->msg_flags = flags_;
+  }
+
+  void complete() {
+    io_uring_result_to_error(res_, ec_);
+    bytes_transferred_ = ec_ ? 0 : res_;
+
+    // The kernel reports an empty ring as ENOBUFS.
+    unsigned bid = io_uring_buffer_ring::no_buffer;
+    if (cqe_flags_ & IORING_CQE_F_BUFFER) {
+      bid = cqe_flags_ >> IORING_CQE_BUFFER_SHIFT;
+      ring_.acquire();
+    }
+
+    // Check for end of stream. A buffer may still have been consumed.
+    if (!ec_ && is_stream_ && res_ == 0)
+      ec_ = abnet::error::eof;
+
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    std::size_t bytes_transferred = bytes_transferred_;
+    delete this;
+    handler(ec, bid, bytes_transferred);
+  }
+
+private:
+  io_uring_buffer_ring &ring_;
+  socket_type s_;
+  int flags_;
+  bool is_stream_;
+  Handler handler_;
+};
+
+template <typename Handler>
+void io_uring_buffer_ring::async_recv(socket_type s, int flags, bool is_stream, Handler handler) {
+  proactor_.start_op(new io_uring_buffer_recv_op<Handler>(*this, s, flags, is_stream, handler));
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/io_uring_buffer_ring.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(ABNET_HAS_IO_URING)
+
+#endif // ABNET_IO_URING_BUFFER_RING_HPP
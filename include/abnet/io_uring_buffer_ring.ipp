@@ -0,0 +1,111 @@
+//
+// io_uring_buffer_ring.ipp
+// ~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_IO_URING_BUFFER_RING_IPP
+#define ABNET_IO_URING_BUFFER_RING_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_IO_URING)
+
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+
+#include "abnet/error.hpp"
+#include "abnet/io_uring_buffer_ring.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+io_uring_buffer_ring::io_uring_buffer_ring(io_uring_proactor &proactor, uint16_t group_id, unsigned entries,
+                                           std::size_t buffer_size, abnet::error_code &ec)
+    : proactor_(proactor), group_id_(group_id), entries_(entries), buffer_size_(buffer_size), ring_(0),
+      ring_size_(0), buffers_(0), buffers_size_(0), tail_(0), in_use_(0), registered_(false) {
+  if (entries == 0 || (entries & (entries - 1)) != 0 || entries > 32768 || buffer_size == 0) {
+    ec = abnet::error::invalid_argument;
+    return;
+  }
+
+  // The ring must be page aligned, which mmap guarantees.
+  ring_size_ = entries * sizeof(io_uring_buf);
+  void *ring = ::mmap(0, ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return;
+  }
+  ring_ = static_cast<io_uring_buf_ring *>(ring);
+
+  buffers_size_ = entries * buffer_size;
+  void *buffers = ::mmap(0, buffers_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffers == MAP_FAILED) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return;
+  }
+  buffers_ = static_cast<char *>(buffers);
+
+  io_uring_buf_reg reg;
+  std::memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(ring_);
+  reg.ring_entries = entries;
+  reg.bgid = group_id;
+  if (proactor_.register_resource(IORING_REGISTER_PBUF_RING, &reg, 1, ec) < 0)
+    return;
+  registered_ = true;
+
+  // Publish every buffer to the kernel.
+  for (unsigned bid = 0; bid < entries; ++bid) {
+    io_uring_buf *b = &ring_entry(tail_ + bid);
+    b->addr = reinterpret_cast<uint64_t>(buffer(bid));
+    b->len = static_cast<uint32_t>(buffer_size_);
+    b->bid = static_cast<uint16_t>(bid);
+  }
+  tail_ = static_cast<uint16_t>(tail_ + entries);
+  __atomic_store_n(&ring_->tail, tail_, __ATOMIC_RELEASE);
+}
+
+io_uring_buffer_ring::~io_uring_buffer_ring() {
+  if (registered_) {
+    io_uring_buf_reg reg;
+    std::memset(&reg, 0, sizeof(reg));
+    reg.bgid = group_id_;
+    abnet::error_code ec;
+    proactor_.register_resource(IORING_UNREGISTER_PBUF_RING, &reg, 1, ec);
+  }
+  if (buffers_)
+    ::munmap(buffers_, buffers_size_);
+  if (ring_)
+    ::munmap(ring_, ring_size_);
+}
+
+void io_uring_buffer_ring::recycle(unsigned bid) {
+  if (bid >= entries_)
+    return;
+
+  io_uring_buf *b = &ring_entry(tail_);
+  b->addr = reinterpret_cast<uint64_t>(buffer(bid));
+  b->len = static_cast<uint32_t>(buffer_size_);
+  b->bid = static_cast<uint16_t>(bid);
+  ++tail_;
+  __atomic_store_n(&ring_->tail, tail_, __ATOMIC_RELEASE);
+  if (in_use_ > 0)
+    --in_use_;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(ABNET_HAS_IO_URING)
+
+#endif // ABNET_IO_URING_BUFFER_RING_IPP
@@ -0,0 +1,474 @@
+//
+// io_uring_proactor.hpp
+// ~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_IO_URING_PROACTOR_HPP
+#define ABNET_IO_URING_PROACTOR_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_IO_URING)
+
+#include "abnet/error.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/op_queue.hpp"
+#include "abnet/socket_ops.hpp"
+#include "abnet/socket_types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <utility>
+#include <vector>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// Base class for all operations submitted to the io_uring proactor. prepare()
+// fills in the submission queue entry, and complete() is called once the
+// corresponding completion queue entry has been reaped. complete() is
+// responsible for releasing the operation object, destroy() is used when the
+// proactor is torn down with the operation still pending. Multishot operations
+// stay armed across several completions and are only released after the
+// completion without IORING_CQE_F_MORE.
+class io_uring_op {
+public:
+  io_uring_op() : bytes_transferred_(0), res_(0), cqe_flags_(0), multishot_armed_(false), next_(0) {}
+
+  virtual void prepare(io_uring_sqe *sqe) = 0;
+
+  // Record a completion queue entry. Returns true if the operation needs to be
+  // added to the ready queue.
+  virtual bool deliver(int res, uint32_t flags) {
+    res_ = res;
+    cqe_flags_ = flags;
+    return true;
+  }
+
+  virtual void complete() = 0;
+
+  // Release the operation without invoking its handler.
+  virtual void destroy() { delete this; }
+
+  // The error code to be passed to the completion handler.
+  abnet::error_code ec_;
+
+  // The number of bytes transferred, to be passed to the completion handler.
+  std::size_t bytes_transferred_;
+
+  // The raw result and flags of the completion queue entry.
+  int res_;
+  uint32_t cqe_flags_;
+
+  // Whether the kernel will post further completions for this operation.
+  bool multishot_armed_;
+
+  // Intrusive link used by op_queue.
+  io_uring_op *next_;
+
+protected:
+  virtual ~io_uring_op() {}
+};
+
+class io_uring_proactor : private noncopyable {
+public:
+  // The default number of submission queue entries.
+  enum { default_entries = 256 };
+
+  // Constructor. Sets up the ring, setting ec on failure.
+  ABNET_DECL explicit io_uring_proactor(abnet::error_code &ec, unsigned entries = default_entries);
+
+  // Destructor. Destroys completed operations without invoking them. All
+  // submitted operations must have completed beforehand.
+  ABNET_DECL ~io_uring_proactor();
+
+  // Whether the ring was set up successfully.
+  bool is_open() const { return ring_fd_ != -1; }
+
+  // Queue an operation. The submission queue entry is only handed to the
+  // kernel on the next submit(), run(), run_one() or poll(), so operations
+  // started back to back are submitted with a single io_uring_enter.
+  ABNET_DECL void start_op(io_uring_op *op);
+
+  // Queue an operation which has already finished for completion.
+  ABNET_DECL void post_immediate_completion(io_uring_op *op);
+
+  // Hand all queued submission queue entries to the kernel. Returns the
+  // number of entries submitted.
+  ABNET_DECL std::size_t submit(abnet::error_code &ec);
+
+  // Register a resource such as a buffer ring with the kernel. Returns the
+  // io_uring_register result.
+  ABNET_DECL int register_resource(unsigned opcode, const void *arg, unsigned nr_args, abnet::error_code &ec);
+
+  // Accept a new connection. Handler: void(const error_code&, socket_type).
+  template <typename Handler>
+  void async_accept(socket_type s, void *addr, std::size_t *addrlen, Handler handler);
+
+  // Accept connections with a single multishot accept that stays armed until
+  // cancelled or failed. Every connection reaped in one wakeup is handed to the
+  // handler as a batch. Returns the operation so it can be passed to cancel_op.
+  // Handler: void(const error_code&, socket_type *new_sockets, size_t count).
+  template <typename Handler> io_uring_op *async_multishot_accept(socket_type s, Handler handler);
+
+  // Ask the kernel to cancel a submitted operation. It completes with
+  // operation_aborted unless it finished first.
+  ABNET_DECL void cancel_op(io_uring_op *op);
+
+  // Connect a socket. Handler: void(const error_code&).
+  // The address must remain valid until the handler is called.
+  template <typename Handler>
+  void async_connect(socket_type s, const void *addr, std::size_t addrlen, Handler handler);
+
+  // Receive data with recvmsg. Handler: void(const error_code&, size_t).
+  // The buffers must remain valid until the handler is called.
+  template <typename Handler>
+  void async_recvmsg(socket_type s, socket_ops::buf *bufs, std::size_t count, int flags, bool is_stream,
+                     Handler handler);
+
+  // Send data with sendmsg. Handler: void(const error_code&, size_t).
+  // The buffers must remain valid until the handler is called.
+  template <typename Handler>
+  void async_sendmsg(socket_type s, const socket_ops::buf *bufs, std::size_t count, int flags, Handler handler);
+
+  // Run the event loop until stopped or there is no more outstanding work.
+  // Returns the number of handlers that were executed.
+  ABNET_DECL std::size_t run(abnet::error_code &ec);
+
+  // Run at most one handler, waiting up to msec milliseconds (-1 waits
+  // indefinitely) for an operation to complete.
+  ABNET_DECL std::size_t run_one(int msec, abnet::error_code &ec);
+
+  // Run all handlers that are ready to run without blocking.
+  ABNET_DECL std::size_t poll(abnet::error_code &ec);
+
+  // Make run() and run_one() return as soon as possible.
+  void stop() { stopped_ = true; }
+
+  // Whether the proactor has been stopped.
+  bool stopped() const { return stopped_; }
+
+  // Prepare the proactor for a subsequent run() after being stopped.
+  void restart() { stopped_ = false; }
+
+  // The number of operations started but not yet completed.
+  std::size_t outstanding_work() const { return outstanding_work_; }
+
+  // The number of io_uring_enter calls made so far.
+  std::size_t enter_calls() const { return enter_calls_; }
+
+  // The number of submission queue entries handed to the kernel so far.
+  std::size_t sqes_submitted() const { return sqes_submitted_; }
+
+private:
+  // Get a free submission queue entry, submitting queued ones if the ring is
+  // full. Returns 0 if no entry could be made available.
+  ABNET_DECL io_uring_sqe *get_sqe();
+
+  // Publish the locally prepared entries to the kernel-visible tail.
+  ABNET_DECL void flush_sqes();
+
+  // Submit queued entries and wait for completions in one io_uring_enter.
+  ABNET_DECL void run_ring(int msec, abnet::error_code &ec);
+
+  // Move completed operations from the completion ring to the ready queue.
+  ABNET_DECL void reap_cqes();
+
+  // Run one handler from the ready queue, if any.
+  ABNET_DECL std::size_t do_one();
+
+  // The user_data values reserved for internal cancellations, and for the
+  // timeout bounding a wait in run_one().
+  enum { internal_user_data = 0, wait_timeout_user_data = 1 };
+
+  // The ring descriptor.
+  int ring_fd_;
+
+  // Mappings of the submission ring, completion ring and entry array.
+  void *sq_ring_ptr_;
+  std::size_t sq_ring_size_;
+  void *cq_ring_ptr_;
+  std::size_t cq_ring_size_;
+  io_uring_sqe *sqes_;
+  std::size_t sqes_size_;
+
+  // Pointers into the submission ring.
+  unsigned *sq_head_;
+  unsigned *sq_tail_;
+  unsigned *sq_mask_;
+  unsigned *sq_entries_;
+  unsigned *sq_array_;
+
+  // Pointers into the completion ring.
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned *cq_mask_;
+  io_uring_cqe *cqes_;
+
+  // The next submission queue entry to be handed out.
+  unsigned sqe_tail_;
+
+  // The timeout used by run_one() when waiting for a bounded time.
+  __kernel_timespec wait_timeout_;
+
+  // Set while the wait timeout is in the kernel and its completion has not
+  // been reaped.
+  bool wait_timeout_armed_;
+
+  // Operations that are finished and waiting for their handler to run.
+  op_queue<io_uring_op> ready_queue_;
+
+  // The number of outstanding operations.
+  std::size_t outstanding_work_;
+
+  // Submission statistics.
+  std::size_t enter_calls_;
+  std::size_t sqes_submitted_;
+
+  // Whether the event loop has been stopped.
+  bool stopped_;
+};
+
+// Map a completion queue result to an error code.
+inline void io_uring_result_to_error(int res, abnet::error_code &ec) {
+  if (res < 0)
+    ec = abnet::error_code(-res, abnet::error::get_system_category());
+  else
+    abnet::error::clear(ec);
+}
+
+template <typename Handler> class io_uring_accept_op : public io_uring_op {
+public:
+  io_uring_accept_op(socket_type s, void *addr, std::size_t *addrlen, Handler &handler)
+      : s_(s), addr_(addr), addrlen_(addrlen), sock_addrlen_(addrlen ? static_cast<socklen_t>(*addrlen) : 0),
+        handler_(std::move(handler)) {}
+
+  void prepare(io_uring_sqe *sqe) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = s_;
+    sqe->addr = reinterpret_cast<uint64_t>(addr_);
+    sqe->addr2 = addrlen_ ? reinterpret_cast<uint64_t>(&sock_addrlen_) : 0;
+    sqe->accept_flags = SOCK_CLOEXEC;
+  }
+
+  void complete() {
+    io_uring_result_to_error(res_, ec_);
+    if (!ec_ && addrlen_)
+      *addrlen_ = sock_addrlen_;
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    socket_type new_socket = ec ? invalid_socket : res_;
+    delete this;
+    handler(ec, new_socket);
+  }
+
+private:
+  socket_type s_;
+  void *addr_;
+  std::size_t *addrlen_;
+  socklen_t sock_addrlen_;
+  Handler handler_;
+};
+
+template <typename Handler> class io_uring_multishot_accept_op : public io_uring_op {
+public:
+  io_uring_multishot_accept_op(socket_type s, Handler &handler) : s_(s), queued_(false), handler_(std::move(handler)) {
+    multishot_armed_ = true;
+  }
+
+  void prepare(io_uring_sqe *sqe) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = s_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+  }
+
+  bool deliver(int res, uint32_t flags) {
+    multishot_armed_ = (flags & IORING_CQE_F_MORE) != 0;
+    if (res >= 0)
+      new_sockets_.push_back(res);
+    else
+      res_ = res;
+
+    // Only the first completion of a wakeup queues the operation, the later
+    // ones join the same batch.
+    bool first = !queued_;
+    queued_ = true;
+    return first;
+  }
+
+  void complete() {
+    queued_ = false;
+    io_uring_result_to_error(res_, ec_);
+    res_ = 0;
+    batch_.swap(new_sockets_);
+    new_sockets_.clear();
+
+    if (multishot_armed_) {
+      handler_(ec_, batch_.data(), batch_.size());
+      return;
+    }
+
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    std::vector<socket_type> batch;
+    batch.swap(batch_);
+    delete this;
+    handler(ec, batch.data(), batch.size());
+  }
+
+private:
+  socket_type s_;
+  bool queued_;
+  std::vector<socket_type> new_sockets_;
+  std::vector<socket_type> batch_;
+  Handler handler_;
+};
+
+template <typename Handler> class io_uring_connect_op : public io_uring_op {
+public:
+  io_uring_connect_op(socket_type s, const void *addr, std::size_t addrlen, Handler &handler)
+      : s_(s), addr_(addr), addrlen_(addrlen), handler_(std::move(handler)) {}
+
+  void prepare(io_uring_sqe *sqe) {
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = s_;
+    sqe->addr = reinterpret_cast<uint64_t>(addr_);
+    sqe->off = addrlen_;
+  }
+
+  void complete() {
+    io_uring_result_to_error(res_, ec_);
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    delete this;
+    handler(ec);
+  }
+
+private:
+  socket_type s_;
+  const void *addr_;
+  std::size_t addrlen_;
+  Handler handler_;
+};
+
+template <typename Handler> class io_uring_recvmsg_op : public io_uring_op {
+public:
+  io_uring_recvmsg_op(socket_type s, socket_ops::buf *bufs, std::size_t count, int flags, bool is_stream,
+                      Handler &handler)
+      : s_(s), flags_(flags), is_stream_(is_stream), msg_(msghdr()), handler_(std::move(handler)) {
+    msg_.msg_iov = bufs;
+    msg_.msg_iovlen = count;
+  }
+
+  void prepare(io_uring_sqe *sqe) {
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = s_;
+    sqe->addr = reinterpret_cast<uint64_t>(&msg_);
+    sqe->len = 1;
+    sqe->msg_flags = flags_;
+  }
+
+  void complete() {
+    io_uring_result_to_error(res_, ec_);
+    bytes_transferred_ = ec_ ? 0 : res_;
+
+    // Check for end of stream.
+    if (!ec_ && is_stream_ && res_ == 0 && msg_.msg_iovlen > 0)
+      ec_ = abnet::error::eof;
+
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    std::size_t bytes_transferred = bytes_transferred_;
+    delete this;
+    handler(ec, bytes_transferred);
+  }
+
+private:
+  socket_type s_;
+  int flags_;
+  bool is_stream_;
+  msghdr msg_;
+  Handler handler_;
+};
+
+template <typename Handler> class io_uring_sendmsg_op : public io_uring_op {
+public:
+  io_uring_sendmsg_op(socket_type s, const socket_ops::buf *bufs, std::size_t count, int flags, Handler &handler)
+      : s_(s), flags_(flags), msg_(msghdr()), handler_(std::move(handler)) {
+    msg_.msg_iov = const_cast<socket_ops::buf *>(bufs);
+    msg_.msg_iovlen = count;
+  }
+
+  void prepare(io_uring_sqe *sqe) {
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = s_;
+    sqe->addr = reinterpret_cast<uint64_t>(&msg_);
+    sqe->len = 1;
+    sqe->msg_flags = flags_ | MSG_NOSIGNAL;
+  }
+
+  void complete() {
+    io_uring_result_to_error(res_, ec_);
+    bytes_transferred_ = ec_ ? 0 : res_;
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    std::size_t bytes_transferred = bytes_transferred_;
+    delete this;
+    handler(ec, bytes_transferred);
+  }
+
+private:
+  socket_type s_;
+  int flags_;
+  msghdr msg_;
+  Handler handler_;
+};
+
+template <typename Handler>
+void io_uring_proactor::async_accept(socket_type s, void *addr, std::size_t *addrlen, Handler handler) {
+  start_op(new io_uring_accept_op<Handler>(s, addr, addrlen, handler));
+}
+
+template <typename Handler> io_uring_op *io_uring_proactor::async_multishot_accept(socket_type s, Handler handler) {
+  io_uring_op *op = new io_uring_multishot_accept_op<Handler>(s, handler);
+  start_op(op);
+  return op;
+}
+
+template <typename Handler>
+void io_uring_proactor::async_connect(socket_type s, const void *addr, std::size_t addrlen, Handler handler) {
+  start_op(new io_uring_connect_op<Handler>(s, addr, addrlen, handler));
+}
+
+template <typename Handler>
+void io_uring_proactor::async_recvmsg(socket_type s, socket_ops::buf *bufs, std::size_t count, int flags,
+                                      bool is_stream, Handler handler) {
+  start_op(new io_uring_recvmsg_op<Handler>(s, bufs, count, flags, is_stream, handler));
+}
+
+template <typename Handler>
+void io_uring_proactor::async_sendmsg(socket_type s, const socket_ops::buf *bufs, std::size_t count, int flags,
+                                      Handler handler) {
+  start_op(new io_uring_sendmsg_op<Handler>(s, bufs, count, flags, handler));
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/io_uring_proactor.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(ABNET_HAS_IO_URING)
+
+#endif // ABNET_IO_URING_PROACTOR_HPP
@@ -0,0 +1,359 @@
+//
+// io_uring_proactor.ipp
+// ~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_IO_URING_PROACTOR_IPP
+#define ABNET_IO_URING_PROACTOR_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_IO_URING)
+
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "abnet/error.hpp"
+#include "abnet/io_uring_proactor.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+namespace io_uring_ops {
+
+inline int setup(unsigned entries, io_uring_params *p) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+inline int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, 0, 0));
+}
+
+inline int register_resource(int fd, unsigned opcode, const void *arg, unsigned nr_args) {
+  return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+inline unsigned load_acquire(const unsigned *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+
+inline void store_release(unsigned *p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+} // namespace io_uring_ops
+
+io_uring_proactor::io_uring_proactor(abnet::error_code &ec, unsigned entries)
+    : ring_fd_(-1), sq_ring_ptr_(MAP_FAILED), sq_ring_size_(0), cq_ring_ptr_(MAP_FAILED), cq_ring_size_(0),
+      sqes_(static_cast<io_uring_sqe *>(MAP_FAILED)), sqes_size_(0), sq_head_(0), sq_tail_(0), sq_mask_(0),
+      sq_entries_(0), sq_array_(0), cq_head_(0), cq_tail_(0), cq_mask_(0), cqes_(0), sqe_tail_(0),
+      wait_timeout_armed_(false), outstanding_work_(0), enter_calls_(0), sqes_submitted_(0), stopped_(false) {
+  std::memset(&wait_timeout_, 0, sizeof(wait_timeout_));
+
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  int fd = io_uring_ops::setup(entries, &params);
+  if (fd < 0) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return;
+  }
+  ring_fd_ = fd;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (cq_ring_size_ > sq_ring_size_)
+      sq_ring_size_ = cq_ring_size_;
+    cq_ring_size_ = sq_ring_size_;
+  }
+
+  sq_ring_ptr_ = ::mmap(0, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (sq_ring_ptr_ == MAP_FAILED) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return;
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    cq_ring_ptr_ = sq_ring_ptr_;
+  } else {
+    cq_ring_ptr_ =
+        ::mmap(0, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_ring_ptr_ == MAP_FAILED) {
+      ec = abnet::error_code(errno, abnet::error::get_system_category());
+      return;
+    }
+  }
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = ::mmap(0, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return;
+  }
+  sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+  char *sq = static_cast<char *>(sq_ring_ptr_);
+  sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_entries_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  sqe_tail_ = *sq_tail_;
+
+  char *cq = static_cast<char *>(cq_ring_ptr_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+  abnet::error::clear(ec);
+}
+
+io_uring_proactor::~io_uring_proactor() {
+  while (io_uring_op *op = ready_queue_.pop())
+    op->destroy();
+  if (sqes_ != MAP_FAILED)
+    ::munmap(sqes_, sqes_size_);
+  if (cq_ring_ptr_ != MAP_FAILED && cq_ring_ptr_ != sq_ring_ptr_)
+    ::munmap(cq_ring_ptr_, cq_ring_size_);
+  if (sq_ring_ptr_ != MAP_FAILED)
+    ::munmap(sq_ring_ptr_, sq_ring_size_);
+  if (ring_fd_ != -1)
+    ::close(ring_fd_);
+}
+
+void io_uring_proactor::start_op(io_uring_op *op) {
+  ++outstanding_work_;
+
+  io_uring_sqe *sqe = get_sqe();
+  if (!sqe) {
+    op->res_ = -EBUSY;
+    ready_queue_.push(op);
+    return;
+  }
+
+  op->prepare(sqe);
+  sqe->user_data = reinterpret_cast<uint64_t>(op);
+}
+
+void io_uring_proactor::post_immediate_completion(io_uring_op *op) {
+  ++outstanding_work_;
+  ready_queue_.push(op);
+}
+
+int io_uring_proactor::register_resource(unsigned opcode, const void *arg, unsigned nr_args, abnet::error_code &ec) {
+  int result = io_uring_ops::register_resource(ring_fd_, opcode, arg, nr_args);
+  if (result < 0)
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+  else
+    abnet::error::clear(ec);
+  return result;
+}
+
+void io_uring_proactor::cancel_op(io_uring_op *op) {
+  if (io_uring_sqe *sqe = get_sqe()) {
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(op);
+    sqe->user_data = internal_user_data;
+  }
+}
+
+std::size_t io_uring_proactor::submit(abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  flush_sqes();
+  unsigned to_submit = *sq_tail_ - io_uring_ops::load_acquire(sq_head_);
+  if (to_submit == 0)
+    return 0;
+
+  ++enter_calls_;
+  int result = io_uring_ops::enter(ring_fd_, to_submit, 0, 0);
+  if (result < 0) {
+    if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+      ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return 0;
+  }
+  sqes_submitted_ += result;
+  return result;
+}
+
+std::size_t io_uring_proactor::run(abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  std::size_t n = 0;
+  while (!stopped_ && outstanding_work_ > 0) {
+    if (ready_queue_.empty()) {
+      run_ring(-1, ec);
+      if (ec)
+        return n;
+    }
+    n += do_one();
+  }
+  return n;
+}
+
+std::size_t io_uring_proactor::run_one(int msec, abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  if (stopped_ || outstanding_work_ == 0)
+    return 0;
+
+  if (ready_queue_.empty()) {
+    run_ring(msec, ec);
+    if (ec)
+      return 0;
+  }
+  return do_one();
+}
+
+std::size_t io_uring_proactor::poll(abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  if (stopped_ || outstanding_work_ == 0)
+    return 0;
+
+  run_ring(0, ec);
+  if (ec)
+    return 0;
+
+  std::size_t n = 0;
+  while (!stopped_ && !ready_queue_.empty())
+    n += do_one();
+  return n;
+}
+
+io_uring_sqe *io_uring_proactor::get_sqe() {
+  unsigned head = io_uring_ops::load_acquire(sq_head_);
+  if (sqe_tail_ - head >= *sq_entries_) {
+    // The ring is full, so hand what we have to the kernel first.
+    abnet::error_code ec;
+    submit(ec);
+    head = io_uring_ops::load_acquire(sq_head_);
+    if (sqe_tail_ - head >= *sq_entries_)
+      return 0;
+  }
+
+  io_uring_sqe *sqe = &sqes_[sqe_tail_ & *sq_mask_];
+  std::memset(sqe, 0, sizeof(*sqe));
+  ++sqe_tail_;
+  return sqe;
+}
+
+void io_uring_proactor::flush_sqes() {
+  unsigned tail = *sq_tail_;
+  if (tail == sqe_tail_)
+    return;
+
+  unsigned mask = *sq_mask_;
+  for (unsigned i = tail; i != sqe_tail_; ++i)
+    sq_array_[i & mask] = i & mask;
+  io_uring_ops::store_release(sq_tail_, sqe_tail_);
+}
+
+void io_uring_proactor::run_ring(int msec, abnet::error_code &ec) {
+  reap_cqes();
+  if (!ready_queue_.empty())
+    msec = 0;
+
+  // Bound the wait with a timeout entry that is submitted with the batch.
+  if (msec > 0) {
+    if (io_uring_sqe *sqe = get_sqe()) {
+      wait_timeout_.tv_sec = msec / 1000;
+      wait_timeout_.tv_nsec = (msec % 1000) * 1000000L;
+      sqe->opcode = IORING_OP_TIMEOUT;
+      sqe->fd = -1;
+      sqe->addr = reinterpret_cast<uint64_t>(&wait_timeout_);
+      sqe->len = 1;
+      sqe->user_data = wait_timeout_user_data;
+      wait_timeout_armed_ = true;
+    }
+  }
+
+  flush_sqes();
+  unsigned to_submit = *sq_tail_ - io_uring_ops::load_acquire(sq_head_);
+  unsigned min_complete = msec == 0 ? 0 : 1;
+  if (to_submit > 0 || min_complete > 0) {
+    // Submit the whole batch and wait for completions in a single syscall.
+    ++enter_calls_;
+    int result = io_uring_ops::enter(ring_fd_, to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0);
+    if (result < 0) {
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY && errno != ETIME) {
+        ec = abnet::error_code(errno, abnet::error::get_system_category());
+        return;
+      }
+    } else {
+      sqes_submitted_ += result;
+    }
+  }
+
+  reap_cqes();
+
+  // A timeout left armed after an earlier wake would fire during a later
+  // wait and end it early, so remove it and wait for its completion.
+  if (wait_timeout_armed_) {
+    if (io_uring_sqe *sqe = get_sqe()) {
+      sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+      sqe->fd = -1;
+      sqe->addr = wait_timeout_user_data;
+      sqe->user_data = internal_user_data;
+    }
+    while (wait_timeout_armed_) {
+      flush_sqes();
+      to_submit = *sq_tail_ - io_uring_ops::load_acquire(sq_head_);
+      ++enter_calls_;
+      int result = io_uring_ops::enter(ring_fd_, to_submit, 1, IORING_ENTER_GETEVENTS);
+      if (result < 0) {
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY && errno != ETIME) {
+          ec = abnet::error_code(errno, abnet::error::get_system_category());
+          return;
+        }
+      } else {
+        sqes_submitted_ += result;
+      }
+      reap_cqes();
+    }
+  }
+}
+
+void io_uring_proactor::reap_cqes() {
+  unsigned head = *cq_head_;
+  unsigned tail = io_uring_ops::load_acquire(cq_tail_);
+  unsigned mask = *cq_mask_;
+  for (; head != tail; ++head) {
+    io_uring_cqe *cqe = &cqes_[head & mask];
+    if (cqe->user_data == internal_user_data)
+      continue;
+    if (cqe->user_data == wait_timeout_user_data) {
+      wait_timeout_armed_ = false;
+      continue;
+    }
+
+    io_uring_op *op = reinterpret_cast<io_uring_op *>(cqe->user_data);
+    if (op->deliver(cqe->res, cqe->flags))
+      ready_queue_.push(op);
+  }
+  io_uring_ops::store_release(cq_head_, head);
+}
+
+std::size_t io_uring_proactor::do_one() {
+  io_uring_op *op = ready_queue_.pop();
+  if (!op)
+    return 0;
+
+  // An armed multishot operation remains outstanding after its handler runs.
+  if (!op->multishot_armed_)
+    --outstanding_work_;
+  op->complete();
+  return 1;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(ABNET_HAS_IO_URING)
+
+#endif // ABNET_IO_URING_PROACTOR_IPP
@@ -0,0 +1,229 @@
+//
+// io_uring_registry.hpp
+// ~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_IO_URING_REGISTRY_HPP
+#define ABNET_IO_URING_REGISTRY_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_IO_URING)
+
+#include "abnet/error.hpp"
+#include "abnet/io_uring_proactor.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/socket_ops.hpp"
+#include "abnet/socket_types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// Registers a table of socket descriptors and a pool of buffers with a ring.
+// Operations on a registered socket name its slot in the table, so the kernel
+// skips the descriptor lookup and reference counting on every request, and
+// reads and writes into a registered buffer skip mapping the user pages.
+//
+// The table holds its own reference to each socket, so closing the descriptor
+// alone would keep the connection open and let the number be reused for
+// another socket. The registry therefore watches socket_ops::close() and frees
+// the slot of a registered socket as it is closed, making it available to the
+// next register_socket().
+class io_uring_registry : private noncopyable, private socket_ops::close_observer {
+public:
+  // The slot returned for a socket that is not registered.
+  enum { no_slot = -1 };
+
+  // The index returned when every buffer is in use. Buffer indexes are 16
+  // bits wide, so this never names a real buffer.
+  enum { no_buffer = 0x10000 };
+
+  // Constructor. Registers a table of file_slots empty slots, and allocates
+  // and registers buffer_count buffers of buffer_size bytes, setting ec on
+  // failure.
+  ABNET_DECL io_uring_registry(io_uring_proactor &proactor, unsigned file_slots, unsigned buffer_count,
+                               std::size_t buffer_size, abnet::error_code &ec);
+
+  // Destructor. Unregisters the table and the buffers and releases the
+  // buffers. All operations using them must have completed beforehand.
+  ABNET_DECL ~io_uring_registry();
+
+  // Whether the table and the buffers were registered successfully.
+  bool is_open() const { return files_registered_ && buffers_registered_; }
+
+  // Put a socket into a free slot, returning the slot. Registering a socket
+  // again returns its existing slot. Sets ec to no_buffer_space when the
+  // table is full.
+  ABNET_DECL int register_socket(socket_type s, abnet::error_code &ec);
+
+  // Free the slot of a socket without closing it. Returns false with ec set
+  // if the socket is not registered or the kernel refused the update.
+  ABNET_DECL bool release_socket(socket_type s, abnet::error_code &ec);
+
+  // The slot of a socket, or no_slot if it is not registered.
+  ABNET_DECL int slot(socket_type s) const;
+
+  // The number of slots in the table.
+  unsigned file_slots() const { return file_slots_; }
+
+  // The number of slots holding a socket.
+  ABNET_DECL std::size_t slots_in_use() const;
+
+  // The number of slots freed for reuse, whether by release_socket() or by
+  // closing the socket.
+  ABNET_DECL std::size_t slots_recycled() const;
+
+  // The number of buffers in the pool.
+  unsigned buffer_count() const { return buffer_count_; }
+
+  // The size of each buffer.
+  std::size_t buffer_size() const { return buffer_size_; }
+
+  // The data of the buffer with the given index.
+  void *buffer(unsigned index) const { return buffers_ + index * buffer_size_; }
+
+  // Take a buffer from the pool, returning its index, or no_buffer if every
+  // buffer is in use. Thread safe.
+  ABNET_DECL unsigned acquire_buffer();
+
+  // Return a buffer to the pool. Returns false, leaving the pool unchanged,
+  // if the index does not name a buffer that is in use, so a buffer released
+  // twice is never handed to two operations. Thread safe.
+  ABNET_DECL bool release_buffer(unsigned index);
+
+  // The number of buffers taken from the pool.
+  ABNET_DECL std::size_t buffers_in_use() const;
+
+  // Read into part of a registered buffer. The socket is named by its slot if
+  // it is registered, and by its descriptor otherwise.
+  // Handler: void(const error_code&, size_t).
+  template <typename Handler>
+  void async_read_fixed(socket_type s, unsigned index, std::size_t offset, std::size_t size, bool is_stream,
+                        Handler handler);
+
+  // Write part of a registered buffer. The socket is named by its slot if it
+  // is registered, and by its descriptor otherwise.
+  // Handler: void(const error_code&, size_t).
+  template <typename Handler>
+  void async_write_fixed(socket_type s, unsigned index, std::size_t offset, std::size_t size, Handler handler);
+
+private:
+  // Called by socket_ops::close().
+  ABNET_DECL void descriptor_closing(socket_type s);
+
+  // Point a slot at a descriptor, or at nothing when fd is -1.
+  ABNET_DECL bool update_slot(unsigned slot, int fd, abnet::error_code &ec);
+
+  // Free the slot of a socket. mutex_ must be held.
+  ABNET_DECL bool free_slot(socket_type s, abnet::error_code &ec);
+
+  io_uring_proactor &proactor_;
+  unsigned file_slots_;
+  unsigned buffer_count_;
+  std::size_t buffer_size_;
+  char *buffers_;
+  std::size_t buffers_size_;
+  bool files_registered_;
+  bool buffers_registered_;
+
+  // Guards the slot table, which close() may update from any thread, and the
+  // buffer pool.
+  mutable std::mutex mutex_;
+  std::unordered_map<socket_type, unsigned> slots_;
+  std::vector<unsigned> free_slots_;
+  std::size_t slots_recycled_;
+
+  std::vector<unsigned> free_buffers_;
+
+  // Whether each buffer is currently taken from the pool.
+  std::vector<bool> buffer_in_use_;
+};
+
+template <typename Handler> class io_uring_fixed_op : public io_uring_op {
+public:
+  io_uring_fixed_op(uint8_t opcode, socket_type s, int slot, void *data, std::size_t size, unsigned index,
+                    bool is_stream, Handler &handler)
+      : opcode_(opcode), s_(s), slot_(slot), data_(data), size_(size), index_(index), is_stream_(is_stream),
+        handler_(std::move(handler)) {}
+
+  void prepare(io_uring_sqe *sqe) {
+    sqe->opcode = opcode_;
+    if (slot_ != io_uring_registry::no_slot) {
+      sqe->fd = slot_;
+      sqe->flags = IOSQE_FIXED_FILE;
+    } else {
+      sqe->fd = s_;
+    }
+    sqe->addr = reinterpret_cast<uint64_t>(data_);
+    sqe->len = static_cast<uint32_t>(size_);
+    sqe->buf_index = static_cast<uint16_t>(index_);
+  }
+
+  void complete() {
+    io_uring_result_to_error(res_, ec_);
+    bytes_transferred_ = ec_ ? 0 : res_;
+
+    // Check for end of stream.
+    if (!ec_ && is_stream_ && res_ == 0 && size_ > 0)
+      ec_ = abnet::error::eof;
+
+    Handler handler(std::move(handler_));
+    abnet::error_code ec(ec_);
+    std::size_t bytes_transferred = bytes_transferred_;
+    delete this;
+    handler(ec, bytes_transferred);
+  }
+
+private:
+  uint8_t opcode_;
+  socket_type s_;
+  int slot_;
+  void *data_;
+  std::size_t size_;
+  unsigned index_;
+  bool is_stream_;
+  Handler handler_;
+};
+
+template <typename Handler>
+void io_uring_registry::async_read_fixed(socket_type s, unsigned index, std::size_t offset, std::size_t size,
+                                         bool is_stream, Handler handler) {
+  char *data = static_cast<char *>(buffer(index)) + offset;
+  proactor_.start_op(
+      new io_uring_fixed_op<Handler>(IORING_OP_READ_FIXED, s, slot(s), data, size, index, is_stream, handler));
+}
+
+template <typename Handler>
+void io_uring_registry::async_write_fixed(socket_type s, unsigned index, std::size_t offset, std::size_t size,
+                                          Handler handler) {
+  char *data = static_cast<char *>(buffer(index)) + offset;
+  proactor_.start_op(
+      new io_uring_fixed_op<Handler>(IORING_OP_WRITE_FIXED, s, slot(s), data, size, index, false, handler));
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/io_uring_registry.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(ABNET_HAS_IO_URING)
+
+#endif // ABNET_IO_URING_REGISTRY_HPP
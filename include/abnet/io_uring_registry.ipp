@@ -0,0 +1,199 @@
+//
+// io_uring_registry.ipp
+// ~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_IO_URING_REGISTRY_IPP
+#define ABNET_IO_URING_REGISTRY_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_IO_URING)
+
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include "abnet/error.hpp"
+#include "abnet/io_uring_registry.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+io_uring_registry::io_uring_registry(io_uring_proactor &proactor, unsigned file_slots, unsigned buffer_count,
+                                     std::size_t buffer_size, abnet::error_code &ec)
+    : proactor_(proactor), file_slots_(file_slots), buffer_count_(buffer_count), buffer_size_(buffer_size),
+      buffers_(0), buffers_size_(0), files_registered_(false), buffers_registered_(false), slots_recycled_(0) {
+  if (file_slots == 0 || buffer_count == 0 || buffer_count > 16384 || buffer_size == 0) {
+    ec = abnet::error::invalid_argument;
+    return;
+  }
+
+  // Start with an empty table. Slots set to -1 hold nothing until updated.
+  std::vector<int> fds(file_slots, -1);
+  if (proactor_.register_resource(IORING_REGISTER_FILES, fds.data(), file_slots, ec) < 0)
+    return;
+  files_registered_ = true;
+
+  buffers_size_ = buffer_count * buffer_size;
+  void *buffers = ::mmap(0, buffers_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffers == MAP_FAILED) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return;
+  }
+  buffers_ = static_cast<char *>(buffers);
+
+  std::vector<iovec> iovs(buffer_count);
+  for (unsigned i = 0; i < buffer_count; ++i) {
+    iovs[i].iov_base = buffer(i);
+    iovs[i].iov_len = buffer_size_;
+  }
+  if (proactor_.register_resource(IORING_REGISTER_BUFFERS, iovs.data(), buffer_count, ec) < 0)
+    return;
+  buffers_registered_ = true;
+
+  // Hand out the lowest slots and buffers first.
+  free_slots_.reserve(file_slots);
+  for (unsigned i = file_slots; i > 0; --i)
+    free_slots_.push_back(i - 1);
+  free_buffers_.reserve(buffer_count);
+  for (unsigned i = buffer_count; i > 0; --i)
+    free_buffers_.push_back(i - 1);
+  buffer_in_use_.assign(buffer_count, false);
+
+  socket_ops::add_close_observer(this);
+}
+
+io_uring_registry::~io_uring_registry() {
+  if (is_open())
+    socket_ops::remove_close_observer(this);
+
+  abnet::error_code ec;
+  if (buffers_registered_)
+    proactor_.register_resource(IORING_UNREGISTER_BUFFERS, 0, 0, ec);
+  if (files_registered_)
+    proactor_.register_resource(IORING_UNREGISTER_FILES, 0, 0, ec);
+  if (buffers_)
+    ::munmap(buffers_, buffers_size_);
+}
+
+int io_uring_registry::register_socket(socket_type s, abnet::error_code &ec) {
+  if (s == invalid_socket) {
+    ec = abnet::error::bad_descriptor;
+    return no_slot;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unordered_map<socket_type, unsigned>::iterator iter = slots_.find(s);
+  if (iter != slots_.end()) {
+    abnet::error::clear(ec);
+    return static_cast<int>(iter->second);
+  }
+
+  if (free_slots_.empty()) {
+    ec = abnet::error::no_buffer_space;
+    return no_slot;
+  }
+
+  unsigned slot = free_slots_.back();
+  if (!update_slot(slot, s, ec))
+    return no_slot;
+  free_slots_.pop_back();
+  slots_[s] = slot;
+  return static_cast<int>(slot);
+}
+
+bool io_uring_registry::release_socket(socket_type s, abnet::error_code &ec) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return free_slot(s, ec);
+}
+
+int io_uring_registry::slot(socket_type s) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unordered_map<socket_type, unsigned>::const_iterator iter = slots_.find(s);
+  return iter != slots_.end() ? static_cast<int>(iter->second) : static_cast<int>(no_slot);
+}
+
+std::size_t io_uring_registry::slots_in_use() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return slots_.size();
+}
+
+std::size_t io_uring_registry::slots_recycled() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return slots_recycled_;
+}
+
+unsigned io_uring_registry::acquire_buffer() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_buffers_.empty())
+    return no_buffer;
+  unsigned index = free_buffers_.back();
+  free_buffers_.pop_back();
+  buffer_in_use_[index] = true;
+  return index;
+}
+
+bool io_uring_registry::release_buffer(unsigned index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (index >= buffer_in_use_.size() || !buffer_in_use_[index])
+    return false;
+  buffer_in_use_[index] = false;
+  free_buffers_.push_back(index);
+  return true;
+}
+
+std::size_t io_uring_registry::buffers_in_use() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return buffer_in_use_.size() - free_buffers_.size();
+}
+
+void io_uring_registry::descriptor_closing(socket_type s) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (slots_.count(s)) {
+    abnet::error_code ignored_ec;
+    free_slot(s, ignored_ec);
+  }
+}
+
+bool io_uring_registry::update_slot(unsigned slot, int fd, abnet::error_code &ec) {
+  io_uring_files_update update;
+  std::memset(&update, 0, sizeof(update));
+  update.offset = slot;
+  update.fds = reinterpret_cast<uint64_t>(&fd);
+  return proactor_.register_resource(IORING_REGISTER_FILES_UPDATE, &update, 1, ec) >= 0;
+}
+
+bool io_uring_registry::free_slot(socket_type s, abnet::error_code &ec) {
+  std::unordered_map<socket_type, unsigned>::iterator iter = slots_.find(s);
+  if (iter == slots_.end()) {
+    ec = abnet::error::bad_descriptor;
+    return false;
+  }
+
+  // The slot is only reused once the kernel has dropped its reference, so a
+  // failed update leaves the socket registered.
+  if (!update_slot(iter->second, -1, ec))
+    return false;
+  free_slots_.push_back(iter->second);
+  slots_.erase(iter);
+  ++slots_recycled_;
+  return true;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(ABNET_HAS_IO_URING)
+
+#endif // ABNET_IO_URING_REGISTRY_IPP
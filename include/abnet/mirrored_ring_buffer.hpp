@@ -0,0 +1,106 @@
+//
+// mirrored_ring_buffer.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_MIRRORED_RING_BUFFER_HPP
+#define ABNET_MIRRORED_RING_BUFFER_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(__linux__)
+
+#include "abnet/error.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/socket_ops.hpp"
+#include "abnet/socket_types.hpp"
+#include <cstddef>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// A byte ring whose pages are mapped twice, back to back, so that the bytes
+// wrapping past the end of the ring also appear right after it. Both the data
+// waiting to be read and the free space are therefore always one contiguous
+// region, which recv() can fill and a parser can read in place, even when a
+// frame straddles the end of the ring.
+//
+// The pages come from a memfd mapped at two adjacent addresses.
+class mirrored_ring_buffer : private noncopyable {
+public:
+  // Constructor. capacity is rounded up to a whole number of pages. Sets ec
+  // on failure.
+  ABNET_DECL mirrored_ring_buffer(std::size_t capacity, abnet::error_code &ec);
+
+  // Destructor. Unmaps the ring.
+  ABNET_DECL ~mirrored_ring_buffer();
+
+  // Whether the ring was mapped successfully.
+  bool is_open() const { return base_ != 0; }
+
+  // The number of bytes the ring holds when full.
+  std::size_t capacity() const { return capacity_; }
+
+  // The number of bytes waiting to be read.
+  std::size_t size() const { return size_; }
+
+  // The number of bytes that can be written.
+  std::size_t space() const { return capacity_ - size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  bool full() const { return size_ == capacity_; }
+
+  // The bytes waiting to be read, size() of them.
+  const char *read_data() const { return base_ + head_; }
+
+  // The free space, space() bytes of it.
+  char *write_data() const { return base_ + head_ + size_; }
+
+  // Drop bytes from the front of the readable region.
+  ABNET_DECL void consume(std::size_t n);
+
+  // Add bytes written into write_data() to the readable region.
+  ABNET_DECL void commit(std::size_t n);
+
+  // The readable region as a buffer for send().
+  ABNET_DECL socket_ops::buf readable() const;
+
+  // The free space as a buffer for recv().
+  ABNET_DECL socket_ops::buf writable() const;
+
+  // Receive into the free space, committing what was received. Sets ec to
+  // no_buffer_space if the ring is full.
+  ABNET_DECL std::size_t recv(socket_type s, socket_ops::state_type state, int flags, abnet::error_code &ec);
+
+  // Send from the readable region, consuming what was sent.
+  ABNET_DECL std::size_t send(socket_type s, socket_ops::state_type state, int flags, abnet::error_code &ec);
+
+private:
+  char *base_;
+  std::size_t capacity_;
+
+  // The offset of the first readable byte, always less than capacity_.
+  std::size_t head_;
+  std::size_t size_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/mirrored_ring_buffer.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(__linux__)
+
+#endif // ABNET_MIRRORED_RING_BUFFER_HPP
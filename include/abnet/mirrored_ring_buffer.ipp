@@ -0,0 +1,130 @@
+//
+// mirrored_ring_buffer.ipp
+// ~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_MIRRORED_RING_BUFFER_IPP
+#define ABNET_MIRRORED_RING_BUFFER_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "abnet/error.hpp"
+#include "abnet/mirrored_ring_buffer.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+mirrored_ring_buffer::mirrored_ring_buffer(std::size_t capacity, abnet::error_code &ec)
+    : base_(0), capacity_(0), head_(0), size_(0) {
+  if (capacity == 0) {
+    ec = abnet::error::invalid_argument;
+    return;
+  }
+  std::size_t page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  std::size_t size = (capacity + page_size - 1) / page_size * page_size;
+
+  int fd = ::memfd_create("abnet_ring", MFD_CLOEXEC);
+  if (fd < 0) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return;
+  }
+
+  // Reserve twice the size, then map the memfd over each half. The mappings
+  // keep the memfd alive after the descriptor is closed.
+  char *base = 0;
+  void *reserved = MAP_FAILED;
+  if (::ftruncate(fd, size) == 0)
+    reserved = ::mmap(0, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (reserved != MAP_FAILED) {
+    base = static_cast<char *>(reserved);
+    if (::mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        ::mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      int error = errno;
+      ::munmap(base, 2 * size);
+      errno = error;
+      base = 0;
+    }
+  }
+  if (!base) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    ::close(fd);
+    return;
+  }
+  ::close(fd);
+
+  base_ = base;
+  capacity_ = size;
+  abnet::error::clear(ec);
+}
+
+mirrored_ring_buffer::~mirrored_ring_buffer() {
+  if (base_)
+    ::munmap(base_, 2 * capacity_);
+}
+
+void mirrored_ring_buffer::consume(std::size_t n) {
+  if (n > size_)
+    n = size_;
+  size_ -= n;
+  head_ += n;
+  if (head_ >= capacity_)
+    head_ -= capacity_;
+
+  // Restart at the front when empty, keeping the region in the first copy.
+  if (size_ == 0)
+    head_ = 0;
+}
+
+void mirrored_ring_buffer::commit(std::size_t n) { size_ += n < space() ? n : space(); }
+
+socket_ops::buf mirrored_ring_buffer::readable() const {
+  socket_ops::buf b;
+  socket_ops::init_buf(b, read_data(), size_);
+  return b;
+}
+
+socket_ops::buf mirrored_ring_buffer::writable() const {
+  socket_ops::buf b;
+  socket_ops::init_buf(b, write_data(), space());
+  return b;
+}
+
+std::size_t mirrored_ring_buffer::recv(socket_type s, socket_ops::state_type state, int flags,
+                                       abnet::error_code &ec) {
+  if (full()) {
+    ec = abnet::error::no_buffer_space;
+    return 0;
+  }
+  std::size_t bytes = socket_ops::sync_recv1(s, state, write_data(), space(), flags, ec);
+  commit(bytes);
+  return bytes;
+}
+
+std::size_t mirrored_ring_buffer::send(socket_type s, socket_ops::state_type state, int flags,
+                                       abnet::error_code &ec) {
+  std::size_t bytes = socket_ops::sync_send1(s, state, read_data(), size_, flags, ec);
+  consume(bytes);
+  return bytes;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(__linux__)
+
+#endif // ABNET_MIRRORED_RING_BUFFER_IPP
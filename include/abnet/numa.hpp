@@ -0,0 +1,159 @@
+//
+// numa.hpp
+// ~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_NUMA_HPP
+#define ABNET_NUMA_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(__linux__)
+
+#include "abnet/error.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/socket_ops.hpp"
+#include "abnet/socket_types.hpp"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// The NUMA nodes of the host and the CPUs that belong to each, read from
+// /sys/devices/system/node. A host without that directory is treated as a
+// single node 0 holding every CPU.
+class numa_topology {
+public:
+  // Constructor. Reads the layout of the host.
+  ABNET_DECL numa_topology();
+
+  // Constructor. Uses the given layout, where cpu_nodes[cpu] is the node of
+  // each CPU.
+  ABNET_DECL explicit numa_topology(const std::vector<int> &cpu_nodes);
+
+  // The ids of the nodes, in ascending order. Ids need not be contiguous.
+  const std::vector<int> &nodes() const { return nodes_; }
+
+  // The number of nodes.
+  std::size_t node_count() const { return nodes_.size(); }
+
+  // The node of a CPU, or -1 if unknown.
+  int node_of_cpu(int cpu) const {
+    return cpu >= 0 && std::size_t(cpu) < cpu_nodes_.size() ? cpu_nodes_[cpu] : -1;
+  }
+
+  // The CPU the calling thread is running on, or -1 if unknown.
+  ABNET_DECL static int current_cpu();
+
+private:
+  std::vector<int> nodes_;
+  std::vector<int> cpu_nodes_;
+};
+
+namespace numa_ops {
+
+// Parse a sysfs CPU list such as "0-3,8,10-11" into the CPUs it names.
+ABNET_DECL bool parse_cpu_list(const std::string &list, std::vector<int> &cpus);
+
+// Bind the pages of a mapping to a node with mbind(MPOL_BIND). Pages already
+// touched are left where they are, so bind a mapping before first use.
+ABNET_DECL bool bind_memory(void *addr, std::size_t size, int node, abnet::error_code &ec);
+
+} // namespace numa_ops
+
+#if defined(SO_INCOMING_CPU)
+
+// Picks the worker to serve an accepted socket: one on the node whose CPU
+// received the connection, as reported by SO_INCOMING_CPU, so that the
+// payload is handled on the node the NIC queue delivered it to. Workers on a
+// node take turns. A connection whose CPU is unknown, or which arrived on a
+// node without workers, goes to the next worker in turn across all nodes.
+//
+// route() may be called from several threads at once, such as the shards of
+// a sharded_acceptor.
+class numa_router : private noncopyable {
+public:
+  // Constructor. worker_nodes[i] is the node worker i runs on.
+  ABNET_DECL numa_router(const numa_topology &topology, const std::vector<int> &worker_nodes);
+
+  // The number of workers.
+  std::size_t worker_count() const { return worker_count_; }
+
+  // Pick the worker for an accepted socket.
+  ABNET_DECL std::size_t route(socket_type s);
+
+  // Pick the worker for a connection received on a CPU, or on an unknown CPU
+  // if cpu is -1.
+  ABNET_DECL std::size_t route_cpu(int cpu);
+
+  // The number of connections received on a node and served there.
+  std::size_t local(int node) const { return state(node) ? state(node)->local_.load(std::memory_order_relaxed) : 0; }
+
+  // The number of connections received on a node that had no workers, and
+  // so were served on another node.
+  std::size_t remote(int node) const {
+    return state(node) ? state(node)->remote_.load(std::memory_order_relaxed) : 0;
+  }
+
+  // The number of connections handed to the workers of a node.
+  std::size_t served(int node) const {
+    return state(node) ? state(node)->served_.load(std::memory_order_relaxed) : 0;
+  }
+
+  // The number of connections whose CPU was unknown.
+  std::size_t unknown() const { return unknown_.load(std::memory_order_relaxed); }
+
+private:
+  struct node_state {
+    node_state() : next_(0), local_(0), remote_(0), served_(0) {}
+
+    std::vector<std::size_t> workers_;
+    std::atomic<std::size_t> next_;
+    std::atomic<std::size_t> local_;
+    std::atomic<std::size_t> remote_;
+    std::atomic<std::size_t> served_;
+  };
+
+  node_state *state(int node) const {
+    return node >= 0 && std::size_t(node) < nodes_.size() ? nodes_[node].get() : 0;
+  }
+
+  // Take the next worker in turn across all nodes.
+  ABNET_DECL std::size_t next_any();
+
+  numa_topology topology_;
+  std::size_t worker_count_;
+  std::vector<int> worker_nodes_;
+
+  // Indexed by node id.
+  std::vector<std::unique_ptr<node_state>> nodes_;
+
+  std::atomic<std::size_t> next_;
+  std::atomic<std::size_t> unknown_;
+};
+
+#endif // defined(SO_INCOMING_CPU)
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/numa.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(__linux__)
+
+#endif // ABNET_NUMA_HPP
@@ -0,0 +1,195 @@
+//
+// numa.ipp
+// ~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_NUMA_IPP
+#define ABNET_NUMA_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "abnet/error.hpp"
+#include "abnet/numa.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+namespace numa_ops {
+
+bool parse_cpu_list(const std::string &list, std::vector<int> &cpus) {
+  const char *p = list.c_str();
+  while (*p && *p != '\n') {
+    char *end = 0;
+    long first = std::strtol(p, &end, 10);
+    if (end == p || first < 0)
+      return false;
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      last = std::strtol(p + 1, &end, 10);
+      if (end == p + 1 || last < first)
+        return false;
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; ++cpu)
+      cpus.push_back(static_cast<int>(cpu));
+    if (*p == ',')
+      ++p;
+    else if (*p && *p != '\n')
+      return false;
+  }
+  return true;
+}
+
+bool bind_memory(void *addr, std::size_t size, int node, abnet::error_code &ec) {
+  if (node < 0) {
+    ec = abnet::error::invalid_argument;
+    return false;
+  }
+
+  const std::size_t bits = 8 * sizeof(unsigned long);
+  std::vector<unsigned long> mask(node / bits + 1, 0);
+  mask[node / bits] = 1UL << (node % bits);
+
+  // The kernel reads one bit fewer than maxnode.
+  if (::syscall(SYS_mbind, addr, size, MPOL_BIND, mask.data(), mask.size() * bits + 1, 0) != 0) {
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+    return false;
+  }
+  abnet::error::clear(ec);
+  return true;
+}
+
+inline bool read_file(const std::string &path, std::string &contents) {
+  std::FILE *f = std::fopen(path.c_str(), "r");
+  if (!f)
+    return false;
+  char buf[4096];
+  std::size_t n = std::fread(buf, 1, sizeof(buf), f);
+  std::fclose(f);
+  contents.assign(buf, n);
+  return true;
+}
+
+} // namespace numa_ops
+
+numa_topology::numa_topology() {
+  const std::string root = "/sys/devices/system/node";
+  std::string online;
+  std::vector<int> nodes;
+  if (numa_ops::read_file(root + "/online", online))
+    numa_ops::parse_cpu_list(online, nodes);
+
+  for (std::size_t i = 0; i < nodes.size(); ++i) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "/node%d/cpulist", nodes[i]);
+    std::string list;
+    std::vector<int> cpus;
+    if (!numa_ops::read_file(root + name, list) || !numa_ops::parse_cpu_list(list, cpus))
+      continue;
+    nodes_.push_back(nodes[i]);
+    for (std::size_t j = 0; j < cpus.size(); ++j) {
+      if (std::size_t(cpus[j]) >= cpu_nodes_.size())
+        cpu_nodes_.resize(cpus[j] + 1, -1);
+      cpu_nodes_[cpus[j]] = nodes[i];
+    }
+  }
+
+  if (nodes_.empty()) {
+    long cpus = ::sysconf(_SC_NPROCESSORS_CONF);
+    nodes_.push_back(0);
+    cpu_nodes_.assign(cpus > 0 ? cpus : 1, 0);
+  }
+}
+
+numa_topology::numa_topology(const std::vector<int> &cpu_nodes) : cpu_nodes_(cpu_nodes) {
+  for (std::size_t i = 0; i < cpu_nodes.size(); ++i) {
+    int node = cpu_nodes[i];
+    if (node < 0)
+      continue;
+    std::vector<int>::iterator pos = nodes_.begin();
+    while (pos != nodes_.end() && *pos < node)
+      ++pos;
+    if (pos == nodes_.end() || *pos != node)
+      nodes_.insert(pos, node);
+  }
+}
+
+int numa_topology::current_cpu() { return ::sched_getcpu(); }
+
+#if defined(SO_INCOMING_CPU)
+
+numa_router::numa_router(const numa_topology &topology, const std::vector<int> &worker_nodes)
+    : topology_(topology), worker_count_(worker_nodes.size()), worker_nodes_(worker_nodes), next_(0), unknown_(0) {
+  int max_node = topology.nodes().empty() ? 0 : topology.nodes().back();
+  for (std::size_t i = 0; i < worker_nodes.size(); ++i)
+    if (worker_nodes[i] > max_node)
+      max_node = worker_nodes[i];
+
+  nodes_.resize(max_node + 1);
+  for (int node = 0; node <= max_node; ++node)
+    nodes_[node].reset(new node_state);
+  for (std::size_t i = 0; i < worker_nodes.size(); ++i)
+    if (worker_nodes[i] >= 0)
+      nodes_[worker_nodes[i]]->workers_.push_back(i);
+}
+
+std::size_t numa_router::route(socket_type s) {
+  abnet::error_code ec;
+  return route_cpu(socket_ops::incoming_cpu(s, ec));
+}
+
+std::size_t numa_router::route_cpu(int cpu) {
+  if (worker_count_ == 0)
+    return 0;
+
+  node_state *home = state(topology_.node_of_cpu(cpu));
+  if (!home) {
+    unknown_.fetch_add(1, std::memory_order_relaxed);
+    return next_any();
+  }
+  if (home->workers_.empty()) {
+    home->remote_.fetch_add(1, std::memory_order_relaxed);
+    return next_any();
+  }
+
+  home->local_.fetch_add(1, std::memory_order_relaxed);
+  home->served_.fetch_add(1, std::memory_order_relaxed);
+  std::size_t turn = home->next_.fetch_add(1, std::memory_order_relaxed);
+  return home->workers_[turn % home->workers_.size()];
+}
+
+std::size_t numa_router::next_any() {
+  std::size_t worker = next_.fetch_add(1, std::memory_order_relaxed) % worker_count_;
+  if (node_state *served = state(worker_nodes_[worker]))
+    served->served_.fetch_add(1, std::memory_order_relaxed);
+  return worker;
+}
+
+#endif // defined(SO_INCOMING_CPU)
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(__linux__)
+
+#endif // ABNET_NUMA_IPP
@@ -0,0 +1,73 @@
+//
+// op_queue.hpp
+// ~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_OP_QUEUE_HPP
+#define ABNET_OP_QUEUE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+#include "abnet/noncopyable.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// Intrusive FIFO of operations linked through their next_ member.
+template <typename Operation> class op_queue : private noncopyable {
+public:
+  op_queue() : front_(0), back_(0) {}
+
+  Operation *front() const { return front_; }
+
+  bool empty() const { return front_ == 0; }
+
+  void push(Operation *op) {
+    op->next_ = 0;
+    if (back_) {
+      back_->next_ = op;
+      back_ = op;
+    } else {
+      front_ = back_ = op;
+    }
+  }
+
+  void push(op_queue &q) {
+    if (Operation *other_front = q.front_) {
+      if (back_)
+        back_->next_ = other_front;
+      else
+        front_ = other_front;
+      back_ = q.back_;
+      q.front_ = q.back_ = 0;
+    }
+  }
+
+  Operation *pop() {
+    Operation *op = front_;
+    if (op) {
+      front_ = op->next_;
+      if (front_ == 0)
+        back_ = 0;
+      op->next_ = 0;
+    }
+    return op;
+  }
+
+private:
+  Operation *front_;
+  Operation *back_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // ABNET_OP_QUEUE_HPP
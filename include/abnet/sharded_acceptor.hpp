@@ -0,0 +1,120 @@
+//
+// sharded_acceptor.hpp
+// ~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_SHARDED_ACCEPTOR_HPP
+#define ABNET_SHARDED_ACCEPTOR_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#include "abnet/socket_types.hpp"
+
+#if defined(SO_REUSEPORT) && defined(ABNET_HAS_EVENTFD) && defined(ABNET_HAS_STD_THREAD)
+
+#include "abnet/error.hpp"
+#include "abnet/eventfd_interrupter.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/socket_ops.hpp"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// A set of listening sockets bound to the same endpoint with SO_REUSEPORT,
+// each served by its own thread. The kernel spreads incoming connections
+// across the listeners, so no accept queue is shared between threads.
+class sharded_acceptor : private noncopyable {
+public:
+  // Called on the shard's thread for every accepted socket, which the handler
+  // then owns.
+  typedef std::function<void(std::size_t shard, socket_type new_socket)> handler_type;
+
+  // Constructor. Opens shard_count listeners bound to addr, setting ec on
+  // failure. When addr has port zero, all listeners share the port chosen for
+  // the first one.
+  ABNET_DECL sharded_acceptor(const void *addr, std::size_t addrlen, std::size_t shard_count, int backlog,
+                              abnet::error_code &ec);
+
+  // Destructor. Stops the accept loops and closes the listeners.
+  ABNET_DECL ~sharded_acceptor();
+
+  // The number of listeners.
+  std::size_t size() const { return shards_.size(); }
+
+  // The listening socket of a shard.
+  socket_type listener(std::size_t shard) const { return shards_[shard]->socket_; }
+
+  // The endpoint the listeners are bound to.
+  ABNET_DECL int local_endpoint(void *addr, std::size_t *addrlen, abnet::error_code &ec) const;
+
+  // Start one accept loop thread per shard.
+  ABNET_DECL void start(handler_type handler);
+
+  // Stop the accept loops and wait for their threads to exit.
+  ABNET_DECL void stop();
+
+  // The number of connections accepted by a shard.
+  std::size_t accepted(std::size_t shard) const { return shards_[shard]->accepted_.load(std::memory_order_relaxed); }
+
+  // The number of accept calls on a shard that failed, for example because
+  // descriptors ran out. The shard backs off for backoff_msec after each.
+  std::size_t accept_errors(std::size_t shard) const {
+    return shards_[shard]->errors_.load(std::memory_order_relaxed);
+  }
+
+  // How long a shard stops polling its listener after a failed accept.
+  enum { backoff_msec = 10 };
+
+private:
+  struct shard {
+    shard() : socket_(invalid_socket), state_(0), accepted_(0), errors_(0) {}
+
+    socket_type socket_;
+    socket_ops::state_type state_;
+    std::atomic<std::size_t> accepted_;
+    std::atomic<std::size_t> errors_;
+    std::thread thread_;
+  };
+
+  // The accept loop of a shard.
+  ABNET_DECL void run_shard(std::size_t index);
+
+  // The maximum number of connections accepted per wakeup.
+  enum { max_batch = 64 };
+
+  std::vector<std::unique_ptr<shard>> shards_;
+
+  // Wakes every accept loop on stop().
+  eventfd_interrupter interrupter_;
+
+  // Set once stop() has been called.
+  std::atomic<bool> stopped_;
+
+  handler_type handler_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/sharded_acceptor.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(SO_REUSEPORT) && defined(ABNET_HAS_EVENTFD) && defined(ABNET_HAS_STD_THREAD)
+
+#endif // ABNET_SHARDED_ACCEPTOR_HPP
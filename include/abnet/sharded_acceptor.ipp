@@ -0,0 +1,149 @@
+//
+// sharded_acceptor.ipp
+// ~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_SHARDED_ACCEPTOR_IPP
+#define ABNET_SHARDED_ACCEPTOR_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#include "abnet/socket_types.hpp"
+
+#if defined(SO_REUSEPORT) && defined(ABNET_HAS_EVENTFD) && defined(ABNET_HAS_STD_THREAD)
+
+#include <cerrno>
+#include <poll.h>
+
+#include "abnet/error.hpp"
+#include "abnet/sharded_acceptor.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+sharded_acceptor::sharded_acceptor(const void *addr, std::size_t addrlen, std::size_t shard_count, int backlog,
+                                   abnet::error_code &ec)
+    : interrupter_(ec), stopped_(false) {
+  if (ec)
+    return;
+
+  // Once the first listener is bound, the rest bind to its actual address so
+  // that an ephemeral port is shared.
+  sockaddr_storage_type bound;
+  std::size_t bound_len = addrlen;
+  const socket_addr_type *family_addr = static_cast<const socket_addr_type *>(addr);
+  for (std::size_t i = 0; i < shard_count; ++i) {
+    shards_.emplace_back(new shard);
+    shard &s = *shards_.back();
+    s.socket_ = socket_ops::socket(family_addr->sa_family, SOCK_STREAM, IPPROTO_TCP, ec);
+    if (s.socket_ == invalid_socket)
+      return;
+
+    int one = 1;
+    if (socket_ops::setsockopt(s.socket_, s.state_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one), ec) != 0)
+      return;
+    if (socket_ops::setsockopt(s.socket_, s.state_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one), ec) != 0)
+      return;
+    if (socket_ops::bind(s.socket_, i == 0 ? addr : &bound, i == 0 ? addrlen : bound_len, ec) != 0)
+      return;
+    if (i == 0) {
+      bound_len = sizeof(bound);
+      if (socket_ops::getsockname(s.socket_, &bound, &bound_len, ec) != 0)
+        return;
+    }
+    if (socket_ops::listen(s.socket_, backlog, ec) != 0)
+      return;
+    if (!socket_ops::set_internal_non_blocking(s.socket_, s.state_, true, ec))
+      return;
+  }
+  abnet::error::clear(ec);
+}
+
+sharded_acceptor::~sharded_acceptor() {
+  stop();
+  for (std::unique_ptr<shard> &s : shards_) {
+    if (s->socket_ != invalid_socket) {
+      abnet::error_code ec;
+      socket_ops::close(s->socket_, s->state_, true, ec);
+    }
+  }
+}
+
+int sharded_acceptor::local_endpoint(void *addr, std::size_t *addrlen, abnet::error_code &ec) const {
+  if (shards_.empty()) {
+    ec = abnet::error::bad_descriptor;
+    return socket_error_retval;
+  }
+  return socket_ops::getsockname(shards_[0]->socket_, addr, addrlen, ec);
+}
+
+void sharded_acceptor::start(handler_type handler) {
+  handler_ = handler;
+  for (std::size_t i = 0; i < shards_.size(); ++i)
+    shards_[i]->thread_ = std::thread([this, i] { run_shard(i); });
+}
+
+void sharded_acceptor::stop() {
+  // The eventfd is never reset, so it stays readable for every loop.
+  if (!stopped_.exchange(true))
+    interrupter_.interrupt();
+  for (std::unique_ptr<shard> &s : shards_)
+    if (s->thread_.joinable())
+      s->thread_.join();
+}
+
+void sharded_acceptor::run_shard(std::size_t index) {
+  shard &s = *shards_[index];
+  socket_type new_sockets[max_batch];
+  pollfd fds[2];
+  fds[0].fd = s.socket_;
+  fds[0].events = POLLIN;
+  fds[1].fd = interrupter_.read_descriptor();
+  fds[1].events = POLLIN;
+
+  bool backing_off = false;
+  while (!stopped_.load(std::memory_order_relaxed)) {
+    // While backing off the listener is left out, so only stop() wakes the
+    // poll before the timeout.
+    fds[0].fd = backing_off ? -1 : s.socket_;
+    fds[0].revents = 0;
+    fds[1].revents = 0;
+    if (::poll(fds, 2, backing_off ? static_cast<int>(backoff_msec) : -1) < 0 && errno != EINTR)
+      return;
+    backing_off = false;
+    if (fds[1].revents)
+      return;
+    if (!fds[0].revents)
+      continue;
+
+    abnet::error_code ec;
+    std::size_t count = 0;
+    socket_ops::non_blocking_accept_batch(s.socket_, s.state_, new_sockets, max_batch, ec, count);
+    s.accepted_.fetch_add(count, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < count; ++i)
+      handler_(index, new_sockets[i]);
+
+    // A pending connection that cannot be accepted, as on EMFILE or ENFILE,
+    // leaves the listener readable, so retrying at once would spin.
+    if (ec && ec != abnet::error::would_block && ec != abnet::error::try_again) {
+      s.errors_.fetch_add(1, std::memory_order_relaxed);
+      backing_off = true;
+    }
+  }
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(SO_REUSEPORT) && defined(ABNET_HAS_EVENTFD) && defined(ABNET_HAS_STD_THREAD)
+
+#endif // ABNET_SHARDED_ACCEPTOR_IPP
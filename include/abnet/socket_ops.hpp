@@ -19,8 +19,13 @@
 
 #include "abnet/error_code.hpp"
 #include "abnet/socket_types.hpp"
+#include <chrono>
 #include <memory>
 
+#if defined(__linux__)
+#include <signal.h>
+#endif // defined(__linux__)
+
 #include "abnet/push_options.hpp"
 
 namespace abnet {
@@ -61,6 +66,9 @@ struct noop_deleter {
 typedef std::shared_ptr<void> shared_cancel_token_type;
 typedef std::weak_ptr<void> weak_cancel_token_type;
 
+// Absolute deadline for the sync_* operations which accept one.
+typedef std::chrono::steady_clock::time_point deadline_type;
+
 #if !defined(ABNET_WINDOWS_RUNTIME)
 
 ABNET_DECL socket_type accept(socket_type s, void *addr, std::size_t *addrlen, abnet::error_code &ec);
@@ -68,6 +76,9 @@ ABNET_DECL socket_type accept(socket_type s, void *addr, std::size_t *addrlen, a
 ABNET_DECL socket_type sync_accept(socket_type s, state_type state, void *addr, std::size_t *addrlen,
                                    abnet::error_code &ec);
 
+ABNET_DECL socket_type sync_accept(socket_type s, state_type state, void *addr, std::size_t *addrlen,
+                                   const deadline_type &deadline, abnet::error_code &ec);
+
 #if defined(ABNET_HAS_IOCP)
 
 ABNET_DECL void complete_iocp_accept(socket_type s, void *output_buffer, DWORD address_length, void *addr,
@@ -78,6 +89,12 @@ ABNET_DECL void complete_iocp_accept(socket_type s, void *output_buffer, DWORD a
 ABNET_DECL bool non_blocking_accept(socket_type s, state_type state, void *addr, std::size_t *addrlen,
                                     abnet::error_code &ec, socket_type &new_socket);
 
+ABNET_DECL bool non_blocking_accept_batch(socket_type s, state_type state, socket_type *new_sockets,
+                                          size_t max_sockets, abnet::error_code &ec, size_t &sockets_accepted);
+
+ABNET_DECL size_t sync_accept_batch(socket_type s, state_type state, socket_type *new_sockets, size_t max_sockets,
+                                    abnet::error_code &ec);
+
 #endif // defined(ABNET_HAS_IOCP)
 
 ABNET_DECL int bind(socket_type s, const void *addr, std::size_t addrlen, abnet::error_code &ec);
@@ -86,6 +103,21 @@ template <typename T>
 typename std::enable_if<std::is_convertible<typename std::decay<T>::type, state_type>::value, int>::type ABNET_DECL
 close(socket_type s, T &&state, bool destruction, abnet::error_code &ec);
 
+// Told by close() about a descriptor just before it is closed, so that a
+// table keyed by descriptor can drop it before the number is reused. Called
+// on the thread that closes the socket.
+class close_observer {
+public:
+  virtual void descriptor_closing(socket_type s) = 0;
+
+protected:
+  ~close_observer() {}
+};
+
+ABNET_DECL void add_close_observer(close_observer *observer);
+
+ABNET_DECL void remove_close_observer(close_observer *observer);
+
 ABNET_DECL bool set_user_non_blocking(socket_type s, state_type &state, bool value, abnet::error_code &ec);
 
 ABNET_DECL bool set_internal_non_blocking(socket_type s, state_type &state, bool value, abnet::error_code &ec);
@@ -96,6 +128,9 @@ ABNET_DECL int connect(socket_type s, const void *addr, std::size_t addrlen, abn
 
 ABNET_DECL void sync_connect(socket_type s, const void *addr, std::size_t addrlen, abnet::error_code &ec);
 
+ABNET_DECL void sync_connect(socket_type s, const void *addr, std::size_t addrlen, const deadline_type &deadline,
+                             abnet::error_code &ec);
+
 #if defined(ABNET_HAS_IOCP)
 
 ABNET_DECL void complete_iocp_connect(socket_type s, abnet::error_code &ec);
@@ -122,6 +157,35 @@ ABNET_DECL void init_buf(buf &b, void *data, size_t size);
 
 ABNET_DECL void init_buf(buf &b, const void *data, size_t size);
 
+// A cursor over an array of buffers being sent. Consuming bytes advances past
+// whole buffers and adjusts a partly sent one in place, so the array is
+// modified but nothing is copied. At most max_iov_len buffers are presented
+// to a single send.
+class buffer_sequence {
+public:
+  buffer_sequence(buf *bufs, size_t count) : bufs_(bufs), first_(0), end_(count) { consume(0); }
+
+  // The first of the buffers still to be sent.
+  buf *data() const { return bufs_ + first_; }
+
+  // The number of buffers to pass to the next send.
+  size_t count() const { return end_ - first_ < size_t(max_iov_len) ? end_ - first_ : size_t(max_iov_len); }
+
+  // Whether everything has been sent.
+  bool empty() const { return first_ == end_; }
+
+  // The number of bytes still to be sent.
+  ABNET_DECL size_t size() const;
+
+  // Advance past bytes that have been sent.
+  ABNET_DECL void consume(size_t bytes);
+
+private:
+  buf *bufs_;
+  size_t first_;
+  size_t end_;
+};
+
 ABNET_DECL signed_size_type recv(socket_type s, buf *bufs, size_t count, int flags, abnet::error_code &ec);
 
 ABNET_DECL signed_size_type recv1(socket_type s, void *data, size_t size, int flags, abnet::error_code &ec);
@@ -129,6 +193,9 @@ ABNET_DECL signed_size_type recv1(socket_type s, void *data, size_t size, int fl
 ABNET_DECL size_t sync_recv(socket_type s, state_type state, buf *bufs, size_t count, int flags, bool all_empty,
                             abnet::error_code &ec);
 
+ABNET_DECL size_t sync_recv(socket_type s, state_type state, buf *bufs, size_t count, int flags, bool all_empty,
+                            const deadline_type &deadline, abnet::error_code &ec);
+
 ABNET_DECL size_t sync_recv1(socket_type s, state_type state, void *data, size_t size, int flags,
                              abnet::error_code &ec);
 
@@ -197,9 +264,17 @@ ABNET_DECL signed_size_type send1(socket_type s, const void *data, size_t size,
 ABNET_DECL size_t sync_send(socket_type s, state_type state, const buf *bufs, size_t count, int flags, bool all_empty,
                             abnet::error_code &ec);
 
+ABNET_DECL size_t sync_send(socket_type s, state_type state, const buf *bufs, size_t count, int flags, bool all_empty,
+                            const deadline_type &deadline, abnet::error_code &ec);
+
 ABNET_DECL size_t sync_send1(socket_type s, state_type state, const void *data, size_t size, int flags,
                              abnet::error_code &ec);
 
+// Unlike the other overloads, keeps sending until the whole sequence has been
+// sent or an error occurs. The sequence is left past the bytes sent.
+ABNET_DECL size_t sync_send(socket_type s, state_type state, buffer_sequence &bufs, int flags,
+                            abnet::error_code &ec);
+
 #if defined(ABNET_HAS_IOCP)
 
 ABNET_DECL void complete_iocp_send(const weak_cancel_token_type &cancel_token, abnet::error_code &ec);
@@ -212,8 +287,53 @@ ABNET_DECL bool non_blocking_send(socket_type s, const buf *bufs, size_t count,
 ABNET_DECL bool non_blocking_send1(socket_type s, const void *data, size_t size, int flags, abnet::error_code &ec,
                                    size_t &bytes_transferred);
 
+// Returns true once the whole sequence has been sent or an error occurs, and
+// false when the socket would block with part of it still to be sent.
+ABNET_DECL bool non_blocking_send(socket_type s, buffer_sequence &bufs, int flags, abnet::error_code &ec,
+                                  size_t &bytes_transferred);
+
 #endif // defined(ABNET_HAS_IOCP)
 
+#if !defined(ABNET_WINDOWS) && !defined(__CYGWIN__)
+
+#if defined(__linux__)
+
+// Blocks SIGPIPE on the calling thread for the guard's lifetime, for writes to
+// a socket that cannot pass MSG_NOSIGNAL, such as sendfile(2) and splice(2).
+// A SIGPIPE raised while the guard is held is consumed before the previous
+// mask is restored, so a write to a reset peer only fails with EPIPE.
+class sigpipe_guard {
+public:
+  ABNET_DECL sigpipe_guard();
+  ABNET_DECL ~sigpipe_guard();
+
+private:
+  sigpipe_guard(const sigpipe_guard &);
+  sigpipe_guard &operator=(const sigpipe_guard &);
+
+  sigset_t old_mask_;
+
+  // Set when SIGPIPE was already pending on entry, so it is left for its
+  // original sender rather than consumed.
+  bool was_pending_;
+};
+
+#endif // defined(__linux__)
+
+// Send up to count bytes of the file fd, starting at offset, without copying
+// them through user space. offset is advanced past the bytes sent, so a
+// partial transfer is resumed by calling again with the same offset. A peer
+// reset fails with broken_pipe rather than raising SIGPIPE.
+ABNET_DECL signed_size_type send_file(socket_type s, int fd, off_t &offset, size_t count, abnet::error_code &ec);
+
+ABNET_DECL size_t sync_send_file(socket_type s, state_type state, int fd, off_t &offset, size_t count,
+                                 abnet::error_code &ec);
+
+ABNET_DECL bool non_blocking_send_file(socket_type s, int fd, off_t &offset, size_t count, abnet::error_code &ec,
+                                       size_t &bytes_transferred);
+
+#endif // !defined(ABNET_WINDOWS) && !defined(__CYGWIN__)
+
 ABNET_DECL signed_size_type sendto(socket_type s, const buf *bufs, size_t count, int flags, const void *addr,
                                    std::size_t addrlen, abnet::error_code &ec);
 
@@ -236,6 +356,80 @@ ABNET_DECL bool non_blocking_sendto1(socket_type s, const void *data, size_t siz
 
 #endif // !defined(ABNET_HAS_IOCP)
 
+// A message in a datagram batch. On receive, addrlen and flags are updated
+// with the sender's address length and the message flags (e.g. MSG_TRUNC).
+struct datagram {
+  buf *bufs;
+  size_t count;
+  void *addr;
+  std::size_t addrlen;
+  size_t bytes_transferred;
+  int flags;
+};
+
+// The maximum number of datagrams transferred by one batch call.
+enum { max_datagram_batch = 64 };
+
+ABNET_DECL signed_size_type recvfrom_batch(socket_type s, datagram *msgs, size_t count, int flags,
+                                           abnet::error_code &ec);
+
+ABNET_DECL size_t sync_recvfrom_batch(socket_type s, state_type state, datagram *msgs, size_t count, int flags,
+                                      abnet::error_code &ec);
+
+ABNET_DECL signed_size_type sendto_batch(socket_type s, datagram *msgs, size_t count, int flags,
+                                         abnet::error_code &ec);
+
+ABNET_DECL size_t sync_sendto_batch(socket_type s, state_type state, datagram *msgs, size_t count, int flags,
+                                    abnet::error_code &ec);
+
+#if !defined(ABNET_HAS_IOCP)
+
+ABNET_DECL bool non_blocking_recvfrom_batch(socket_type s, datagram *msgs, size_t count, int flags,
+                                            abnet::error_code &ec, size_t &messages_transferred);
+
+ABNET_DECL bool non_blocking_sendto_batch(socket_type s, datagram *msgs, size_t count, int flags,
+                                          abnet::error_code &ec, size_t &messages_transferred);
+
+#endif // !defined(ABNET_HAS_IOCP)
+
+#if defined(UDP_SEGMENT)
+
+// Send the buffers as a run of datagrams of segment_size bytes each, split by
+// the kernel (UDP GSO). Only the last datagram may be shorter. The kernel
+// limits a call to 64 segments and a 64KB payload.
+ABNET_DECL signed_size_type sendto_segmented(socket_type s, const buf *bufs, size_t count, int flags, const void *addr,
+                                             std::size_t addrlen, std::size_t segment_size, abnet::error_code &ec);
+
+ABNET_DECL size_t sync_sendto_segmented(socket_type s, state_type state, const buf *bufs, size_t count, int flags,
+                                        const void *addr, std::size_t addrlen, std::size_t segment_size,
+                                        abnet::error_code &ec);
+
+ABNET_DECL bool non_blocking_sendto_segmented(socket_type s, const buf *bufs, size_t count, int flags,
+                                              const void *addr, std::size_t addrlen, std::size_t segment_size,
+                                              abnet::error_code &ec, size_t &bytes_transferred);
+
+#endif // defined(UDP_SEGMENT)
+
+#if defined(UDP_GRO)
+
+// Receive on a socket with the UDP_GRO option set, where the kernel may
+// deliver several datagrams from the same sender coalesced into one. On
+// success segment_size holds the size of each datagram but the last, or the
+// number of bytes received if nothing was coalesced.
+ABNET_DECL signed_size_type recvfrom_coalesced(socket_type s, buf *bufs, size_t count, int flags, void *addr,
+                                               std::size_t *addrlen, std::size_t &segment_size,
+                                               abnet::error_code &ec);
+
+ABNET_DECL size_t sync_recvfrom_coalesced(socket_type s, state_type state, buf *bufs, size_t count, int flags,
+                                          void *addr, std::size_t *addrlen, std::size_t &segment_size,
+                                          abnet::error_code &ec);
+
+ABNET_DECL bool non_blocking_recvfrom_coalesced(socket_type s, buf *bufs, size_t count, int flags, void *addr,
+                                                std::size_t *addrlen, std::size_t &segment_size,
+                                                abnet::error_code &ec, size_t &bytes_transferred);
+
+#endif // defined(UDP_GRO)
+
 ABNET_DECL socket_type socket(int af, int type, int protocol, abnet::error_code &ec);
 
 template <typename T>
@@ -246,6 +440,15 @@ setsockopt(socket_type s, T &&state, int level, int optname, const void *optval,
 ABNET_DECL int getsockopt(socket_type s, state_type state, int level, int optname, void *optval, size_t *optlen,
                           abnet::error_code &ec);
 
+#if defined(SO_INCOMING_CPU)
+
+// The CPU that processed the last packet received on a socket, which for an
+// accepted socket is normally the CPU serving the NIC queue the connection
+// arrived on. Returns -1 if unknown or on failure.
+ABNET_DECL int incoming_cpu(socket_type s, abnet::error_code &ec);
+
+#endif // defined(SO_INCOMING_CPU)
+
 ABNET_DECL int getpeername(socket_type s, void *addr, std::size_t *addrlen, bool cached, abnet::error_code &ec);
 
 ABNET_DECL int getsockname(socket_type s, void *addr, std::size_t *addrlen, abnet::error_code &ec);
@@ -263,6 +466,10 @@ ABNET_DECL int poll_error(socket_type s, state_type state, int msec, abnet::erro
 
 ABNET_DECL int poll_connect(socket_type s, int msec, abnet::error_code &ec);
 
+// The milliseconds left until deadline, rounded up so that a wait never ends
+// before it. Zero once the deadline has passed.
+ABNET_DECL int remaining_msec(const deadline_type &deadline);
+
 #endif // !defined(ABNET_WINDOWS_RUNTIME)
 
 ABNET_DECL const char *inet_ntop(int af, const void *src, char *dest, size_t length, unsigned long scope_id,
@@ -17,13 +17,17 @@
 
 #include "abnet/config.hpp"
 
+#include <atomic>
 #include <cassert>
 #include <cctype>
 #include <cerrno>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
 #include <new>
+#include <vector>
 
 #include "abnet/error.hpp"
 #include "abnet/socket_ops.hpp"
@@ -45,6 +49,12 @@
 #include <malloc.h>
 #endif // defined(_MSC_VER) && (_MSC_VER >= 1800)
 
+#if defined(__linux__)
+#include <pthread.h>
+#include <signal.h>
+#include <sys/sendfile.h>
+#endif // defined(__linux__)
+
 #include "abnet/push_options.hpp"
 
 namespace abnet {
@@ -159,6 +169,59 @@ socket_type sync_accept(socket_type s, state_type state, void *addr, std::size_t
   }
 }
 
+socket_type sync_accept(socket_type s, state_type state, void *addr, std::size_t *addrlen,
+                        const deadline_type &deadline, abnet::error_code &ec) {
+  // A blocking accept cannot be bounded, so wait for a connection first.
+  if (!(state & non_blocking)) {
+    int result = socket_ops::poll_read(s, 0, socket_ops::remaining_msec(deadline), ec);
+    if (result < 0)
+      return invalid_socket;
+    if (result == 0) {
+      ec = abnet::error::timed_out;
+      return invalid_socket;
+    }
+  }
+
+  // Accept a socket.
+  for (;;) {
+    // Try to complete the operation without blocking.
+    socket_type new_socket = socket_ops::accept(s, addr, addrlen, ec);
+
+    // Check if operation succeeded.
+    if (new_socket != invalid_socket)
+      return new_socket;
+
+    // Operation failed.
+    if (ec == abnet::error::would_block || ec == abnet::error::try_again) {
+      if (state & user_set_non_blocking)
+        return invalid_socket;
+      // Fall through to retry operation.
+    } else if (ec == abnet::error::connection_aborted) {
+      if (state & enable_connection_aborted)
+        return invalid_socket;
+      // Fall through to retry operation.
+    }
+#if defined(EPROTO)
+    else if (ec.value() == EPROTO) {
+      if (state & enable_connection_aborted)
+        return invalid_socket;
+      // Fall through to retry operation.
+    }
+#endif // defined(EPROTO)
+    else
+      return invalid_socket;
+
+    // Wait for socket to become ready, for no longer than the time left.
+    int result = socket_ops::poll_read(s, 0, socket_ops::remaining_msec(deadline), ec);
+    if (result < 0)
+      return invalid_socket;
+    if (result == 0) {
+      ec = abnet::error::timed_out;
+      return invalid_socket;
+    }
+  }
+}
+
 #if defined(ABNET_HAS_IOCP)
 
 void complete_iocp_accept(socket_type s, void *output_buffer, DWORD address_length, void *addr, std::size_t *addrlen,
@@ -232,6 +295,99 @@ bool non_blocking_accept(socket_type s, state_type state, void *addr, std::size_
   }
 }
 
+inline socket_type accept_for_batch(socket_type s, abnet::error_code &ec) {
+#if defined(__linux__)
+  // Skip the separate fcntl for close-on-exec that a plain accept would need.
+  socket_type new_s = ::accept4(s, 0, 0, SOCK_CLOEXEC);
+  get_last_error(ec, new_s == invalid_socket);
+  return new_s;
+#else  // defined(__linux__)
+  return socket_ops::accept(s, 0, 0, ec);
+#endif // defined(__linux__)
+}
+
+bool non_blocking_accept_batch(socket_type s, state_type state, socket_type *new_sockets, size_t max_sockets,
+                               abnet::error_code &ec, size_t &sockets_accepted) {
+  if (s == invalid_socket) {
+    ec = abnet::error::bad_descriptor;
+    sockets_accepted = 0;
+    return true;
+  }
+
+  // Drain the backlog until it is empty or the output array is full.
+  sockets_accepted = 0;
+  abnet::error::clear(ec);
+  while (sockets_accepted < max_sockets) {
+    // A blocking listener never reports EAGAIN, so once something has been
+    // accepted only go on while another connection is already queued.
+    if (sockets_accepted > 0 && !(state & non_blocking)) {
+      abnet::error_code poll_ec;
+      if (socket_ops::poll_read(s, state, 0, poll_ec) <= 0)
+        break;
+    }
+
+    socket_type new_socket = accept_for_batch(s, ec);
+
+    // Check if operation succeeded.
+    if (new_socket != invalid_socket) {
+      new_sockets[sockets_accepted++] = new_socket;
+      continue;
+    }
+
+    // Retry operation if interrupted by signal.
+    if (ec == abnet::error::interrupted)
+      continue;
+
+    // The backlog has been drained.
+    if (ec == abnet::error::would_block || ec == abnet::error::try_again)
+      break;
+
+    // Skip connections that were aborted before they could be accepted.
+    if (ec == abnet::error::connection_aborted) {
+      if (state & enable_connection_aborted)
+        break;
+      continue;
+    }
+#if defined(EPROTO)
+    if (ec.value() == EPROTO) {
+      if (state & enable_connection_aborted)
+        break;
+      continue;
+    }
+#endif // defined(EPROTO)
+
+    // Operation failed. Report the error only if nothing was accepted, it will
+    // be seen again by the next call otherwise.
+    break;
+  }
+
+  if (sockets_accepted > 0) {
+    abnet::error::clear(ec);
+    return true;
+  }
+
+  return ec != abnet::error::would_block && ec != abnet::error::try_again;
+}
+
+size_t sync_accept_batch(socket_type s, state_type state, socket_type *new_sockets, size_t max_sockets,
+                         abnet::error_code &ec) {
+  // Accept a batch of sockets.
+  for (;;) {
+    // Try to complete the operation without blocking.
+    size_t sockets_accepted = 0;
+    if (socket_ops::non_blocking_accept_batch(s, state, new_sockets, max_sockets, ec, sockets_accepted))
+      return sockets_accepted;
+
+    // Operation would block.
+    if (state & user_set_non_blocking)
+      return 0;
+
+    // Wait for socket to become ready.
+    if (socket_ops::poll_read(s, 0, -1, ec) < 0)
+      return 0;
+  }
+}
+
 #endif // defined(ABNET_HAS_IOCP)
 
 template <typename SockLenType>
@@ -249,11 +405,61 @@ int bind(socket_type s, const void *addr, std::size_t addrlen, abnet::error_code
   get_last_error(ec, result != 0);
   return result;
 }
+
+namespace close_observer_ops {
+
+struct observer_list {
+  observer_list() : count_(0) {}
+
+  std::mutex mutex_;
+  std::vector<close_observer *> observers_;
+
+  // Lets close() skip the lock when nothing is registered.
+  std::atomic<std::size_t> count_;
+};
+
+inline observer_list &observers() {
+  static observer_list list;
+  return list;
+}
+
+inline void notify(socket_type s) {
+  observer_list &list = observers();
+  if (list.count_.load(std::memory_order_acquire) == 0)
+    return;
+  std::lock_guard<std::mutex> lock(list.mutex_);
+  for (std::size_t i = 0; i < list.observers_.size(); ++i)
+    list.observers_[i]->descriptor_closing(s);
+}
+
+} // namespace close_observer_ops
+
+void add_close_observer(close_observer *observer) {
+  close_observer_ops::observer_list &list = close_observer_ops::observers();
+  std::lock_guard<std::mutex> lock(list.mutex_);
+  list.observers_.push_back(observer);
+  list.count_.store(list.observers_.size(), std::memory_order_release);
+}
+
+void remove_close_observer(close_observer *observer) {
+  close_observer_ops::observer_list &list = close_observer_ops::observers();
+  std::lock_guard<std::mutex> lock(list.mutex_);
+  for (std::size_t i = 0; i < list.observers_.size(); ++i) {
+    if (list.observers_[i] == observer) {
+      list.observers_.erase(list.observers_.begin() + i);
+      break;
+    }
+  }
+  list.count_.store(list.observers_.size(), std::memory_order_release);
+}
+
 template <typename T>
 typename std::enable_if<std::is_convertible<typename std::decay<T>::type, state_type>::value, int>::type
 close(socket_type s, T &&state, bool destruction, abnet::error_code &ec) {
   int result = 0;
   if (s != invalid_socket) {
+    close_observer_ops::notify(s);
+
     // We don't want the destructor to block, so set the socket to linger in
     // the background. If the user doesn't like this behaviour then they need
     // to explicitly close the socket.
@@ -498,6 +704,45 @@ void sync_connect(socket_type s, const void *addr, std::size_t addrlen, abnet::e
   ec = abnet::error_code(connect_error, abnet::error::get_system_category());
 }
 
+void sync_connect(socket_type s, const void *addr, std::size_t addrlen, const deadline_type &deadline,
+                  abnet::error_code &ec) {
+  // Perform the connect operation without blocking, so that the wait can be
+  // bounded. Windows sockets must already be in non-blocking mode.
+#if defined(ABNET_WINDOWS) || defined(__CYGWIN__)
+  socket_ops::connect(s, addr, addrlen, ec);
+#else  // defined(ABNET_WINDOWS) || defined(__CYGWIN__)
+  int fl = ::fcntl(s, F_GETFL, 0);
+  if (fl >= 0 && !(fl & O_NONBLOCK))
+    ::fcntl(s, F_SETFL, fl | O_NONBLOCK);
+  socket_ops::connect(s, addr, addrlen, ec);
+  if (fl >= 0 && !(fl & O_NONBLOCK))
+    ::fcntl(s, F_SETFL, fl);
+#endif // defined(ABNET_WINDOWS) || defined(__CYGWIN__)
+  if (ec != abnet::error::in_progress && ec != abnet::error::would_block) {
+    // The connect operation finished immediately.
+    return;
+  }
+
+  // Wait for socket to become ready, for no longer than the time left. The
+  // connection is left in progress on timeout, so the socket should be closed.
+  int result = socket_ops::poll_connect(s, socket_ops::remaining_msec(deadline), ec);
+  if (result < 0)
+    return;
+  if (result == 0) {
+    ec = abnet::error::timed_out;
+    return;
+  }
+
+  // Get the error code from the connect operation.
+  int connect_error = 0;
+  size_t connect_error_len = sizeof(connect_error);
+  if (socket_ops::getsockopt(s, 0, SOL_SOCKET, SO_ERROR, &connect_error, &connect_error_len, ec) == socket_error_retval)
+    return;
+
+  // Return the result of the connect operation.
+  ec = abnet::error_code(connect_error, abnet::error::get_system_category());
+}
+
 #if defined(ABNET_HAS_IOCP)
 
 void complete_iocp_connect(socket_type s, abnet::error_code &ec) {
@@ -676,6 +921,39 @@ void init_buf(buf &b, const void *data, size_t size) {
 #endif // defined(ABNET_WINDOWS) || defined(__CYGWIN__)
 }
 
+inline size_t buf_size(const buf &b) {
+#if defined(ABNET_WINDOWS) || defined(__CYGWIN__)
+  return b.len;
+#else  // defined(ABNET_WINDOWS) || defined(__CYGWIN__)
+  return b.iov_len;
+#endif // defined(ABNET_WINDOWS) || defined(__CYGWIN__)
+}
+
+size_t buffer_sequence::size() const {
+  size_t total = 0;
+  for (size_t i = first_; i < end_; ++i)
+    total += buf_size(bufs_[i]);
+  return total;
+}
+
+void buffer_sequence::consume(size_t bytes) {
+  // Skip the buffers sent in full, along with any empty ones after them.
+  while (first_ < end_ && bytes >= buf_size(bufs_[first_])) {
+    bytes -= buf_size(bufs_[first_]);
+    ++first_;
+  }
+  if (first_ < end_ && bytes > 0) {
+    buf &b = bufs_[first_];
+#if defined(ABNET_WINDOWS) || defined(__CYGWIN__)
+    b.buf += bytes;
+    b.len -= static_cast<u_long>(bytes);
+#else  // defined(ABNET_WINDOWS) || defined(__CYGWIN__)
+    b.iov_base = static_cast<char *>(b.iov_base) + bytes;
+    b.iov_len -= bytes;
+#endif // defined(ABNET_WINDOWS) || defined(__CYGWIN__)
+  }
+}
+
 inline void init_msghdr_msg_name(void *&name, void *addr) { name = static_cast<socket_addr_type *>(addr); }
 
 inline void init_msghdr_msg_name(void *&name, const socket_addr_type *addr) {
@@ -781,6 +1059,56 @@ size_t sync_recv(socket_type s, state_type state, buf *bufs, size_t count, int f
   }
 }
 
+size_t sync_recv(socket_type s, state_type state, buf *bufs, size_t count, int flags, bool all_empty,
+                 const deadline_type &deadline, abnet::error_code &ec) {
+  if (s == invalid_socket) {
+    ec = abnet::error::bad_descriptor;
+    return 0;
+  }
+
+  // A request to read 0 bytes on a stream is a no-op.
+  if (all_empty && (state & stream_oriented)) {
+    abnet::error::clear(ec);
+    return 0;
+  }
+
+#if defined(MSG_DONTWAIT)
+  // Never let a blocking socket wait past the deadline inside recv.
+  int dontwait_flags = flags | MSG_DONTWAIT;
+#else  // defined(MSG_DONTWAIT)
+  int dontwait_flags = flags;
+#endif // defined(MSG_DONTWAIT)
+
+  // Read some data.
+  for (;;) {
+    // Try to complete the operation without blocking.
+    signed_size_type bytes = socket_ops::recv(s, bufs, count, dontwait_flags, ec);
+
+    // Check for EOF.
+    if ((state & stream_oriented) && bytes == 0) {
+      ec = abnet::error::eof;
+      return 0;
+    }
+
+    // Check if operation succeeded.
+    if (bytes >= 0)
+      return bytes;
+
+    // Operation failed.
+    if ((state & user_set_non_blocking) || (ec != abnet::error::would_block && ec != abnet::error::try_again))
+      return 0;
+
+    // Wait for socket to become ready, for no longer than the time left.
+    int result = socket_ops::poll_read(s, 0, socket_ops::remaining_msec(deadline), ec);
+    if (result < 0)
+      return 0;
+    if (result == 0) {
+      ec = abnet::error::timed_out;
+      return 0;
+    }
+  }
+}
+
 size_t sync_recv1(socket_type s, state_type state, void *data, size_t size, int flags, abnet::error_code &ec) {
   if (s == invalid_socket) {
     ec = abnet::error::bad_descriptor;
@@ -1288,6 +1616,50 @@ size_t sync_send(socket_type s, state_type state, const buf *bufs, size_t count,
   }
 }
 
+size_t sync_send(socket_type s, state_type state, const buf *bufs, size_t count, int flags, bool all_empty,
+                 const deadline_type &deadline, abnet::error_code &ec) {
+  if (s == invalid_socket) {
+    ec = abnet::error::bad_descriptor;
+    return 0;
+  }
+
+  // A request to write 0 bytes to a stream is a no-op.
+  if (all_empty && (state & stream_oriented)) {
+    abnet::error::clear(ec);
+    return 0;
+  }
+
+#if defined(MSG_DONTWAIT)
+  // Never let a blocking socket wait past the deadline inside send.
+  int dontwait_flags = flags | MSG_DONTWAIT;
+#else  // defined(MSG_DONTWAIT)
+  int dontwait_flags = flags;
+#endif // defined(MSG_DONTWAIT)
+
+  // Write some data.
+  for (;;) {
+    // Try to complete the operation without blocking.
+    signed_size_type bytes = socket_ops::send(s, bufs, count, dontwait_flags, ec);
+
+    // Check if operation succeeded.
+    if (bytes >= 0)
+      return bytes;
+
+    // Operation failed.
+    if ((state & user_set_non_blocking) || (ec != abnet::error::would_block && ec != abnet::error::try_again))
+      return 0;
+
+    // Wait for socket to become ready, for no longer than the time left.
+    int result = socket_ops::poll_write(s, 0, socket_ops::remaining_msec(deadline), ec);
+    if (result < 0)
+      return 0;
+    if (result == 0) {
+      ec = abnet::error::timed_out;
+      return 0;
+    }
+  }
+}
+
 size_t sync_send1(socket_type s, state_type state, const void *data, size_t size, int flags, abnet::error_code &ec) {
   if (s == invalid_socket) {
     ec = abnet::error::bad_descriptor;
@@ -1319,6 +1691,19 @@ size_t sync_send1(socket_type s, state_type state, const void *data, size_t size
   }
 }
 
+size_t sync_send(socket_type s, state_type state, buffer_sequence &bufs, int flags, abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  size_t total = 0;
+  while (!bufs.empty()) {
+    size_t bytes = socket_ops::sync_send(s, state, bufs.data(), bufs.count(), flags, false, ec);
+    if (ec)
+      break;
+    bufs.consume(bytes);
+    total += bytes;
+  }
+  return total;
+}
+
 #if defined(ABNET_HAS_IOCP)
 
 void complete_iocp_send(const weak_cancel_token_type &cancel_token, abnet::error_code &ec) {
@@ -1387,19 +1772,154 @@ bool non_blocking_send1(socket_type s, const void *data, size_t size, int flags,
   }
 }
 
+bool non_blocking_send(socket_type s, buffer_sequence &bufs, int flags, abnet::error_code &ec,
+                       size_t &bytes_transferred) {
+  abnet::error::clear(ec);
+  bytes_transferred = 0;
+  while (!bufs.empty()) {
+    size_t bytes = 0;
+    if (!socket_ops::non_blocking_send(s, bufs.data(), bufs.count(), flags, ec, bytes))
+      return false;
+    if (ec)
+      return true;
+    bufs.consume(bytes);
+    bytes_transferred += bytes;
+  }
+  return true;
+}
+
 #endif // defined(ABNET_HAS_IOCP)
 
-signed_size_type sendto(socket_type s, const buf *bufs, size_t count, int flags, const void *addr, std::size_t addrlen,
-                        abnet::error_code &ec) {
-#if defined(ABNET_WINDOWS) || defined(__CYGWIN__)
-  // Send the data.
-  DWORD send_buf_count = static_cast<DWORD>(count);
-  DWORD bytes_transferred = 0;
-  int result = ::WSASendTo(s, const_cast<buf *>(bufs), send_buf_count, &bytes_transferred, flags,
-                           static_cast<const socket_addr_type *>(addr), static_cast<int>(addrlen), 0, 0);
-  get_last_error(ec, true);
-  if (ec.value() == ERROR_NETNAME_DELETED)
-    ec = abnet::error::connection_reset;
+#if !defined(ABNET_WINDOWS) && !defined(__CYGWIN__)
+
+#if defined(__linux__)
+
+sigpipe_guard::sigpipe_guard() : was_pending_(false) {
+  sigset_t pipe_mask;
+  sigemptyset(&pipe_mask);
+  sigaddset(&pipe_mask, SIGPIPE);
+  ::pthread_sigmask(SIG_BLOCK, &pipe_mask, &old_mask_);
+
+  sigset_t pending;
+  if (::sigpending(&pending) == 0)
+    was_pending_ = sigismember(&pending, SIGPIPE) == 1;
+}
+
+sigpipe_guard::~sigpipe_guard() {
+  if (!was_pending_) {
+    sigset_t pending;
+    if (::sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE) == 1) {
+      sigset_t pipe_mask;
+      sigemptyset(&pipe_mask);
+      sigaddset(&pipe_mask, SIGPIPE);
+      timespec no_wait = {0, 0};
+      while (::sigtimedwait(&pipe_mask, 0, &no_wait) < 0 && errno == EINTR)
+        ;
+    }
+  }
+  ::pthread_sigmask(SIG_SETMASK, &old_mask_, 0);
+}
+
+#endif // defined(__linux__)
+
+signed_size_type send_file(socket_type s, int fd, off_t &offset, size_t count, abnet::error_code &ec) {
+#if defined(__linux__)
+  // sendfile has no MSG_NOSIGNAL, so keep a peer reset from raising SIGPIPE.
+  signed_size_type result;
+  {
+    sigpipe_guard guard;
+    result = ::sendfile(s, fd, &offset, count);
+    get_last_error(ec, result < 0);
+  }
+#else  // defined(__linux__)
+  // Bounce the data through a buffer where there is no sendfile with the
+  // same semantics.
+  char data[65536];
+  signed_size_type result = ::pread(fd, data, count < sizeof(data) ? count : sizeof(data), offset);
+  get_last_error(ec, result < 0);
+  if (result > 0) {
+    result = socket_ops::send1(s, data, result, 0, ec);
+    if (result > 0)
+      offset += result;
+  }
+#endif // defined(__linux__)
+
+  // Check if the file ended before the requested range.
+  if (result == 0 && count > 0)
+    ec = abnet::error::eof;
+  return result;
+}
+
+size_t sync_send_file(socket_type s, state_type state, int fd, off_t &offset, size_t count, abnet::error_code &ec) {
+  if (s == invalid_socket) {
+    ec = abnet::error::bad_descriptor;
+    return 0;
+  }
+
+  // A request to write 0 bytes is a no-op.
+  if (count == 0) {
+    abnet::error::clear(ec);
+    return 0;
+  }
+
+  // Write some data.
+  for (;;) {
+    // Try to complete the operation without blocking.
+    signed_size_type bytes = socket_ops::send_file(s, fd, offset, count, ec);
+
+    // Check if operation succeeded.
+    if (bytes >= 0)
+      return bytes;
+
+    // Operation failed.
+    if ((state & user_set_non_blocking) || (ec != abnet::error::would_block && ec != abnet::error::try_again))
+      return 0;
+
+    // Wait for socket to become ready.
+    if (socket_ops::poll_write(s, 0, -1, ec) < 0)
+      return 0;
+  }
+}
+
+bool non_blocking_send_file(socket_type s, int fd, off_t &offset, size_t count, abnet::error_code &ec,
+                            size_t &bytes_transferred) {
+  for (;;) {
+    // Write some data.
+    signed_size_type bytes = socket_ops::send_file(s, fd, offset, count, ec);
+
+    // Check if operation succeeded.
+    if (bytes >= 0) {
+      bytes_transferred = bytes;
+      return true;
+    }
+
+    // Retry operation if interrupted by signal.
+    if (ec == abnet::error::interrupted)
+      continue;
+
+    // Check if we need to run the operation again.
+    if (ec == abnet::error::would_block || ec == abnet::error::try_again)
+      return false;
+
+    // Operation failed.
+    bytes_transferred = 0;
+    return true;
+  }
+}
+
+#endif // !defined(ABNET_WINDOWS) && !defined(__CYGWIN__)
+
+signed_size_type sendto(socket_type s, const buf *bufs, size_t count, int flags, const void *addr, std::size_t addrlen,
+                        abnet::error_code &ec) {
+#if defined(ABNET_WINDOWS) || defined(__CYGWIN__)
+  // Send the data.
+  DWORD send_buf_count = static_cast<DWORD>(count);
+  DWORD bytes_transferred = 0;
+  int result = ::WSASendTo(s, const_cast<buf *>(bufs), send_buf_count, &bytes_transferred, flags,
+                           static_cast<const socket_addr_type *>(addr), static_cast<int>(addrlen), 0, 0);
+  get_last_error(ec, true);
+  if (ec.value() == ERROR_NETNAME_DELETED)
+    ec = abnet::error::connection_reset;
   else if (ec.value() == ERROR_PORT_UNREACHABLE)
     ec = abnet::error::connection_refused;
   if (result != 0)
@@ -1565,6 +2085,379 @@ bool non_blocking_sendto1(socket_type s, const void *data, size_t size, int flag
 
 #endif // !defined(ABNET_HAS_IOCP)
 
+#if defined(__linux__)
+inline void init_mmsghdr(mmsghdr &hdr, datagram &msg) {
+  hdr.msg_hdr = msghdr();
+  init_msghdr_msg_name(hdr.msg_hdr.msg_name, msg.addr);
+  hdr.msg_hdr.msg_namelen = static_cast<socklen_t>(msg.addrlen);
+  hdr.msg_hdr.msg_iov = msg.bufs;
+  hdr.msg_hdr.msg_iovlen = msg.count;
+  hdr.msg_len = 0;
+}
+#endif // defined(__linux__)
+
+signed_size_type recvfrom_batch(socket_type s, datagram *msgs, size_t count, int flags, abnet::error_code &ec) {
+  if (count > max_datagram_batch)
+    count = max_datagram_batch;
+#if defined(__linux__)
+  mmsghdr hdrs[max_datagram_batch];
+  for (size_t i = 0; i < count; ++i)
+    init_mmsghdr(hdrs[i], msgs[i]);
+
+  // Return once the first datagram has arrived, rather than waiting for the
+  // whole batch on a blocking socket.
+  int result = ::recvmmsg(s, hdrs, static_cast<unsigned int>(count), flags | MSG_WAITFORONE, 0);
+  get_last_error(ec, result < 0);
+  for (int i = 0; i < result; ++i) {
+    msgs[i].addrlen = hdrs[i].msg_hdr.msg_namelen;
+    msgs[i].bytes_transferred = hdrs[i].msg_len;
+    msgs[i].flags = hdrs[i].msg_hdr.msg_flags;
+  }
+  return result;
+#else  // defined(__linux__)
+  size_t n = 0;
+  for (; n < count; ++n) {
+    std::size_t addrlen = msgs[n].addrlen;
+    signed_size_type bytes = socket_ops::recvfrom(s, msgs[n].bufs, msgs[n].count, flags, msgs[n].addr, &addrlen, ec);
+    if (bytes < 0)
+      break;
+    msgs[n].addrlen = addrlen;
+    msgs[n].bytes_transferred = bytes;
+    msgs[n].flags = 0;
+#if defined(MSG_DONTWAIT)
+    // Only the first datagram may be waited for.
+    flags |= MSG_DONTWAIT;
+#endif // defined(MSG_DONTWAIT)
+  }
+  if (n == 0 && count > 0)
+    return socket_error_retval;
+  abnet::error::clear(ec);
+  return n;
+#endif // defined(__linux__)
+}
+
+size_t sync_recvfrom_batch(socket_type s, state_type state, datagram *msgs, size_t count, int flags,
+                           abnet::error_code &ec) {
+  if (s == invalid_socket) {
+    ec = abnet::error::bad_descriptor;
+    return 0;
+  }
+
+  // Read a batch of datagrams.
+  for (;;) {
+    // Try to complete the operation without blocking.
+    signed_size_type messages = socket_ops::recvfrom_batch(s, msgs, count, flags, ec);
+
+    // Check if operation succeeded.
+    if (messages >= 0)
+      return messages;
+
+    // Operation failed.
+    if ((state & user_set_non_blocking) || (ec != abnet::error::would_block && ec != abnet::error::try_again))
+      return 0;
+
+    // Wait for socket to become ready.
+    if (socket_ops::poll_read(s, 0, -1, ec) < 0)
+      return 0;
+  }
+}
+
+signed_size_type sendto_batch(socket_type s, datagram *msgs, size_t count, int flags, abnet::error_code &ec) {
+  if (count > max_datagram_batch)
+    count = max_datagram_batch;
+#if defined(__linux__)
+  mmsghdr hdrs[max_datagram_batch];
+  for (size_t i = 0; i < count; ++i)
+    init_mmsghdr(hdrs[i], msgs[i]);
+#if defined(ABNET_HAS_MSG_NOSIGNAL)
+  flags |= MSG_NOSIGNAL;
+#endif // defined(ABNET_HAS_MSG_NOSIGNAL)
+  int result = ::sendmmsg(s, hdrs, static_cast<unsigned int>(count), flags);
+  get_last_error(ec, result < 0);
+  for (int i = 0; i < result; ++i)
+    msgs[i].bytes_transferred = hdrs[i].msg_len;
+  return result;
+#else  // defined(__linux__)
+  size_t n = 0;
+  for (; n < count; ++n) {
+    signed_size_type bytes =
+        socket_ops::sendto(s, msgs[n].bufs, msgs[n].count, flags, msgs[n].addr, msgs[n].addrlen, ec);
+    if (bytes < 0)
+      break;
+    msgs[n].bytes_transferred = bytes;
+  }
+  if (n == 0 && count > 0)
+    return socket_error_retval;
+  abnet::error::clear(ec);
+  return n;
+#endif // defined(__linux__)
+}
+
+size_t sync_sendto_batch(socket_type s, state_type state, datagram *msgs, size_t count, int flags,
+                         abnet::error_code &ec) {
+  if (s == invalid_socket) {
+    ec = abnet::error::bad_descriptor;
+    return 0;
+  }
+
+  // Write a batch of datagrams.
+  for (;;) {
+    // Try to complete the operation without blocking.
+    signed_size_type messages = socket_ops::sendto_batch(s, msgs, count, flags, ec);
+
+    // Check if operation succeeded.
+    if (messages >= 0)
+      return messages;
+
+    // Operation failed.
+    if ((state & user_set_non_blocking) || (ec != abnet::error::would_block && ec != abnet::error::try_again))
+      return 0;
+
+    // Wait for socket to become ready.
+    if (socket_ops::poll_write(s, 0, -1, ec) < 0)
+      return 0;
+  }
+}
+
+#if !defined(ABNET_HAS_IOCP)
+
+bool non_blocking_recvfrom_batch(socket_type s, datagram *msgs, size_t count, int flags, abnet::error_code &ec,
+                                 size_t &messages_transferred) {
+  for (;;) {
+    // Read a batch of datagrams.
+    signed_size_type messages = socket_ops::recvfrom_batch(s, msgs, count, flags, ec);
+
+    // Check if operation succeeded.
+    if (messages >= 0) {
+      messages_transferred = messages;
+      return true;
+    }
+
+    // Retry operation if interrupted by signal.
+    if (ec == abnet::error::interrupted)
+      continue;
+
+    // Check if we need to run the operation again.
+    if (ec == abnet::error::would_block || ec == abnet::error::try_again)
+      return false;
+
+    // Operation failed.
+    messages_transferred = 0;
+    return true;
+  }
+}
+
+bool non_blocking_sendto_batch(socket_type s, datagram *msgs, size_t count, int flags, abnet::error_code &ec,
+                               size_t &messages_transferred) {
+  for (;;) {
+    // Write a batch of datagrams.
+    signed_size_type messages = socket_ops::sendto_batch(s, msgs, count, flags, ec);
+
+    // Check if operation succeeded.
+    if (messages >= 0) {
+      messages_transferred = messages;
+      return true;
+    }
+
+    // Retry operation if interrupted by signal.
+    if (ec == abnet::error::interrupted)
+      continue;
+
+    // Check if we need to run the operation again.
+    if (ec == abnet::error::would_block || ec == abnet::error::try_again)
+      return false;
+
+    // Operation failed.
+    messages_transferred = 0;
+    return true;
+  }
+}
+
+#endif // !defined(ABNET_HAS_IOCP)
+
+#if defined(UDP_SEGMENT)
+
+signed_size_type sendto_segmented(socket_type s, const buf *bufs, size_t count, int flags, const void *addr,
+                                  std::size_t addrlen, std::size_t segment_size, abnet::error_code &ec) {
+  if (segment_size == 0 || segment_size > 0xffff) {
+    ec = abnet::error::invalid_argument;
+    return socket_error_retval;
+  }
+
+  union {
+    cmsghdr align;
+    char data[CMSG_SPACE(sizeof(uint16_t))];
+  } control;
+  std::memset(&control, 0, sizeof(control));
+
+  msghdr msg = msghdr();
+  init_msghdr_msg_name(msg.msg_name, addr);
+  msg.msg_namelen = static_cast<int>(addrlen);
+  msg.msg_iov = const_cast<buf *>(bufs);
+  msg.msg_iovlen = static_cast<int>(count);
+  msg.msg_control = control.data;
+  msg.msg_controllen = sizeof(control.data);
+
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_UDP;
+  cmsg->cmsg_type = UDP_SEGMENT;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+  uint16_t gso_size = static_cast<uint16_t>(segment_size);
+  std::memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+
+#if defined(ABNET_HAS_MSG_NOSIGNAL)
+  flags |= MSG_NOSIGNAL;
+#endif // defined(ABNET_HAS_MSG_NOSIGNAL)
+  signed_size_type result = ::sendmsg(s, &msg, flags);
+  get_last_error(ec, result < 0);
+  return result;
+}
+
+size_t sync_sendto_segmented(socket_type s, state_type state, const buf *bufs, size_t count, int flags,
+                             const void *addr, std::size_t addrlen, std::size_t segment_size, abnet::error_code &ec) {
+  if (s == invalid_socket) {
+    ec = abnet::error::bad_descriptor;
+    return 0;
+  }
+
+  // Write some data.
+  for (;;) {
+    // Try to complete the operation without blocking.
+    signed_size_type bytes = socket_ops::sendto_segmented(s, bufs, count, flags, addr, addrlen, segment_size, ec);
+
+    // Check if operation succeeded.
+    if (bytes >= 0)
+      return bytes;
+
+    // Operation failed.
+    if ((state & user_set_non_blocking) || (ec != abnet::error::would_block && ec != abnet::error::try_again))
+      return 0;
+
+    // Wait for socket to become ready.
+    if (socket_ops::poll_write(s, 0, -1, ec) < 0)
+      return 0;
+  }
+}
+
+bool non_blocking_sendto_segmented(socket_type s, const buf *bufs, size_t count, int flags, const void *addr,
+                                   std::size_t addrlen, std::size_t segment_size, abnet::error_code &ec,
+                                   size_t &bytes_transferred) {
+  for (;;) {
+    // Write some data.
+    signed_size_type bytes = socket_ops::sendto_segmented(s, bufs, count, flags, addr, addrlen, segment_size, ec);
+
+    // Check if operation succeeded.
+    if (bytes >= 0) {
+      bytes_transferred = bytes;
+      return true;
+    }
+
+    // Retry operation if interrupted by signal.
+    if (ec == abnet::error::interrupted)
+      continue;
+
+    // Check if we need to run the operation again.
+    if (ec == abnet::error::would_block || ec == abnet::error::try_again)
+      return false;
+
+    // Operation failed.
+    bytes_transferred = 0;
+    return true;
+  }
+}
+
+#endif // defined(UDP_SEGMENT)
+
+#if defined(UDP_GRO)
+
+signed_size_type recvfrom_coalesced(socket_type s, buf *bufs, size_t count, int flags, void *addr,
+                                    std::size_t *addrlen, std::size_t &segment_size, abnet::error_code &ec) {
+  union {
+    cmsghdr align;
+    char data[CMSG_SPACE(sizeof(int))];
+  } control;
+
+  msghdr msg = msghdr();
+  init_msghdr_msg_name(msg.msg_name, addr);
+  msg.msg_namelen = addrlen ? static_cast<int>(*addrlen) : 0;
+  msg.msg_iov = bufs;
+  msg.msg_iovlen = static_cast<int>(count);
+  msg.msg_control = control.data;
+  msg.msg_controllen = sizeof(control.data);
+  signed_size_type result = ::recvmsg(s, &msg, flags);
+  get_last_error(ec, result < 0);
+  if (addrlen)
+    *addrlen = msg.msg_namelen;
+  if (result < 0)
+    return result;
+
+  // Without the control message the datagram was not coalesced.
+  segment_size = result;
+  for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+      int gso_size = 0;
+      std::memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+      segment_size = gso_size;
+    }
+  }
+  return result;
+}
+
+size_t sync_recvfrom_coalesced(socket_type s, state_type state, buf *bufs, size_t count, int flags, void *addr,
+                               std::size_t *addrlen, std::size_t &segment_size, abnet::error_code &ec) {
+  if (s == invalid_socket) {
+    ec = abnet::error::bad_descriptor;
+    return 0;
+  }
+
+  // Read some data.
+  for (;;) {
+    // Try to complete the operation without blocking.
+    signed_size_type bytes = socket_ops::recvfrom_coalesced(s, bufs, count, flags, addr, addrlen, segment_size, ec);
+
+    // Check if operation succeeded.
+    if (bytes >= 0)
+      return bytes;
+
+    // Operation failed.
+    if ((state & user_set_non_blocking) || (ec != abnet::error::would_block && ec != abnet::error::try_again))
+      return 0;
+
+    // Wait for socket to become ready.
+    if (socket_ops::poll_read(s, 0, -1, ec) < 0)
+      return 0;
+  }
+}
+
+bool non_blocking_recvfrom_coalesced(socket_type s, buf *bufs, size_t count, int flags, void *addr,
+                                     std::size_t *addrlen, std::size_t &segment_size, abnet::error_code &ec,
+                                     size_t &bytes_transferred) {
+  for (;;) {
+    // Read some data.
+    signed_size_type bytes = socket_ops::recvfrom_coalesced(s, bufs, count, flags, addr, addrlen, segment_size, ec);
+
+    // Check if operation succeeded.
+    if (bytes >= 0) {
+      bytes_transferred = bytes;
+      return true;
+    }
+
+    // Retry operation if interrupted by signal.
+    if (ec == abnet::error::interrupted)
+      continue;
+
+    // Check if we need to run the operation again.
+    if (ec == abnet::error::would_block || ec == abnet::error::try_again)
+      return false;
+
+    // Operation failed.
+    bytes_transferred = 0;
+    return true;
+  }
+}
+
+#endif // defined(UDP_GRO)
+
 socket_type socket(int af, int type, int protocol, abnet::error_code &ec) {
 #if defined(ABNET_WINDOWS) || defined(__CYGWIN__)
   socket_type s = ::WSASocketW(af, type, protocol, 0, 0, WSA_FLAG_OVERLAPPED);
@@ -1761,6 +2654,18 @@ int getsockopt(socket_type s, state_type state, int level, int optname, void *op
 #endif // defined(ABNET_WINDOWS) || defined(__CYGWIN__)
 }
 
+#if defined(SO_INCOMING_CPU)
+
+int incoming_cpu(socket_type s, abnet::error_code &ec) {
+  int cpu = -1;
+  size_t len = sizeof(cpu);
+  if (socket_ops::getsockopt(s, 0, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len, ec) != 0)
+    return -1;
+  return cpu;
+}
+
+#endif // defined(SO_INCOMING_CPU)
+
 template <typename SockLenType>
 inline int call_getpeername(SockLenType msghdr::*, socket_type s, void *addr, std::size_t *addrlen) {
   SockLenType tmp_addrlen = (SockLenType)*addrlen;
@@ -2062,6 +2967,20 @@ int poll_connect(socket_type s, int msec, abnet::error_code &ec) {
        // || defined(__SYMBIAN32__)
 }
 
+int remaining_msec(const deadline_type &deadline) {
+  deadline_type now = std::chrono::steady_clock::now();
+  if (deadline <= now)
+    return 0;
+
+  std::chrono::steady_clock::duration left = deadline - now;
+  std::chrono::milliseconds msec = std::chrono::duration_cast<std::chrono::milliseconds>(left);
+  if (msec < left)
+    ++msec;
+  if (msec.count() > INT_MAX)
+    return INT_MAX;
+  return static_cast<int>(msec.count());
+}
+
 #endif // !defined(ABNET_WINDOWS_RUNTIME)
 
 const char *inet_ntop(int af, const void *src, char *dest, size_t length, unsigned long scope_id,
@@ -81,6 +81,9 @@
 #if !defined(__SYMBIAN32__)
 #include <netinet/tcp.h>
 #endif
+#if defined(__linux__)
+#include <netinet/udp.h>
+#endif
 #include <arpa/inet.h>
 #include <limits.h>
 #include <net/if.h>
@@ -0,0 +1,110 @@
+//
+// splice_relay.hpp
+// ~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_SPLICE_RELAY_HPP
+#define ABNET_SPLICE_RELAY_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(__linux__)
+
+#include "abnet/error.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/socket_ops.hpp"
+#include "abnet/socket_types.hpp"
+#include <cstddef>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// Relays a pair of connected stream sockets into each other with splice(2).
+// Each direction moves its data through a pipe, so the payload stays in the
+// kernel. When one side shuts down sending, the other side's sending is shut
+// down once everything before it has been forwarded. A destination whose peer
+// has gone fails the relay with broken_pipe or connection_reset; SIGPIPE is
+// never raised.
+//
+// The relay switches both sockets to non-blocking mode. It does not own them
+// and leaves them open.
+class splice_relay : private noncopyable {
+public:
+  enum direction { a_to_b = 0, b_to_a = 1 };
+
+  // Constructor. Creates the pipes, setting ec on failure.
+  ABNET_DECL splice_relay(socket_type a, socket_type b, abnet::error_code &ec);
+
+  // Destructor. Closes the pipes, discarding any data still in them.
+  ABNET_DECL ~splice_relay();
+
+  // Move whatever can be moved in both directions without blocking. Returns
+  // true once both directions have been shut down, or with ec set when the
+  // relay failed.
+  ABNET_DECL bool non_blocking_relay(abnet::error_code &ec);
+
+  // Relay until both directions have been shut down, or an error occurs.
+  ABNET_DECL void sync_relay(abnet::error_code &ec);
+
+  // The poll events to wait for on a socket before relaying again.
+  ABNET_DECL short poll_events(socket_type s) const;
+
+  // Whether both directions have been shut down.
+  bool done() const { return paths_[a_to_b].shut_down_ && paths_[b_to_a].shut_down_; }
+
+  // The number of bytes forwarded in a direction.
+  std::size_t bytes_relayed(direction d) const { return paths_[d].bytes_; }
+
+private:
+  struct path {
+    path() : from_(invalid_socket), to_(invalid_socket), in_pipe_(0), bytes_(0), eof_(false), shut_down_(false) {
+      pipe_[0] = -1;
+      pipe_[1] = -1;
+    }
+
+    socket_type from_;
+    socket_type to_;
+    int pipe_[2];
+
+    // The number of bytes read into the pipe and not yet written out.
+    std::size_t in_pipe_;
+    std::size_t bytes_;
+
+    // Set when the source has no more data.
+    bool eof_;
+
+    // Set once the destination has been shut down for sending.
+    bool shut_down_;
+  };
+
+  // Move data along one path until neither end can make progress. Returns
+  // false with ec set on failure.
+  ABNET_DECL bool transfer(path &p, abnet::error_code &ec);
+
+  // The most data moved by one splice call.
+  enum { max_chunk = 65536 };
+
+  path paths_[2];
+  socket_ops::state_type a_state_;
+  socket_ops::state_type b_state_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/splice_relay.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(__linux__)
+
+#endif // ABNET_SPLICE_RELAY_HPP
@@ -0,0 +1,156 @@
+//
+// splice_relay.ipp
+// ~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_SPLICE_RELAY_IPP
+#define ABNET_SPLICE_RELAY_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "abnet/error.hpp"
+#include "abnet/splice_relay.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+splice_relay::splice_relay(socket_type a, socket_type b, abnet::error_code &ec)
+    : a_state_(socket_ops::stream_oriented), b_state_(socket_ops::stream_oriented) {
+  paths_[a_to_b].from_ = a;
+  paths_[a_to_b].to_ = b;
+  paths_[b_to_a].from_ = b;
+  paths_[b_to_a].to_ = a;
+
+  for (int i = 0; i < 2; ++i) {
+    if (::pipe2(paths_[i].pipe_, O_NONBLOCK | O_CLOEXEC) != 0) {
+      ec = abnet::error_code(errno, abnet::error::get_system_category());
+      return;
+    }
+  }
+
+  if (!socket_ops::set_internal_non_blocking(a, a_state_, true, ec))
+    return;
+  socket_ops::set_internal_non_blocking(b, b_state_, true, ec);
+}
+
+splice_relay::~splice_relay() {
+  for (int i = 0; i < 2; ++i) {
+    if (paths_[i].pipe_[0] != -1)
+      ::close(paths_[i].pipe_[0]);
+    if (paths_[i].pipe_[1] != -1)
+      ::close(paths_[i].pipe_[1]);
+  }
+}
+
+bool splice_relay::non_blocking_relay(abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  for (int i = 0; i < 2; ++i)
+    if (!transfer(paths_[i], ec))
+      return true;
+  return done();
+}
+
+void splice_relay::sync_relay(abnet::error_code &ec) {
+  while (!non_blocking_relay(ec)) {
+    // A socket with nothing to wait for is left out, as a hung up socket
+    // would otherwise wake the poll at once.
+    pollfd fds[2];
+    for (int i = 0; i < 2; ++i) {
+      fds[i].events = poll_events(paths_[i].from_);
+      fds[i].fd = fds[i].events ? paths_[i].from_ : -1;
+      fds[i].revents = 0;
+    }
+    if (::poll(fds, 2, -1) < 0 && errno != EINTR) {
+      ec = abnet::error_code(errno, abnet::error::get_system_category());
+      return;
+    }
+  }
+}
+
+short splice_relay::poll_events(socket_type s) const {
+  short events = 0;
+  for (int i = 0; i < 2; ++i) {
+    const path &p = paths_[i];
+    if (p.from_ == s && !p.eof_ && p.in_pipe_ == 0)
+      events |= POLLIN;
+    if (p.to_ == s && p.in_pipe_ > 0)
+      events |= POLLOUT;
+  }
+  return events;
+}
+
+bool splice_relay::transfer(path &p, abnet::error_code &ec) {
+  for (;;) {
+    bool progress = false;
+
+    // Fill the pipe from the source. Fails with EAGAIN both when the socket
+    // has no data and when the pipe is full.
+    if (!p.eof_) {
+      ssize_t n = ::splice(p.from_, 0, p.pipe_[1], 0, max_chunk, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (n > 0) {
+        p.in_pipe_ += n;
+        progress = true;
+      } else if (n == 0) {
+        p.eof_ = true;
+      } else if (errno != EAGAIN && errno != EINTR) {
+        ec = abnet::error_code(errno, abnet::error::get_system_category());
+        return false;
+      }
+    }
+
+    // Drain the pipe into the destination. splice cannot pass MSG_NOSIGNAL,
+    // so a destination whose peer has gone would otherwise raise SIGPIPE.
+    if (p.in_pipe_ > 0) {
+      // Capture errno before the guard's destructor makes its own calls.
+      ssize_t n;
+      int error;
+      {
+        socket_ops::sigpipe_guard guard;
+        n = ::splice(p.pipe_[0], 0, p.to_, 0, p.in_pipe_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        error = n < 0 ? errno : 0;
+      }
+      if (n > 0) {
+        p.in_pipe_ -= n;
+        p.bytes_ += n;
+        progress = true;
+      } else if (n < 0 && error != EAGAIN && error != EINTR) {
+        ec = abnet::error_code(error, abnet::error::get_system_category());
+        return false;
+      }
+    }
+
+    if (!progress)
+      break;
+  }
+
+  // Pass the half-close on once everything before it has been forwarded.
+  if (p.eof_ && p.in_pipe_ == 0 && !p.shut_down_) {
+    p.shut_down_ = true;
+    if (socket_ops::shutdown(p.to_, ABNET_OS_DEF(SHUT_WR), ec) != 0)
+      return false;
+  }
+  return true;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(__linux__)
+
+#endif // ABNET_SPLICE_RELAY_IPP
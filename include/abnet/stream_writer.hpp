@@ -0,0 +1,108 @@
+//
+// stream_writer.hpp
+// ~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_STREAM_WRITER_HPP
+#define ABNET_STREAM_WRITER_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if !defined(ABNET_WINDOWS) && !defined(__CYGWIN__)
+
+#include "abnet/error.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/socket_ops.hpp"
+#include "abnet/socket_types.hpp"
+#include <cstddef>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// Gathers small writes to a stream socket and sends them together with one
+// gathering send, rather than one send and one segment per write.
+//
+// Writes are queued until the queued bytes reach the threshold, the queue of
+// buffers is full, or flush() is called. Only flush() marks the end of the
+// data: earlier sends pass MSG_MORE (or cork the socket with TCP_CORK where
+// MSG_MORE is missing), so that the kernel holds back a partial segment until
+// the rest arrives.
+class stream_writer : private noncopyable {
+public:
+  enum { max_buffers = 64, default_threshold = 16384 };
+
+  // Constructor. state is the socket's state, which decides whether sends
+  // wait for the socket to become writable.
+  ABNET_DECL stream_writer(socket_type s, socket_ops::state_type state, std::size_t threshold = default_threshold);
+
+  // Queue data to be sent. The data is not copied and must stay valid until
+  // it has been flushed. Returns false with ec set if a flush that the write
+  // triggered failed, in which case the data has not been queued if the
+  // queue was full. With a non-blocking socket that error may be would_block.
+  ABNET_DECL bool write(const void *data, std::size_t size, abnet::error_code &ec);
+
+  // Send everything queued. Returns false with ec set on failure, leaving
+  // the data that was not sent queued.
+  ABNET_DECL bool flush(abnet::error_code &ec);
+
+  // The number of bytes waiting to be sent.
+  std::size_t queued_bytes() const { return queued_bytes_; }
+
+  // The number of buffers waiting to be sent.
+  std::size_t queued_buffers() const { return count_; }
+
+  // The number of times queued data was flushed, whether by threshold, by a
+  // full queue or explicitly.
+  std::size_t flushes() const { return flushes_; }
+
+  // The number of send calls made.
+  std::size_t sends() const { return sends_; }
+
+  // The total number of buffers flushed.
+  std::size_t buffers_flushed() const { return buffers_flushed_; }
+
+  // The average number of buffers gathered by a flush.
+  double average_buffers_per_flush() const { return flushes_ ? double(buffers_flushed_) / flushes_ : 0.0; }
+
+private:
+  // Send the queued buffers. more tells the kernel that further data follows.
+  ABNET_DECL bool send_queued(bool more, abnet::error_code &ec);
+
+  socket_type socket_;
+  socket_ops::state_type state_;
+  std::size_t threshold_;
+
+  // The queued buffers are bufs_[first_] to bufs_[first_ + count_ - 1].
+  socket_ops::buf bufs_[max_buffers];
+  std::size_t first_;
+  std::size_t count_;
+  std::size_t queued_bytes_;
+
+  // Set when the last send told the kernel that more data follows, so that
+  // it may still be holding some back.
+  bool held_;
+
+  std::size_t flushes_;
+  std::size_t sends_;
+  std::size_t buffers_flushed_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/stream_writer.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // !defined(ABNET_WINDOWS) && !defined(__CYGWIN__)
+
+#endif // ABNET_STREAM_WRITER_HPP
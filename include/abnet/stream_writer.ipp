@@ -0,0 +1,130 @@
+//
+// stream_writer.ipp
+// ~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_STREAM_WRITER_IPP
+#define ABNET_STREAM_WRITER_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if !defined(ABNET_WINDOWS) && !defined(__CYGWIN__)
+
+#include <cstring>
+
+#include "abnet/error.hpp"
+#include "abnet/stream_writer.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+namespace stream_writer_ops {
+
+#if defined(TCP_CORK) || defined(TCP_NOPUSH)
+inline void set_cork(socket_type s, bool value, abnet::error_code &ec) {
+  int optval = value ? 1 : 0;
+  socket_ops::state_type state = 0;
+#if defined(TCP_CORK)
+  socket_ops::setsockopt(s, state, IPPROTO_TCP, TCP_CORK, &optval, sizeof(optval), ec);
+#else  // defined(TCP_CORK)
+  socket_ops::setsockopt(s, state, IPPROTO_TCP, TCP_NOPUSH, &optval, sizeof(optval), ec);
+#endif // defined(TCP_CORK)
+}
+#endif // defined(TCP_CORK) || defined(TCP_NOPUSH)
+
+} // namespace stream_writer_ops
+
+stream_writer::stream_writer(socket_type s, socket_ops::state_type state, std::size_t threshold)
+    : socket_(s), state_(state), threshold_(threshold), first_(0), count_(0), queued_bytes_(0), held_(false),
+      flushes_(0), sends_(0), buffers_flushed_(0) {}
+
+bool stream_writer::write(const void *data, std::size_t size, abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  if (size == 0)
+    return true;
+
+  // Make room at the end of the queue.
+  if (first_ + count_ == max_buffers) {
+    if (count_ == max_buffers && !send_queued(true, ec))
+      return false;
+    std::memmove(bufs_, bufs_ + first_, count_ * sizeof(bufs_[0]));
+    first_ = 0;
+  }
+
+  socket_ops::init_buf(bufs_[first_ + count_], data, size);
+  ++count_;
+  queued_bytes_ += size;
+  if (queued_bytes_ >= threshold_)
+    return send_queued(true, ec);
+  return true;
+}
+
+bool stream_writer::flush(abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  if (count_ > 0)
+    return send_queued(false, ec);
+
+#if defined(TCP_CORK) || defined(TCP_NOPUSH)
+  // Nothing is left to send without MSG_MORE, but removing the cork pushes
+  // out a segment held back by an earlier send.
+  if (held_) {
+    stream_writer_ops::set_cork(socket_, false, ec);
+    held_ = false;
+  }
+#endif // defined(TCP_CORK) || defined(TCP_NOPUSH)
+  return !ec;
+}
+
+bool stream_writer::send_queued(bool more, abnet::error_code &ec) {
+  if (count_ == 0)
+    return true;
+
+  int flags = 0;
+#if defined(MSG_MORE)
+  if (more)
+    flags |= MSG_MORE;
+#elif defined(TCP_CORK) || defined(TCP_NOPUSH)
+  if (more != held_)
+    stream_writer_ops::set_cork(socket_, more, ec);
+#endif // defined(MSG_MORE)
+  held_ = more;
+
+  ++flushes_;
+  buffers_flushed_ += count_;
+  while (count_ > 0) {
+    std::size_t bytes = socket_ops::sync_send(socket_, state_, bufs_ + first_, count_, flags, false, ec);
+    ++sends_;
+    if (ec)
+      return false;
+
+    // Drop what was sent, leaving a partly sent buffer at the front.
+    queued_bytes_ -= bytes;
+    while (count_ > 0 && bytes >= bufs_[first_].iov_len) {
+      bytes -= bufs_[first_].iov_len;
+      ++first_;
+      --count_;
+    }
+    if (count_ > 0) {
+      bufs_[first_].iov_base = static_cast<char *>(bufs_[first_].iov_base) + bytes;
+      bufs_[first_].iov_len -= bytes;
+    }
+  }
+  first_ = 0;
+  return true;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // !defined(ABNET_WINDOWS) && !defined(__CYGWIN__)
+
+#endif // ABNET_STREAM_WRITER_IPP
@@ -0,0 +1,188 @@
+//
+// thread_pool.hpp
+// ~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_THREAD_POOL_HPP
+#define ABNET_THREAD_POOL_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_THREAD)
+
+#include "abnet/noncopyable.hpp"
+#include "abnet/op_queue.hpp"
+#include "abnet/work_stealing_deque.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// Base class for the operations run by thread_pool. complete() invokes the
+// handler and releases the operation, destroy() releases it unrun.
+class executor_op {
+public:
+  executor_op() : next_(0) {}
+
+  virtual void complete() = 0;
+
+  virtual void destroy() { delete this; }
+
+  // Intrusive link used by op_queue.
+  executor_op *next_;
+
+protected:
+  virtual ~executor_op() {}
+};
+
+// A fixed set of worker threads, each with its own Chase-Lev deque. Work
+// posted by a worker goes to the bottom of its own deque and is picked up
+// LIFO, keeping it cache hot; idle workers steal the oldest work from the top
+// of the others' deques. Work posted from outside the pool, or which does not
+// fit in a deque, goes through a shared injection queue. Affine work, such as
+// the handlers of a connection owned by one worker, is queued on that worker
+// alone and is never stolen.
+class thread_pool : private noncopyable {
+public:
+  // Returned by current_worker() on threads outside the pool.
+  enum { not_a_worker = ~std::size_t(0) };
+
+  // Constructor. Starts worker_count threads, or one per core when zero.
+  ABNET_DECL explicit thread_pool(std::size_t worker_count = 0);
+
+  // Destructor. Stops and joins the workers. Work which has not started is
+  // destroyed without running.
+  ABNET_DECL ~thread_pool();
+
+  // The number of worker threads.
+  std::size_t size() const { return workers_.size(); }
+
+  // Run a handler on any worker. Thread safe. Handler: void().
+  template <typename Handler> void post(Handler handler);
+
+  // Run a handler on the given worker only. Thread safe. Handler: void().
+  template <typename Handler> void post_affine(std::size_t worker, Handler handler);
+
+  // Queue an operation on any worker. Thread safe.
+  ABNET_DECL void post_op(executor_op *op);
+
+  // Queue an operation on the given worker only. Thread safe.
+  ABNET_DECL void post_affine_op(std::size_t worker, executor_op *op);
+
+  // The index of the worker running the calling thread, or not_a_worker.
+  ABNET_DECL std::size_t current_worker() const;
+
+  // Make the workers exit once they finish their current handler.
+  ABNET_DECL void stop();
+
+  // Wait for the workers to exit after stop().
+  ABNET_DECL void join();
+
+  // The number of handlers run by a worker.
+  std::size_t executed(std::size_t worker) const {
+    return workers_[worker]->executed_.load(std::memory_order_relaxed);
+  }
+
+  // The number of handlers a worker took from the deques of others.
+  std::size_t steals(std::size_t worker) const { return workers_[worker]->steals_.load(std::memory_order_relaxed); }
+
+private:
+  struct worker {
+    worker() : inbox_size_(0), sleeping_(false), executed_(0), steals_(0) {}
+
+    // Stealable work, pushed by this worker only.
+    work_stealing_deque<executor_op> deque_;
+
+    // Affine work, pushed by any thread and run by this worker only.
+    std::mutex inbox_mutex_;
+    op_queue<executor_op> inbox_;
+    std::atomic<std::size_t> inbox_size_;
+
+    // Set while the worker waits for work. Guarded by idle_mutex_ for writes.
+    std::atomic<bool> sleeping_;
+    std::condition_variable wakeup_;
+
+    // Statistics.
+    std::atomic<std::size_t> executed_;
+    std::atomic<std::size_t> steals_;
+
+    std::thread thread_;
+  };
+
+  // The thread function of a worker.
+  ABNET_DECL void run_worker(std::size_t index);
+
+  // Find the next operation for a worker to run.
+  ABNET_DECL executor_op *next_op(std::size_t index);
+
+  // Block a worker until there is work it can run.
+  ABNET_DECL void wait_for_work(std::size_t index);
+
+  // Wake one sleeping worker, if any.
+  ABNET_DECL void wake_one();
+
+  // The workers.
+  std::vector<std::unique_ptr<worker>> workers_;
+
+  // Shared work from outside the pool or spilled from full deques.
+  std::mutex injection_mutex_;
+  op_queue<executor_op> injection_queue_;
+
+  // The number of queued operations any worker may run.
+  std::atomic<std::size_t> shared_pending_;
+
+  // Guards sleeping transitions.
+  std::mutex idle_mutex_;
+
+  // Whether stop() has been called.
+  std::atomic<bool> stopped_;
+};
+
+template <typename Handler> class executor_handler_op : public executor_op {
+public:
+  explicit executor_handler_op(Handler &handler) : handler_(std::move(handler)) {}
+
+  void complete() {
+    Handler handler(std::move(handler_));
+    delete this;
+    handler();
+  }
+
+private:
+  Handler handler_;
+};
+
+template <typename Handler> void thread_pool::post(Handler handler) {
+  post_op(new executor_handler_op<Handler>(handler));
+}
+
+template <typename Handler> void thread_pool::post_affine(std::size_t worker, Handler handler) {
+  post_affine_op(worker, new executor_handler_op<Handler>(handler));
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/thread_pool.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_THREAD)
+
+#endif // ABNET_THREAD_POOL_HPP
@@ -0,0 +1,204 @@
+//
+// thread_pool.ipp
+// ~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_THREAD_POOL_IPP
+#define ABNET_THREAD_POOL_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_THREAD)
+
+#include "abnet/thread_pool.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+namespace thread_pool_ops {
+
+// The pool and worker index of the calling thread.
+struct worker_context {
+  const thread_pool *pool;
+  std::size_t index;
+};
+
+inline worker_context &current_context() {
+  static thread_local worker_context context = {0, 0};
+  return context;
+}
+
+} // namespace thread_pool_ops
+
+thread_pool::thread_pool(std::size_t worker_count) : shared_pending_(0), stopped_(false) {
+  if (worker_count == 0)
+    worker_count = std::thread::hardware_concurrency();
+  if (worker_count == 0)
+    worker_count = 1;
+
+  // Every worker must exist before any of them starts stealing.
+  for (std::size_t i = 0; i < worker_count; ++i)
+    workers_.emplace_back(new worker);
+  for (std::size_t i = 0; i < worker_count; ++i)
+    workers_[i]->thread_ = std::thread([this, i] { run_worker(i); });
+}
+
+thread_pool::~thread_pool() {
+  stop();
+  join();
+  for (std::unique_ptr<worker> &w : workers_) {
+    while (executor_op *op = w->deque_.pop())
+      op->destroy();
+    while (executor_op *op = w->inbox_.pop())
+      op->destroy();
+  }
+  while (executor_op *op = injection_queue_.pop())
+    op->destroy();
+}
+
+void thread_pool::post_op(executor_op *op) {
+  shared_pending_.fetch_add(1, std::memory_order_seq_cst);
+
+  const thread_pool_ops::worker_context &context = thread_pool_ops::current_context();
+  if (context.pool != this || !workers_[context.index]->deque_.push(op)) {
+    std::lock_guard<std::mutex> lock(injection_mutex_);
+    injection_queue_.push(op);
+  }
+
+  wake_one();
+}
+
+void thread_pool::post_affine_op(std::size_t index, executor_op *op) {
+  worker &w = *workers_[index % workers_.size()];
+  {
+    std::lock_guard<std::mutex> lock(w.inbox_mutex_);
+    w.inbox_.push(op);
+    w.inbox_size_.fetch_add(1, std::memory_order_seq_cst);
+  }
+
+  if (w.sleeping_.load(std::memory_order_seq_cst)) {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    w.wakeup_.notify_one();
+  }
+}
+
+std::size_t thread_pool::current_worker() const {
+  const thread_pool_ops::worker_context &context = thread_pool_ops::current_context();
+  return context.pool == this ? context.index : std::size_t(not_a_worker);
+}
+
+void thread_pool::stop() {
+  stopped_.store(true);
+  std::lock_guard<std::mutex> lock(idle_mutex_);
+  for (std::unique_ptr<worker> &w : workers_)
+    w->wakeup_.notify_one();
+}
+
+void thread_pool::join() {
+  for (std::unique_ptr<worker> &w : workers_)
+    if (w->thread_.joinable())
+      w->thread_.join();
+}
+
+void thread_pool::run_worker(std::size_t index) {
+  thread_pool_ops::worker_context &context = thread_pool_ops::current_context();
+  context.pool = this;
+  context.index = index;
+
+  worker &w = *workers_[index];
+  while (!stopped_.load(std::memory_order_relaxed)) {
+    if (executor_op *op = next_op(index)) {
+      op->complete();
+      w.executed_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      wait_for_work(index);
+    }
+  }
+
+  context.pool = 0;
+}
+
+executor_op *thread_pool::next_op(std::size_t index) {
+  worker &w = *workers_[index];
+
+  // Affine work first, since nobody else can run it.
+  if (w.inbox_size_.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(w.inbox_mutex_);
+    if (executor_op *op = w.inbox_.pop()) {
+      w.inbox_size_.fetch_sub(1, std::memory_order_relaxed);
+      return op;
+    }
+  }
+
+  if (executor_op *op = w.deque_.pop()) {
+    shared_pending_.fetch_sub(1, std::memory_order_relaxed);
+    return op;
+  }
+
+  if (shared_pending_.load(std::memory_order_relaxed) == 0)
+    return 0;
+
+  {
+    std::lock_guard<std::mutex> lock(injection_mutex_);
+    if (executor_op *op = injection_queue_.pop()) {
+      shared_pending_.fetch_sub(1, std::memory_order_relaxed);
+      return op;
+    }
+  }
+
+  for (std::size_t i = 1; i < workers_.size(); ++i) {
+    worker &victim = *workers_[(index + i) % workers_.size()];
+    if (executor_op *op = victim.deque_.steal()) {
+      shared_pending_.fetch_sub(1, std::memory_order_relaxed);
+      w.steals_.fetch_add(1, std::memory_order_relaxed);
+      return op;
+    }
+  }
+
+  return 0;
+}
+
+void thread_pool::wait_for_work(std::size_t index) {
+  worker &w = *workers_[index];
+  std::unique_lock<std::mutex> lock(idle_mutex_);
+  for (;;) {
+    // Publish the intent to sleep before looking for work, so a poster either
+    // sees the flag or its work is seen here.
+    w.sleeping_.store(true, std::memory_order_seq_cst);
+    if (stopped_.load() || shared_pending_.load(std::memory_order_seq_cst) > 0 ||
+        w.inbox_size_.load(std::memory_order_seq_cst) > 0)
+      break;
+    w.wakeup_.wait(lock);
+  }
+  w.sleeping_.store(false, std::memory_order_relaxed);
+}
+
+void thread_pool::wake_one() {
+  for (std::unique_ptr<worker> &w : workers_) {
+    if (w->sleeping_.load(std::memory_order_seq_cst)) {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+      if (w->sleeping_.load(std::memory_order_relaxed)) {
+        // Claim the sleeper so that concurrent posts wake different workers.
+        w->sleeping_.store(false, std::memory_order_relaxed);
+        w->wakeup_.notify_one();
+        return;
+      }
+    }
+  }
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(ABNET_HAS_THREADS) && defined(ABNET_HAS_STD_THREAD)
+
+#endif // ABNET_THREAD_POOL_IPP
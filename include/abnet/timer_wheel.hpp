@@ -0,0 +1,171 @@
+//
+// timer_wheel.hpp
+// ~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_TIMER_WHEEL_HPP
+#define ABNET_TIMER_WHEEL_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_TIMERFD)
+
+#include "abnet/error.hpp"
+#include "abnet/noncopyable.hpp"
+#include <cstddef>
+#include <cstdint>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// A timer owned by the caller, typically embedded in a per-socket structure so
+// that arming it never allocates. A timer may be scheduled on at most one wheel
+// at a time and must be cancelled before it is destroyed.
+class wheel_timer : private noncopyable {
+public:
+  // Callback invoked when the timer expires. The timer is no longer scheduled
+  // when it runs, so it may be re-armed from within the callback.
+  typedef void (*callback_type)(wheel_timer &timer, void *context);
+
+  wheel_timer() : next_(0), pprev_(0), expiry_(0), callback_(0), context_(0) {}
+
+  wheel_timer(callback_type callback, void *context)
+      : next_(0), pprev_(0), expiry_(0), callback_(callback), context_(context) {}
+
+  // Set the callback to run on expiry.
+  void set_callback(callback_type callback, void *context) {
+    callback_ = callback;
+    context_ = context;
+  }
+
+  // Whether the timer is scheduled on a wheel.
+  bool armed() const { return pprev_ != 0; }
+
+  // The tick at which the timer expires, when armed.
+  uint64_t expiry() const { return expiry_; }
+
+private:
+  friend class timer_wheel;
+
+  // Intrusive slot list links. pprev_ points at the link referring to this
+  // timer, which allows unlinking without knowing the slot.
+  wheel_timer *next_;
+  wheel_timer **pprev_;
+
+  uint64_t expiry_;
+  callback_type callback_;
+  void *context_;
+};
+
+// A hierarchical timing wheel with O(1) arm, re-arm and cancel. Four levels of
+// 256 slots cover 2^32 ticks. Timers are placed in the lowest level that spans
+// their remaining time and cascade down as the wheel turns. Expiry is driven
+// by a timerfd which ticks only while timers are armed, so the wheel can be
+// registered with a readiness loop and serviced whenever it becomes readable.
+class timer_wheel : private noncopyable {
+public:
+  // Constructor. Creates the timerfd with the given tick resolution, setting
+  // ec on failure.
+  ABNET_DECL timer_wheel(abnet::error_code &ec, unsigned tick_msec = 1);
+
+  // Destructor. Armed timers are unlinked without running their callbacks.
+  ABNET_DECL ~timer_wheel();
+
+  // Whether the timerfd was created successfully.
+  bool is_open() const { return fd_ != -1; }
+
+  // The descriptor which becomes readable when the wheel needs to turn.
+  int descriptor() const { return fd_; }
+
+  // The tick resolution in milliseconds.
+  unsigned tick_msec() const { return tick_msec_; }
+
+  // The number of armed timers.
+  std::size_t size() const { return size_; }
+
+  // The current time in ticks.
+  ABNET_DECL uint64_t now() const;
+
+  // Arm a timer to expire no sooner than msec milliseconds from now, rounded
+  // up to the next tick boundary. An armed timer is re-armed.
+  ABNET_DECL void schedule(wheel_timer &timer, uint64_t msec);
+
+  // Disarm a timer. Returns true if it was armed.
+  ABNET_DECL bool cancel(wheel_timer &timer);
+
+  // Run the callbacks of all timers which are due. Called when descriptor()
+  // is readable. Returns the number of timers expired.
+  ABNET_DECL std::size_t expire();
+
+private:
+  enum { level_bits = 8, slots_per_level = 1 << level_bits, slot_mask = slots_per_level - 1, levels = 4 };
+
+  // Turn the wheel up to and including the given tick.
+  ABNET_DECL std::size_t advance(uint64_t tick);
+
+  // Move the timers of a slot to the levels below it. Returns the slot index.
+  ABNET_DECL unsigned cascade(int level);
+
+  // Link a timer into the slot matching its expiry.
+  ABNET_DECL void place(wheel_timer &timer);
+
+  // Start or stop the periodic timerfd.
+  ABNET_DECL void set_ticking(bool ticking);
+
+  static void link(wheel_timer *&head, wheel_timer &timer) {
+    timer.next_ = head;
+    if (head)
+      head->pprev_ = &timer.next_;
+    head = &timer;
+    timer.pprev_ = &head;
+  }
+
+  static void unlink(wheel_timer &timer) {
+    *timer.pprev_ = timer.next_;
+    if (timer.next_)
+      timer.next_->pprev_ = timer.pprev_;
+    timer.next_ = 0;
+    timer.pprev_ = 0;
+  }
+
+  // The timerfd descriptor.
+  int fd_;
+
+  // Milliseconds per tick.
+  unsigned tick_msec_;
+
+  // The monotonic clock reading, in milliseconds, of tick zero.
+  uint64_t epoch_msec_;
+
+  // The last tick processed.
+  uint64_t current_;
+
+  // The number of armed timers.
+  std::size_t size_;
+
+  // Whether the timerfd is armed.
+  bool ticking_;
+
+  // The slot lists.
+  wheel_timer *slots_[levels][slots_per_level];
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/timer_wheel.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(ABNET_HAS_TIMERFD)
+
+#endif // ABNET_TIMER_WHEEL_HPP
@@ -0,0 +1,184 @@
+//
+// timer_wheel.ipp
+// ~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_TIMER_WHEEL_IPP
+#define ABNET_TIMER_WHEEL_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#if defined(ABNET_HAS_TIMERFD)
+
+#include <cerrno>
+#include <cstring>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "abnet/error.hpp"
+#include "abnet/timer_wheel.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+namespace timer_wheel_ops {
+
+inline uint64_t monotonic_msec() {
+  timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+} // namespace timer_wheel_ops
+
+timer_wheel::timer_wheel(abnet::error_code &ec, unsigned tick_msec)
+    : fd_(-1), tick_msec_(tick_msec ? tick_msec : 1), epoch_msec_(timer_wheel_ops::monotonic_msec()), current_(0),
+      size_(0), ticking_(false) {
+  std::memset(slots_, 0, sizeof(slots_));
+  fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (fd_ == -1)
+    ec = abnet::error_code(errno, abnet::error::get_system_category());
+  else
+    abnet::error::clear(ec);
+}
+
+timer_wheel::~timer_wheel() {
+  for (int level = 0; level < levels; ++level)
+    for (int i = 0; i < slots_per_level; ++i)
+      while (wheel_timer *t = slots_[level][i])
+        unlink(*t);
+  if (fd_ != -1)
+    ::close(fd_);
+}
+
+uint64_t timer_wheel::now() const { return (timer_wheel_ops::monotonic_msec() - epoch_msec_) / tick_msec_; }
+
+void timer_wheel::schedule(wheel_timer &timer, uint64_t msec) {
+  if (timer.armed()) {
+    unlink(timer);
+    --size_;
+  }
+
+  uint64_t elapsed = timer_wheel_ops::monotonic_msec() - epoch_msec_;
+  if (size_ == 0) {
+    // Nothing is pending, so there is no need to replay the idle ticks.
+    current_ = elapsed / tick_msec_;
+  }
+
+  // Expire at the first tick boundary at least msec past the unfloored time.
+  // The clock reading is itself floored to a millisecond, so allow for one
+  // more.
+  timer.expiry_ = (elapsed + msec + tick_msec_) / tick_msec_;
+  place(timer);
+  if (++size_ == 1)
+    set_ticking(true);
+}
+
+bool timer_wheel::cancel(wheel_timer &timer) {
+  if (!timer.armed())
+    return false;
+
+  unlink(timer);
+  if (--size_ == 0)
+    set_ticking(false);
+  return true;
+}
+
+std::size_t timer_wheel::expire() {
+  uint64_t expirations = 0;
+  ssize_t result = ::read(fd_, &expirations, sizeof(expirations));
+  (void)result;
+
+  std::size_t n = advance(now());
+  if (size_ == 0)
+    set_ticking(false);
+  return n;
+}
+
+std::size_t timer_wheel::advance(uint64_t tick) {
+  std::size_t n = 0;
+  while (current_ < tick) {
+    if (size_ == 0) {
+      current_ = tick;
+      break;
+    }
+
+    uint64_t c = ++current_;
+    if ((c & slot_mask) == 0) {
+      for (int level = 1; level < levels; ++level)
+        if (cascade(level) != 0)
+          break;
+    }
+
+    wheel_timer *&slot = slots_[0][c & slot_mask];
+    while (wheel_timer *t = slot) {
+      unlink(*t);
+      --size_;
+      ++n;
+      t->callback_(*t, t->context_);
+    }
+  }
+  return n;
+}
+
+unsigned timer_wheel::cascade(int level) {
+  unsigned index = static_cast<unsigned>(current_ >> (level * level_bits)) & slot_mask;
+  wheel_timer *&slot = slots_[level][index];
+  while (wheel_timer *t = slot) {
+    unlink(*t);
+    place(*t);
+  }
+  return index;
+}
+
+void timer_wheel::place(wheel_timer &timer) {
+  uint64_t delta = timer.expiry_ - current_;
+  if (timer.expiry_ < current_) {
+    delta = 0;
+    timer.expiry_ = current_;
+  }
+
+  int level = 0;
+  if (delta >= (uint64_t(1) << (levels * level_bits))) {
+    // Beyond the range of the wheel, so expire as late as it can represent.
+    timer.expiry_ = current_ + (uint64_t(1) << (levels * level_bits)) - 1;
+    level = levels - 1;
+  } else {
+    while (delta >= (uint64_t(1) << ((level + 1) * level_bits)))
+      ++level;
+  }
+
+  link(slots_[level][(timer.expiry_ >> (level * level_bits)) & slot_mask], timer);
+}
+
+void timer_wheel::set_ticking(bool ticking) {
+  if (ticking == ticking_)
+    return;
+
+  itimerspec spec;
+  std::memset(&spec, 0, sizeof(spec));
+  if (ticking) {
+    spec.it_interval.tv_sec = tick_msec_ / 1000;
+    spec.it_interval.tv_nsec = (tick_msec_ % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+  }
+  if (::timerfd_settime(fd_, 0, &spec, 0) == 0)
+    ticking_ = ticking;
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(ABNET_HAS_TIMERFD)
+
+#endif // ABNET_TIMER_WHEEL_IPP
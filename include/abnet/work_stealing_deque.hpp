@@ -0,0 +1,109 @@
+//
+// work_stealing_deque.hpp
+// ~~~~~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_WORK_STEALING_DEQUE_HPP
+#define ABNET_WORK_STEALING_DEQUE_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#include "abnet/noncopyable.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// A bounded Chase-Lev deque of pointers. The owning thread pushes and pops at
+// the bottom without contention, other threads steal from the top. The
+// capacity is fixed, so push() fails rather than reallocating and the caller
+// is expected to spill elsewhere.
+template <typename T> class work_stealing_deque : private noncopyable {
+public:
+  // Constructor. The capacity is rounded up to a power of two.
+  explicit work_stealing_deque(std::size_t capacity = 1024) : top_(0), bottom_(0), buffer_(0), mask_(0) {
+    std::size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    buffer_ = new std::atomic<T *>[size];
+    mask_ = static_cast<int64_t>(size - 1);
+  }
+
+  ~work_stealing_deque() { delete[] buffer_; }
+
+  // Push an element at the bottom. Owner only. Returns false when full.
+  bool push(T *x) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t > mask_)
+      return false;
+    buffer_[b & mask_].store(x, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Pop the most recently pushed element. Owner only.
+  T *pop() {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      // Empty.
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return 0;
+    }
+
+    T *x = buffer_[b & mask_].load(std::memory_order_relaxed);
+    if (t == b) {
+      // Last element, race the thieves for it.
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        x = 0;
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return x;
+  }
+
+  // Take the oldest element. Any thread. Returns null when empty or when the
+  // element was lost to a concurrent pop or steal.
+  T *steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b)
+      return 0;
+
+    T *x = buffer_[t & mask_].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      return 0;
+    return x;
+  }
+
+  // Whether the deque looked empty. Approximate when called concurrently.
+  bool empty() const {
+    return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<int64_t> top_;
+  std::atomic<int64_t> bottom_;
+  std::atomic<T *> *buffer_;
+  int64_t mask_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // ABNET_WORK_STEALING_DEQUE_HPP
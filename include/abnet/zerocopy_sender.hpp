@@ -0,0 +1,126 @@
+//
+// zerocopy_sender.hpp
+// ~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_ZEROCOPY_SENDER_HPP
+#define ABNET_ZEROCOPY_SENDER_HPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#include "abnet/socket_types.hpp"
+
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+
+#include "abnet/error.hpp"
+#include "abnet/noncopyable.hpp"
+#include "abnet/socket_ops.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+// Sends on a stream socket with MSG_ZEROCOPY, so that the kernel transmits
+// straight from the caller's pages. A buffer must then stay untouched until
+// the kernel reports that it is done with it on the socket's error queue.
+// Sends smaller than the threshold are copied as usual, since the page
+// pinning and the notification cost more than the copy.
+//
+// The sender must be the only user of MSG_ZEROCOPY on its socket, as the
+// kernel numbers the notifications per socket.
+class zerocopy_sender : private noncopyable {
+public:
+  // Called once for every send that transferred data, with the context passed
+  // to send(), when the sent part of the buffers may be reused. copied is set
+  // when the data was copied after all, either below the threshold or by the
+  // kernel (e.g. on loopback).
+  typedef std::function<void(void *context, bool copied)> completion_handler;
+
+  enum { default_threshold = 16384 };
+
+  // Constructor. Enables SO_ZEROCOPY on s. If the kernel does not support it,
+  // every send is copied and ec is left clear.
+  ABNET_DECL zerocopy_sender(socket_type s, completion_handler handler, std::size_t threshold,
+                             abnet::error_code &ec);
+
+  // Send some data. Returns the number of bytes sent, or socket_error_retval
+  // with ec set. Sends below the threshold complete before returning.
+  ABNET_DECL signed_size_type send(const socket_ops::buf *bufs, std::size_t count, int flags, void *context,
+                                   abnet::error_code &ec);
+
+  // Send some data, waiting for the socket to become writable if needed.
+  ABNET_DECL std::size_t sync_send(socket_ops::state_type state, const socket_ops::buf *bufs, std::size_t count,
+                                   int flags, void *context, abnet::error_code &ec);
+
+  // Read the notifications queued on the error queue without blocking and
+  // call the handler for every completed send. Returns the number of sends
+  // completed.
+  ABNET_DECL std::size_t poll_completions(abnet::error_code &ec);
+
+  // Block until every zero-copy send has completed.
+  ABNET_DECL std::size_t sync_flush(abnet::error_code &ec);
+
+  // The socket being sent on.
+  socket_type descriptor() const { return socket_; }
+
+  // Whether the kernel accepted SO_ZEROCOPY.
+  bool enabled() const { return enabled_; }
+
+  // The number of zero-copy sends that have not completed yet.
+  std::size_t pending() const { return pending_.size(); }
+
+  // The number of sends made with MSG_ZEROCOPY.
+  std::size_t zerocopy_sends() const { return zerocopy_sends_; }
+
+  // The number of sends copied because they were below the threshold, the
+  // socket did not support zero-copy, or the kernel ran out of option memory.
+  std::size_t copied_sends() const { return copied_sends_; }
+
+  // The number of zero-copy sends the kernel ended up copying.
+  std::size_t kernel_copied() const { return kernel_copied_; }
+
+private:
+  struct pending_send {
+    std::uint32_t id;
+    void *context;
+  };
+
+  // Complete the pending sends with ids in [first, last].
+  ABNET_DECL std::size_t complete(std::uint32_t first, std::uint32_t last, bool copied);
+
+  socket_type socket_;
+  completion_handler handler_;
+  std::size_t threshold_;
+  bool enabled_;
+
+  // The notification id the kernel assigns to the next zero-copy send.
+  std::uint32_t next_id_;
+
+  std::deque<pending_send> pending_;
+  std::size_t zerocopy_sends_;
+  std::size_t copied_sends_;
+  std::size_t kernel_copied_;
+};
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#if defined(ABNET_HEADER_ONLY)
+#include "abnet/zerocopy_sender.ipp"
+#endif // defined(ABNET_HEADER_ONLY)
+
+#endif // defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+
+#endif // ABNET_ZEROCOPY_SENDER_HPP
@@ -0,0 +1,175 @@
+//
+// zerocopy_sender.ipp
+// ~~~~~~~~~~~~~~~~~~~
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#ifndef ABNET_ZEROCOPY_SENDER_IPP
+#define ABNET_ZEROCOPY_SENDER_IPP
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1200)
+#pragma once
+#endif // defined(_MSC_VER) && (_MSC_VER >= 1200)
+
+#include "abnet/config.hpp"
+
+#include "abnet/socket_types.hpp"
+
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+
+#include <cerrno>
+#include <cstring>
+#include <linux/errqueue.h>
+
+#include "abnet/error.hpp"
+#include "abnet/zerocopy_sender.hpp"
+
+#include "abnet/push_options.hpp"
+
+namespace abnet {
+
+zerocopy_sender::zerocopy_sender(socket_type s, completion_handler handler, std::size_t threshold,
+                                 abnet::error_code &ec)
+    : socket_(s), handler_(handler), threshold_(threshold), enabled_(false), next_id_(0), zerocopy_sends_(0),
+      copied_sends_(0), kernel_copied_(0) {
+  int one = 1;
+  socket_ops::state_type state = 0;
+  if (socket_ops::setsockopt(s, state, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one), ec) == 0)
+    enabled_ = true;
+  else if (ec == abnet::error::no_protocol_option || ec == abnet::error::operation_not_supported)
+    abnet::error::clear(ec);
+}
+
+signed_size_type zerocopy_sender::send(const socket_ops::buf *bufs, std::size_t count, int flags, void *context,
+                                       abnet::error_code &ec) {
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < count; ++i)
+    total += bufs[i].iov_len;
+
+  if (enabled_ && total >= threshold_) {
+    signed_size_type bytes = socket_ops::send(socket_, bufs, count, flags | MSG_ZEROCOPY, ec);
+    if (bytes > 0) {
+      pending_.push_back(pending_send{next_id_++, context});
+      ++zerocopy_sends_;
+      return bytes;
+    }
+
+    // Pinned pages are charged to the socket's option memory. When it runs
+    // out, copy until notifications have released some.
+    if (bytes == 0 || ec != abnet::error::no_buffer_space)
+      return bytes;
+  }
+
+  signed_size_type bytes = socket_ops::send(socket_, bufs, count, flags, ec);
+  if (bytes > 0) {
+    ++copied_sends_;
+    handler_(context, true);
+  }
+  return bytes;
+}
+
+std::size_t zerocopy_sender::sync_send(socket_ops::state_type state, const socket_ops::buf *bufs, std::size_t count,
+                                       int flags, void *context, abnet::error_code &ec) {
+  if (socket_ == invalid_socket) {
+    ec = abnet::error::bad_descriptor;
+    return 0;
+  }
+
+  // Write some data.
+  for (;;) {
+    // Try to complete the operation without blocking.
+    signed_size_type bytes = send(bufs, count, flags, context, ec);
+
+    // Check if operation succeeded.
+    if (bytes >= 0)
+      return bytes;
+
+    // Operation failed.
+    if ((state & socket_ops::user_set_non_blocking) ||
+        (ec != abnet::error::would_block && ec != abnet::error::try_again))
+      return 0;
+
+    // Wait for socket to become ready.
+    if (socket_ops::poll_write(socket_, 0, -1, ec) < 0)
+      return 0;
+  }
+}
+
+std::size_t zerocopy_sender::poll_completions(abnet::error_code &ec) {
+  abnet::error::clear(ec);
+  std::size_t completed = 0;
+  for (;;) {
+    union {
+      cmsghdr align;
+      char data[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))];
+    } control;
+    msghdr msg = msghdr();
+    msg.msg_control = control.data;
+    msg.msg_controllen = sizeof(control.data);
+    if (::recvmsg(socket_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        ec = abnet::error_code(errno, abnet::error::get_system_category());
+      return completed;
+    }
+
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+          !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+        continue;
+
+      sock_extended_err err;
+      std::memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+      if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+
+      // A notification covers the inclusive id range [ee_info, ee_data].
+      completed += complete(err.ee_info, err.ee_data, (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0);
+    }
+  }
+}
+
+std::size_t zerocopy_sender::sync_flush(abnet::error_code &ec) {
+  std::size_t completed = 0;
+  abnet::error::clear(ec);
+  while (!pending_.empty()) {
+    completed += poll_completions(ec);
+    if (ec || pending_.empty())
+      break;
+
+    // Notifications make the error queue readable, which poll reports as POLLERR.
+    if (socket_ops::poll_error(socket_, 0, -1, ec) < 0)
+      break;
+  }
+  return completed;
+}
+
+std::size_t zerocopy_sender::complete(std::uint32_t first, std::uint32_t last, bool copied) {
+  std::size_t completed = 0;
+  for (;;) {
+    // Notifications normally arrive in order, so the match is at the front.
+    std::deque<pending_send>::iterator it = pending_.begin();
+    while (it != pending_.end() && std::uint32_t(it->id - first) > std::uint32_t(last - first))
+      ++it;
+    if (it == pending_.end())
+      return completed;
+
+    void *context = it->context;
+    pending_.erase(it);
+    ++completed;
+    if (copied)
+      ++kernel_copied_;
+    handler_(context, copied);
+  }
+}
+
+} // namespace abnet
+
+#include "abnet/pop_options.hpp"
+
+#endif // defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+
+#endif // ABNET_ZEROCOPY_SENDER_IPP
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/buffer_chain.hpp"
+#include "test_util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static std::string to_string(const abnet::buffer_chain &chain) {
+  std::string s(chain.size(), '\0');
+  chain.copy_to(&s[0], s.size());
+  return s;
+}
+
+TEST(BufferChainT, shares_blocks_on_copy_and_split) {
+  abnet::error_code ec;
+  abnet::buffer_pool pool;
+  abnet::buffer_chain chain(&pool);
+  chain.append("hello ", 6, ec);
+  chain.append("world", 5, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("append failed with error: ") << ec.message();
+  ASSERT_EQ(chain.slice_count(), 1u);
+  ASSERT_EQ(to_string(chain), "hello world");
+
+  // A shared block is not written to, so the appends go to a new block.
+  abnet::buffer_chain copy(chain);
+  chain.append("!", 1, ec);
+  ASSERT_EQ(chain.slice_count(), 2u);
+  ASSERT_EQ(to_string(copy), "hello world");
+  ASSERT_EQ(to_string(chain), "hello world!");
+
+  abnet::buffer_chain head = chain.split(4);
+  ASSERT_EQ(to_string(head), "hell");
+  ASSERT_EQ(to_string(chain), "o world!");
+  ASSERT_EQ(head.size() + chain.size(), 12u);
+  ASSERT_EQ(pool.in_use(abnet::buffer_pool::small_buffer), 2u);
+
+  // The blocks go back to the pool once the last slice goes.
+  copy.clear();
+  head.clear();
+  chain.consume(chain.size());
+  ASSERT_TRUE(chain.empty());
+  ASSERT_EQ(pool.in_use(abnet::buffer_pool::small_buffer), 0u);
+}
+
+TEST(BufferChainT, contiguous_copies_only_across_slices) {
+  abnet::error_code ec;
+  abnet::buffer_chain a;
+  abnet::buffer_chain b;
+  a.append("abc", 3, ec);
+  b.append("defgh", 5, ec);
+  a.append(b);
+  ASSERT_EQ(a.slice_count(), 2u);
+
+  const char *p = a.contiguous(2, ec);
+  ASSERT_EQ(std::string(p, 2), "ab");
+  ASSERT_EQ(a.coalesces(), 0u);
+
+  p = a.contiguous(6, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("contiguous failed with error: ") << ec.message();
+  ASSERT_EQ(std::string(p, 6), "abcdef");
+  ASSERT_EQ(a.coalesces(), 1u);
+  ASSERT_EQ(to_string(a), "abcdefgh");
+  ASSERT_EQ(to_string(b), "defgh");
+
+  ASSERT_EQ(a.contiguous(9, ec), nullptr);
+  ASSERT_EQ(ec, abnet::error::invalid_argument);
+}
+
+TEST(BufferChainT, receives_and_sends_without_copies) {
+  abnet::error_code ec;
+  abnet::buffer_pool pool;
+  abnet::socket_type pair[2];
+  abnet::socket_ops::socketpair(AF_UNIX, SOCK_STREAM, 0, pair, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("socketpair failed with error: ") << ec.message();
+
+  // A message arriving over several receives stays in the chain.
+  std::string message(10000, 'm');
+  for (size_t i = 0; i < message.size(); ++i)
+    message[i] = char('a' + i % 26);
+  abnet::buffer_chain in(&pool);
+  for (size_t off = 0; off < message.size(); off += 3000) {
+    size_t n = std::min<size_t>(3000, message.size() - off);
+    abnet::socket_ops::sync_send1(pair[0], 0, message.data() + off, n, 0, ec);
+    while (in.size() < off + n) {
+      abnet::socket_ops::buf b = in.prepare(1024, ec);
+      ASSERT_EQ(ec.value(), 0) << ERRMSG("prepare failed with error: ") << ec.message();
+      in.commit(abnet::socket_ops::sync_recv(pair[1], abnet::socket_ops::stream_oriented, &b, 1, 0, false, ec));
+    }
+  }
+  ASSERT_EQ(to_string(in), message);
+  ASSERT_GT(in.slice_count(), 1u);
+
+  // Send it back as a gathered send straight from the slices.
+  abnet::socket_ops::buf bufs[16];
+  size_t count = in.to_bufs(bufs, 16);
+  ASSERT_EQ(count, in.slice_count());
+  abnet::socket_ops::buffer_sequence seq(bufs, count);
+  abnet::socket_ops::sync_send(pair[1], 0, seq, 0, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("send failed with error: ") << ec.message();
+  std::string echoed(message.size(), '\0');
+  for (size_t n = 0; n < echoed.size();)
+    n += abnet::socket_ops::sync_recv1(pair[0], abnet::socket_ops::stream_oriented, &echoed[n], echoed.size() - n,
+                                       0, ec);
+  ASSERT_EQ(echoed, message);
+
+  abnet::socket_ops::close(pair[0], 0, false, ec);
+  abnet::socket_ops::close(pair[1], 0, false, ec);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
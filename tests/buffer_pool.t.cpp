@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/buffer_pool.hpp"
+#include "test_util.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+TEST(BufferPoolT, size_classes) {
+  abnet::error_code ec;
+  ASSERT_EQ(abnet::buffer_pool::class_of(1, ec), abnet::buffer_pool::small_buffer);
+  ASSERT_EQ(abnet::buffer_pool::class_of(4096, ec), abnet::buffer_pool::small_buffer);
+  ASSERT_EQ(abnet::buffer_pool::class_of(4097, ec), abnet::buffer_pool::medium_buffer);
+  ASSERT_EQ(abnet::buffer_pool::class_of(65536, ec), abnet::buffer_pool::large_buffer);
+  ASSERT_EQ(ec.value(), 0);
+  abnet::buffer_pool::class_of(65537, ec);
+  ASSERT_EQ(ec, abnet::error::invalid_argument);
+  ASSERT_EQ(abnet::buffer_pool::class_size(abnet::buffer_pool::medium_buffer), 16384u);
+}
+
+TEST(BufferPoolT, reuses_buffers_and_tracks_high_water) {
+  abnet::error_code ec;
+  abnet::buffer_pool pool;
+  std::vector<void *> bufs;
+  for (int i = 0; i < 10; ++i) {
+    bufs.push_back(pool.allocate(16384, ec));
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("allocate failed with error: ") << ec.message();
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(bufs.back()) % 4096, 0u);
+  }
+  ASSERT_EQ(pool.in_use(abnet::buffer_pool::medium_buffer), 10u);
+  ASSERT_EQ(pool.buffers_created(abnet::buffer_pool::medium_buffer), 16u);
+
+  void *last = bufs.back();
+  for (void *p : bufs)
+    pool.deallocate(p, 16384);
+  ASSERT_EQ(pool.in_use(abnet::buffer_pool::medium_buffer), 0u);
+  ASSERT_EQ(pool.high_water(abnet::buffer_pool::medium_buffer), 10u);
+
+  // The most recently released buffer comes back first.
+  ASSERT_EQ(pool.allocate(10000, ec), last);
+  pool.deallocate(last, 10000);
+  ASSERT_EQ(pool.buffers_created(abnet::buffer_pool::medium_buffer), 16u);
+  ASSERT_EQ(pool.allocate(100000, ec), nullptr);
+  ASSERT_EQ(ec, abnet::error::invalid_argument);
+}
+
+TEST(BufferPoolT, buffers_plug_into_init_buf) {
+  abnet::error_code ec;
+  abnet::buffer_pool pool;
+  abnet::socket_type pair[2];
+  abnet::socket_ops::socketpair(AF_UNIX, SOCK_STREAM, 0, pair, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("socketpair failed with error: ") << ec.message();
+
+  char *out = static_cast<char *>(pool.allocate(4096, ec));
+  char *in = static_cast<char *>(pool.allocate(4096, ec));
+  std::memset(out, 'x', 4096);
+  abnet::socket_ops::buf b;
+  abnet::socket_ops::init_buf(b, out, 4096);
+  ASSERT_EQ(abnet::socket_ops::sync_send(pair[0], 0, &b, 1, 0, false, ec), 4096u);
+  size_t n = 0;
+  while (n < 4096 && !ec) {
+    abnet::socket_ops::init_buf(b, in + n, 4096 - n);
+    n += abnet::socket_ops::sync_recv(pair[1], abnet::socket_ops::stream_oriented, &b, 1, 0, false, ec);
+  }
+  ASSERT_EQ(std::memcmp(in, out, 4096), 0);
+  pool.deallocate(out, 4096);
+  pool.deallocate(in, 4096);
+  abnet::socket_ops::close(pair[0], 0, false, ec);
+  abnet::socket_ops::close(pair[1], 0, false, ec);
+}
+
+TEST(BufferPoolT, poisoning_catches_writes_after_release) {
+  abnet::error_code ec;
+  abnet::buffer_pool pool(abnet::buffer_pool::default_thread_cache, true);
+  char *p = static_cast<char *>(pool.allocate(4096, ec));
+  p[0] = 'a';
+  pool.deallocate(p, 4096);
+  ASSERT_EQ(static_cast<unsigned char>(p[100]), unsigned(abnet::buffer_pool::poison_byte));
+  ASSERT_EQ(pool.allocate(4096, ec), p);
+  ASSERT_EQ(pool.poison_faults(), 0u);
+  pool.deallocate(p, 4096);
+
+  // A stale write is reported when the buffer is handed out again.
+  p[10] = 'b';
+  ASSERT_EQ(pool.allocate(4096, ec), p);
+  ASSERT_EQ(pool.poison_faults(), 1u);
+  pool.deallocate(p, 4096);
+}
+
+TEST(BufferPoolT, threads_share_one_pool) {
+  const size_t thread_count = 4;
+  const size_t rounds = 20000;
+  abnet::buffer_pool pool(8);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < thread_count; ++t) {
+    threads.emplace_back([&pool, t] {
+      abnet::error_code ec;
+      std::vector<std::pair<void *, size_t>> held;
+      for (size_t i = 0; i < rounds; ++i) {
+        size_t size = size_t(1024) << ((i + t) % 7);
+        void *p = pool.allocate(size, ec);
+        ASSERT_EQ(ec.value(), 0) << ERRMSG("allocate failed with error: ") << ec.message();
+        std::memset(p, int(t), size);
+        held.emplace_back(p, size);
+        if (held.size() > 16) {
+          pool.deallocate(held.front().first, held.front().second);
+          held.erase(held.begin());
+        }
+      }
+      for (auto &h : held)
+        pool.deallocate(h.first, h.second);
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+
+  // Every thread held at most 17 buffers, so the slabs stay few.
+  for (int c = 0; c < abnet::buffer_pool::size_class_count; ++c) {
+    abnet::buffer_pool::size_class sc = abnet::buffer_pool::size_class(c);
+    ASSERT_EQ(pool.in_use(sc), 0u);
+    ASSERT_LE(pool.high_water(sc), thread_count * 17);
+    ASSERT_LE(pool.buffers_created(sc), thread_count * (17 + 8) + abnet::buffer_pool::slab_size / pool.class_size(sc));
+  }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "test_util.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(BufferSequenceT, consume_resumes_inside_a_buffer) {
+  char data[] = "abcdefghij";
+  abnet::socket_ops::buf bufs[4];
+  abnet::socket_ops::init_buf(bufs[0], data, 3);
+  abnet::socket_ops::init_buf(bufs[1], data + 3, 0);
+  abnet::socket_ops::init_buf(bufs[2], data + 3, 4);
+  abnet::socket_ops::init_buf(bufs[3], data + 7, 3);
+  abnet::socket_ops::buffer_sequence seq(bufs, 4);
+  ASSERT_EQ(seq.size(), 10u);
+  ASSERT_EQ(seq.count(), 4u);
+
+  // Crossing the end of the first buffer skips the empty one as well.
+  seq.consume(5);
+  ASSERT_EQ(seq.size(), 5u);
+  ASSERT_EQ(seq.count(), 2u);
+  ASSERT_EQ(seq.data()->iov_base, data + 5);
+  ASSERT_EQ(seq.data()->iov_len, 2u);
+
+  seq.consume(5);
+  ASSERT_TRUE(seq.empty());
+  ASSERT_EQ(seq.size(), 0u);
+}
+
+TEST(BufferSequenceT, send_splits_long_sequences) {
+  const size_t buffer_count = 3 * abnet::max_iov_len + 7;
+  abnet::error_code ec;
+  abnet::socket_type sv[2];
+  abnet::socket_ops::socketpair(AF_UNIX, SOCK_STREAM, 0, sv, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("socketpair failed with error: ") << ec.message();
+
+  std::string expected;
+  std::vector<std::string> parts(buffer_count);
+  std::vector<abnet::socket_ops::buf> bufs(buffer_count);
+  for (size_t i = 0; i < buffer_count; ++i) {
+    parts[i].assign(i % 97, char('a' + i % 26));
+    abnet::socket_ops::init_buf(bufs[i], parts[i].data(), parts[i].size());
+    expected += parts[i];
+  }
+  abnet::socket_ops::buffer_sequence seq(bufs.data(), bufs.size());
+  ASSERT_EQ(seq.count(), size_t(abnet::max_iov_len));
+  ASSERT_EQ(seq.size(), expected.size());
+
+  // Nobody reads yet, so the non-blocking send stops part way.
+  int buffer_size = 16384;
+  abnet::socket_ops::setsockopt(sv[0], 0, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size), ec);
+  abnet::socket_ops::state_type state = abnet::socket_ops::stream_oriented;
+  abnet::socket_ops::set_user_non_blocking(sv[0], state, true, ec);
+  size_t sent = 0;
+  ASSERT_FALSE(abnet::socket_ops::non_blocking_send(sv[0], seq, 0, ec, sent));
+  ASSERT_GT(sent, 0u);
+  ASSERT_EQ(seq.size(), expected.size() - sent);
+
+  std::string received(expected.size(), '\0');
+  std::thread reader([&] {
+    abnet::error_code rec;
+    for (size_t n = 0; n < received.size() && !rec;)
+      n += abnet::socket_ops::sync_recv1(sv[1], abnet::socket_ops::stream_oriented, &received[n],
+                                         received.size() - n, 0, rec);
+  });
+  abnet::socket_ops::set_user_non_blocking(sv[0], state, false, ec);
+  size_t rest = abnet::socket_ops::sync_send(sv[0], state, seq, 0, ec);
+  reader.join();
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_send failed with error: ") << ec.message();
+  ASSERT_EQ(sent + rest, expected.size());
+  ASSERT_TRUE(seq.empty());
+  ASSERT_EQ(received, expected);
+
+  abnet::socket_ops::close(sv[0], 0, false, ec);
+  abnet::socket_ops::close(sv[1], 0, false, ec);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
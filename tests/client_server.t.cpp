@@ -3,8 +3,12 @@
 #include "abnet/abnet.hpp"
 #include "test_util.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 class ClientServerT : public ::testing::Test {
 public:
@@ -129,6 +133,144 @@ TEST_F(ClientServerT, client_server) {
   client_thread.join();
 }
 
+TEST_F(ClientServerT, sync_ops_honour_deadline) {
+  using clock = std::chrono::steady_clock;
+  const std::chrono::milliseconds budget(50);
+  abnet::error_code ec;
+  abnet::socket_ops::listen(serv_sock, 5, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("listen failed with error: ") << ec.message();
+
+  // Nobody connects, so the accept gives up once the budget is spent.
+  clock::time_point start = clock::now();
+  abnet::socket_type sock = abnet::socket_ops::sync_accept(serv_sock, 0, nullptr, nullptr, start + budget, ec);
+  ASSERT_EQ(sock, abnet::invalid_socket);
+  ASSERT_EQ(ec, abnet::error::timed_out);
+  ASSERT_GE(clock::now() - start, budget);
+
+  abnet::socket_ops::sync_connect(client_sock, &s_storage, sizeof(abnet::sockaddr_in4_type), clock::now() + budget,
+                                  ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_connect failed with error: ") << ec.message();
+  sock = abnet::socket_ops::sync_accept(serv_sock, 0, nullptr, nullptr, clock::now() + budget, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_accept failed with error: ") << ec.message();
+
+  // The peer sends nothing, and the sockets are blocking.
+  char data[4096] = {0};
+  abnet::socket_ops::buf buf;
+  abnet::socket_ops::init_buf(buf, data, sizeof(data));
+  abnet::socket_ops::state_type state = abnet::socket_ops::stream_oriented;
+  start = clock::now();
+  ASSERT_EQ(abnet::socket_ops::sync_recv(sock, state, &buf, 1, 0, false, start + budget, ec), 0u);
+  ASSERT_EQ(ec, abnet::error::timed_out);
+  ASSERT_GE(clock::now() - start, budget);
+
+  // The peer reads nothing, so the send eventually fills both buffers.
+  clock::time_point deadline = clock::now() + budget;
+  size_t sent = 0;
+  for (;;) {
+    size_t n = abnet::socket_ops::sync_send(client_sock, state, &buf, 1, 0, false, deadline, ec);
+    if (ec)
+      break;
+    sent += n;
+  }
+  ASSERT_EQ(ec, abnet::error::timed_out);
+  ASSERT_GT(sent, 0u);
+
+  // Data already queued is returned even after the deadline has passed.
+  ASSERT_GT(abnet::socket_ops::sync_recv(sock, state, &buf, 1, 0, false, deadline, ec), 0u);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_recv failed with error: ") << ec.message();
+  abnet::socket_ops::close(sock, 0, false, ec);
+}
+
+TEST_F(ClientServerT, send_file_tracks_offset) {
+  const size_t file_size = 1024 * 1024;
+  const off_t start = 1000;
+  abnet::error_code ec;
+  abnet::socket_ops::listen(serv_sock, 5, ec);
+  abnet::socket_ops::connect(client_sock, &s_storage, sizeof(abnet::sockaddr_in4_type), ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("connect failed with error: ") << ec.message();
+  abnet::socket_type sock = abnet::socket_ops::accept(serv_sock, nullptr, nullptr, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("accept failed with error: ") << ec.message();
+
+  std::vector<char> contents(file_size);
+  for (size_t i = 0; i < contents.size(); ++i)
+    contents[i] = char(i * 13);
+  FILE *file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  ASSERT_EQ(std::fwrite(contents.data(), 1, contents.size(), file), contents.size());
+  std::fflush(file);
+
+  // Nobody reads yet, so a non-blocking transfer stops once the socket
+  // buffers are full, with the offset just past what was sent.
+  int buffer_size = 65536;
+  abnet::socket_ops::setsockopt(client_sock, 0, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size), ec);
+  abnet::socket_ops::setsockopt(sock, 0, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size), ec);
+  abnet::socket_ops::state_type state = abnet::socket_ops::stream_oriented;
+  abnet::socket_ops::set_user_non_blocking(client_sock, state, true, ec);
+  off_t offset = start;
+  size_t sent = 0;
+  while (offset < off_t(file_size)) {
+    size_t n = 0;
+    if (!abnet::socket_ops::non_blocking_send_file(client_sock, fileno(file), offset, file_size - offset, ec, n))
+      break;
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("non_blocking_send_file failed with error: ") << ec.message();
+    sent += n;
+  }
+  ASSERT_GT(sent, 0u);
+  ASSERT_LT(offset, off_t(file_size));
+  ASSERT_EQ(offset, start + off_t(sent));
+
+  std::vector<char> in(file_size - start);
+  std::thread reader([&] {
+    abnet::error_code rec;
+    for (size_t n = 0; n < in.size() && !rec;)
+      n += abnet::socket_ops::sync_recv1(sock, abnet::socket_ops::stream_oriented, in.data() + n, in.size() - n, 0,
+                                         rec);
+  });
+
+  // Resume from the updated offset.
+  abnet::socket_ops::set_user_non_blocking(client_sock, state, false, ec);
+  while (offset < off_t(file_size) && !ec)
+    abnet::socket_ops::sync_send_file(client_sock, state, fileno(file), offset, file_size - offset, ec);
+  reader.join();
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_send_file failed with error: ") << ec.message();
+  ASSERT_EQ(offset, off_t(file_size));
+  ASSERT_TRUE(std::equal(in.begin(), in.end(), contents.begin() + start));
+
+  // Nothing is left past the end of the file.
+  ASSERT_EQ(abnet::socket_ops::sync_send_file(client_sock, 0, fileno(file), offset, 1, ec), 0u);
+  ASSERT_EQ(ec, abnet::error::eof);
+
+  std::fclose(file);
+  abnet::socket_ops::close(sock, 0, false, ec);
+}
+
+TEST_F(ClientServerT, send_file_to_closed_peer_fails_without_sigpipe) {
+  abnet::error_code ec;
+  abnet::socket_type pair[2];
+  abnet::socket_ops::socketpair(AF_UNIX, SOCK_STREAM, 0, pair, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("socketpair failed with error: ") << ec.message();
+  abnet::socket_ops::close(pair[1], 0, false, ec);
+
+  char contents[4096] = {0};
+  FILE *file = std::tmpfile();
+  ASSERT_NE(file, nullptr);
+  ASSERT_EQ(std::fwrite(contents, 1, sizeof(contents), file), sizeof(contents));
+  std::fflush(file);
+
+  // SIGPIPE keeps its default action, so raising it would end the test.
+  off_t offset = 0;
+  abnet::socket_ops::sync_send_file(pair[0], 0, fileno(file), offset, sizeof(contents), ec);
+  ASSERT_EQ(ec, abnet::error::broken_pipe);
+  ASSERT_EQ(offset, 0);
+
+  sigset_t pending;
+  ASSERT_EQ(::sigpending(&pending), 0);
+  ASSERT_EQ(sigismember(&pending, SIGPIPE), 0);
+
+  std::fclose(file);
+  abnet::socket_ops::close(pair[0], 0, false, ec);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
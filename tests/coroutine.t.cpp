@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/coroutine.hpp"
+#include "abnet/epoll_reactor.hpp"
+#include "test_util.hpp"
+
+#include <cstring>
+#include <vector>
+
+#if defined(ABNET_HAS_CO_AWAIT) && defined(ABNET_HAS_STD_COROUTINE)
+
+class CoroutineT : public ::testing::Test {
+public:
+  void SetUp() override {
+    abnet::error_code ec;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    abnet::socket_ops::inet_pton(ABNET_OS_DEF(AF_INET), "127.0.0.1", &sa.sin_addr, 0, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("inet_pton failed with error: ") << ec.message();
+
+    serv_sock = abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("socket failed with error: ") << ec.message();
+    abnet::socket_ops::bind(serv_sock, &sa, sizeof(sa), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("bind failed with error: ") << ec.message();
+    abnet::socket_ops::listen(serv_sock, SOMAXCONN, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("listen failed with error: ") << ec.message();
+    size_t len = sizeof(sa);
+    abnet::socket_ops::getsockname(serv_sock, &sa, &len, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("getsockname failed with error: ") << ec.message();
+  }
+
+  void TearDown() override {
+    abnet::error_code ec;
+    if (serv_sock != abnet::invalid_socket)
+      abnet::socket_ops::close(serv_sock, 0, 0, ec);
+  }
+
+protected:
+  abnet::sockaddr_in4_type sa;
+  abnet::socket_type serv_sock = abnet::invalid_socket;
+};
+
+struct coro_stats {
+  size_t sessions = 0;
+  size_t echoed = 0;
+  size_t errors = 0;
+};
+
+static abnet::coro_task echo_session(abnet::epoll_reactor &reactor, abnet::socket_type s, coro_stats &stats) {
+  abnet::error_code ec;
+  abnet::socket_ops::state_type state = abnet::socket_ops::stream_oriented;
+  abnet::epoll_reactor::per_descriptor_data data = nullptr;
+  reactor.register_descriptor(s, state, data, ec);
+  char buf_data[64];
+  for (;;) {
+    abnet::socket_ops::buf buf;
+    abnet::socket_ops::init_buf(buf, buf_data, sizeof(buf_data));
+    abnet::io_result r = co_await abnet::async_recv(reactor, data, &buf, 1, 0, true);
+    if (r.ec)
+      break;
+    abnet::socket_ops::init_buf(buf, buf_data, r.bytes_transferred);
+    r = co_await abnet::async_send(reactor, data, &buf, 1, 0);
+    if (r.ec) {
+      ++stats.errors;
+      break;
+    }
+  }
+  ++stats.sessions;
+  reactor.deregister_descriptor(s, data);
+  abnet::socket_ops::close(s, state, false, ec);
+}
+
+static abnet::coro_task acceptor(abnet::epoll_reactor &reactor, abnet::socket_type serv_sock, size_t count,
+                                 coro_stats &stats) {
+  abnet::error_code ec;
+  abnet::socket_ops::state_type state = 0;
+  abnet::epoll_reactor::per_descriptor_data data = nullptr;
+  reactor.register_descriptor(serv_sock, state, data, ec);
+  for (size_t i = 0; i < count; ++i) {
+    abnet::accept_result r = co_await abnet::async_accept(reactor, data, state, nullptr, nullptr);
+    if (r.ec) {
+      ++stats.errors;
+      break;
+    }
+    echo_session(reactor, r.new_socket, stats);
+  }
+  reactor.deregister_descriptor(serv_sock, data);
+}
+
+static abnet::coro_task client(abnet::epoll_reactor &reactor, const abnet::sockaddr_in4_type &sa, coro_stats &stats) {
+  abnet::error_code ec;
+  abnet::socket_type s = abnet::socket_ops::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP, ec);
+  abnet::socket_ops::state_type state = abnet::socket_ops::stream_oriented;
+  abnet::epoll_reactor::per_descriptor_data data = nullptr;
+  reactor.register_descriptor(s, state, data, ec);
+
+  ec = co_await abnet::async_connect(reactor, data, &sa, sizeof(sa));
+  char msg[5] = "ping";
+  char reply[5] = {0};
+  abnet::socket_ops::buf buf;
+  abnet::socket_ops::init_buf(buf, msg, sizeof(msg));
+  abnet::io_result r = {ec, 0};
+  if (!ec)
+    r = co_await abnet::async_send(reactor, data, &buf, 1, 0);
+  size_t received = 0;
+  while (!r.ec && received < sizeof(reply)) {
+    abnet::socket_ops::init_buf(buf, reply + received, sizeof(reply) - received);
+    r = co_await abnet::async_recv(reactor, data, &buf, 1, 0, true);
+    received += r.bytes_transferred;
+  }
+  if (r.ec || std::strcmp(reply, "ping") != 0)
+    ++stats.errors;
+  else
+    ++stats.echoed;
+  reactor.deregister_descriptor(s, data);
+  abnet::socket_ops::close(s, state, false, ec);
+}
+
+TEST_F(CoroutineT, echo_with_pooled_frames) {
+  const size_t conn_count = 16;
+  abnet::error_code ec;
+  abnet::epoll_reactor reactor(ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("epoll_reactor failed with error: ") << ec.message();
+
+  for (int pass = 0; pass < 2; ++pass) {
+    coro_stats stats;
+    size_t misses = abnet::coro_frame_pool::misses();
+    acceptor(reactor, serv_sock, conn_count, stats);
+    for (size_t i = 0; i < conn_count; ++i)
+      client(reactor, sa, stats);
+    reactor.run(ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("run failed with error: ") << ec.message();
+    ASSERT_EQ(stats.errors, 0u);
+    ASSERT_EQ(stats.echoed, conn_count);
+    ASSERT_EQ(stats.sessions, conn_count);
+
+    // The second pass runs entirely on frames recycled from the first.
+    if (pass == 1) {
+      ASSERT_EQ(abnet::coro_frame_pool::misses(), misses);
+    }
+  }
+  ASSERT_GT(abnet::coro_frame_pool::hits(), 0u);
+}
+
+#endif // defined(ABNET_HAS_CO_AWAIT) && defined(ABNET_HAS_STD_COROUTINE)
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
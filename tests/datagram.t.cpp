@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "test_util.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+class DatagramT : public ::testing::Test {
+public:
+  enum { msg_count = 16 };
+
+  void SetUp() override {
+    abnet::error_code ec;
+    std::memset(&recv_addr, 0, sizeof(recv_addr));
+    recv_addr.sin_family = AF_INET;
+    abnet::socket_ops::inet_pton(ABNET_OS_DEF(AF_INET), "127.0.0.1", &recv_addr.sin_addr, 0, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("inet_pton failed with error: ") << ec.message();
+    send_addr = recv_addr;
+
+    receiver = abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_DGRAM), ABNET_OS_DEF(IPPROTO_UDP), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("socket failed with error: ") << ec.message();
+    sender = abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_DGRAM), ABNET_OS_DEF(IPPROTO_UDP), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("socket failed with error: ") << ec.message();
+
+    size_t len = sizeof(recv_addr);
+    abnet::socket_ops::bind(receiver, &recv_addr, sizeof(recv_addr), ec);
+    abnet::socket_ops::getsockname(receiver, &recv_addr, &len, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("getsockname failed with error: ") << ec.message();
+    len = sizeof(send_addr);
+    abnet::socket_ops::bind(sender, &send_addr, sizeof(send_addr), ec);
+    abnet::socket_ops::getsockname(sender, &send_addr, &len, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("getsockname failed with error: ") << ec.message();
+  }
+
+  void TearDown() override {
+    abnet::error_code ec;
+    abnet::socket_ops::close(receiver, 0, false, ec);
+    abnet::socket_ops::close(sender, 0, false, ec);
+  }
+
+protected:
+  abnet::sockaddr_in4_type recv_addr;
+  abnet::sockaddr_in4_type send_addr;
+  abnet::socket_type receiver;
+  abnet::socket_type sender;
+};
+
+TEST_F(DatagramT, batch_send_and_receive) {
+  abnet::error_code ec;
+  char out[msg_count][32];
+  abnet::socket_ops::buf out_bufs[msg_count];
+  abnet::socket_ops::datagram out_msgs[msg_count];
+  for (size_t i = 0; i < msg_count; ++i) {
+    std::memset(out[i], 'a' + int(i), sizeof(out[i]));
+    abnet::socket_ops::init_buf(out_bufs[i], out[i], i + 1);
+    out_msgs[i] = abnet::socket_ops::datagram{&out_bufs[i], 1, &recv_addr, sizeof(recv_addr), 0, 0};
+  }
+
+  size_t sent = 0;
+  while (sent < msg_count && !ec)
+    sent += abnet::socket_ops::sync_sendto_batch(sender, 0, out_msgs + sent, msg_count - sent, 0, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_sendto_batch failed with error: ") << ec.message();
+  for (size_t i = 0; i < msg_count; ++i)
+    ASSERT_EQ(out_msgs[i].bytes_transferred, i + 1);
+
+  char in[msg_count][32];
+  abnet::socket_ops::buf in_bufs[msg_count];
+  abnet::sockaddr_in4_type from[msg_count];
+  abnet::socket_ops::datagram in_msgs[msg_count];
+  for (size_t i = 0; i < msg_count; ++i) {
+    abnet::socket_ops::init_buf(in_bufs[i], in[i], sizeof(in[i]));
+    in_msgs[i] = abnet::socket_ops::datagram{&in_bufs[i], 1, &from[i], sizeof(from[i]), 0, 0};
+  }
+
+  size_t received = 0;
+  while (received < msg_count && !ec)
+    received += abnet::socket_ops::sync_recvfrom_batch(receiver, 0, in_msgs + received, msg_count - received, 0, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_recvfrom_batch failed with error: ") << ec.message();
+  for (size_t i = 0; i < msg_count; ++i) {
+    ASSERT_EQ(in_msgs[i].bytes_transferred, i + 1);
+    ASSERT_EQ(in_msgs[i].addrlen, sizeof(send_addr));
+    ASSERT_EQ(from[i].sin_port, send_addr.sin_port);
+    ASSERT_EQ(std::memcmp(in[i], out[i], i + 1), 0);
+  }
+
+  // The socket has been drained.
+  abnet::socket_ops::state_type state = 0;
+  abnet::socket_ops::set_user_non_blocking(receiver, state, true, ec);
+  size_t messages = 0;
+  ASSERT_FALSE(abnet::socket_ops::non_blocking_recvfrom_batch(receiver, in_msgs, msg_count, 0, ec, messages));
+  ASSERT_TRUE(ec == abnet::error::would_block || ec == abnet::error::try_again);
+}
+
+#if defined(UDP_SEGMENT) && defined(UDP_GRO)
+
+TEST_F(DatagramT, gso_send_and_gro_receive) {
+  enum { segment_size = 1000, segment_count = 32 };
+  abnet::error_code ec;
+  int one = 1;
+  abnet::socket_ops::setsockopt(receiver, 0, SOL_UDP, UDP_GRO, &one, sizeof(one), ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("setsockopt failed with error: ") << ec.message();
+
+  std::vector<char> out(segment_size * segment_count);
+  for (size_t i = 0; i < out.size(); ++i)
+    out[i] = char(i / segment_size);
+  abnet::socket_ops::buf out_buf;
+  abnet::socket_ops::init_buf(out_buf, out.data(), out.size());
+  size_t sent = abnet::socket_ops::sync_sendto_segmented(sender, 0, &out_buf, 1, 0, &recv_addr, sizeof(recv_addr),
+                                                         segment_size, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_sendto_segmented failed with error: ") << ec.message();
+  ASSERT_EQ(sent, out.size());
+
+  // However the kernel coalesced them, each datagram keeps its boundary.
+  std::vector<char> in(out.size());
+  size_t received = 0;
+  while (received < in.size()) {
+    abnet::socket_ops::buf in_buf;
+    abnet::socket_ops::init_buf(in_buf, in.data() + received, in.size() - received);
+    size_t segment = 0;
+    size_t bytes =
+        abnet::socket_ops::sync_recvfrom_coalesced(receiver, 0, &in_buf, 1, 0, nullptr, nullptr, segment, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_recvfrom_coalesced failed with error: ") << ec.message();
+    ASSERT_EQ(segment, size_t(segment_size));
+    ASSERT_EQ(bytes % segment_size, 0u);
+    received += bytes;
+  }
+  ASSERT_EQ(in, out);
+}
+
+TEST_F(DatagramT, segmentation_offload_pps_vs_sendto1) {
+  enum { segment_size = 1000, segment_count = 32, rounds = 256 };
+  const size_t datagrams = size_t(segment_count) * rounds;
+  abnet::error_code ec;
+  std::vector<char> payload(segment_size * segment_count, 'x');
+  abnet::socket_ops::buf payload_buf;
+  abnet::socket_ops::init_buf(payload_buf, payload.data(), payload.size());
+
+  // Send side. The receiver is not drained, so only the sender's cost counts.
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < datagrams; ++i)
+    abnet::socket_ops::sync_sendto1(sender, 0, payload.data(), segment_size, 0, &recv_addr, sizeof(recv_addr), ec);
+  double sendto1_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_sendto1 failed with error: ") << ec.message();
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; ++i)
+    abnet::socket_ops::sync_sendto_segmented(sender, 0, &payload_buf, 1, 0, &recv_addr, sizeof(recv_addr),
+                                             segment_size, ec);
+  double gso_sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_sendto_segmented failed with error: ") << ec.message();
+
+  // Receive side. Each round queues one run of datagrams and times only the
+  // drain, first one datagram per call and then coalesced.
+  abnet::socket_ops::state_type state = 0;
+  abnet::socket_ops::set_user_non_blocking(receiver, state, true, ec);
+  std::vector<char> in(payload.size());
+  abnet::socket_ops::buf in_buf;
+  abnet::socket_ops::init_buf(in_buf, in.data(), in.size());
+  double recv_sec[2] = {0, 0};
+  size_t recv_count[2] = {0, 0};
+  for (int gro = 0; gro < 2; ++gro) {
+    abnet::socket_ops::setsockopt(receiver, 0, SOL_UDP, UDP_GRO, &gro, sizeof(gro), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("setsockopt failed with error: ") << ec.message();
+    size_t bytes = 0, segment = 0;
+    while (abnet::socket_ops::non_blocking_recvfrom_coalesced(receiver, &in_buf, 1, 0, nullptr, nullptr, segment, ec,
+                                                              bytes) &&
+           !ec) {
+    }
+    for (size_t i = 0; i < rounds; ++i) {
+      abnet::socket_ops::sync_sendto_segmented(sender, 0, &payload_buf, 1, 0, &recv_addr, sizeof(recv_addr),
+                                               segment_size, ec);
+      start = std::chrono::steady_clock::now();
+      for (;;) {
+        if (gro) {
+          if (!abnet::socket_ops::non_blocking_recvfrom_coalesced(receiver, &in_buf, 1, 0, nullptr, nullptr, segment,
+                                                                  ec, bytes) ||
+              ec)
+            break;
+          recv_count[gro] += (bytes + segment - 1) / segment;
+        } else {
+          if (!abnet::socket_ops::non_blocking_recvfrom1(receiver, in.data(), in.size(), 0, nullptr, nullptr, ec,
+                                                         bytes) ||
+              ec)
+            break;
+          ++recv_count[gro];
+        }
+      }
+      recv_sec[gro] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+  }
+  ASSERT_GT(recv_count[0], 0u);
+  ASSERT_GT(recv_count[1], 0u);
+
+  std::printf("udp loopback, %d byte datagrams: send sendto1 %.0f pps, gso %.0f pps; "
+              "receive recvfrom1 %.0f pps, gro %.0f pps\n",
+              int(segment_size), datagrams / sendto1_sec, datagrams / gso_sec, recv_count[0] / recv_sec[0],
+              recv_count[1] / recv_sec[1]);
+}
+
+#endif // defined(UDP_SEGMENT) && defined(UDP_GRO)
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/dns_cache.hpp"
+#include "dns_stub_server.hpp"
+#include "test_util.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using dns_stub::stub_dns_server;
+
+class DnsCacheT : public ::testing::Test {
+public:
+  void SetUp() override {
+    abnet::error_code ec;
+    std::unique_ptr<abnet::dns_resolver> resolver(new abnet::dns_resolver);
+    resolver->add_nameserver("127.0.0.1", server.port(), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("add_nameserver failed with error: ") << ec.message();
+    cache.reset(new abnet::dns_cache(std::move(resolver), ec));
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("dns_cache failed with error: ") << ec.message();
+  }
+
+  static abnet::addrinfo_type make_hints(int family, int socktype) {
+    abnet::addrinfo_type hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = family;
+    hints.ai_socktype = socktype;
+    return hints;
+  }
+
+  // Wait for the server to have seen count queries.
+  bool wait_for_queries(int count) {
+    for (int i = 0; i < 200 && server.queries() < count; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return server.queries() == count;
+  }
+
+protected:
+  stub_dns_server server;
+  std::unique_ptr<abnet::dns_cache> cache;
+};
+
+TEST_F(DnsCacheT, hit_shares_the_cached_answer) {
+  abnet::error_code ec;
+  abnet::addrinfo_type hints = make_hints(AF_INET, SOCK_STREAM);
+  abnet::dns_cache::result_type first = cache->resolve("edge.example.test", "443", hints, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("resolve failed with error: ") << ec.message();
+  ASSERT_TRUE(first);
+  ASSERT_EQ(first->ai_family, AF_INET);
+
+  // Names are compared without regard to case.
+  abnet::dns_cache::result_type second = cache->resolve("EDGE.example.test", "443", hints, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("resolve failed with error: ") << ec.message();
+  ASSERT_EQ(first.get(), second.get());
+  ASSERT_EQ(cache->misses(), 1u);
+  ASSERT_EQ(cache->hits(), 1u);
+  ASSERT_EQ(server.queries(), 1);
+
+  // Other hints or another service are another entry.
+  cache->resolve("edge.example.test", "443", make_hints(AF_INET, SOCK_DGRAM), ec);
+  cache->resolve("edge.example.test", "80", hints, ec);
+  ASSERT_EQ(cache->misses(), 3u);
+  ASSERT_EQ(cache->size(), 3u);
+  ASSERT_EQ(server.queries(), 3);
+}
+
+TEST_F(DnsCacheT, nxdomain_is_cached) {
+  abnet::error_code ec;
+  abnet::addrinfo_type hints = make_hints(AF_INET, SOCK_STREAM);
+  ASSERT_FALSE(cache->resolve("missing.example.test", 0, hints, ec));
+  ASSERT_EQ(ec, abnet::error::host_not_found);
+  ASSERT_FALSE(cache->resolve("missing.example.test", 0, hints, ec));
+  ASSERT_EQ(ec, abnet::error::host_not_found);
+  ASSERT_EQ(cache->negative_hits(), 1u);
+  ASSERT_EQ(server.queries(), 1);
+
+  // Without a negative TTL the answer is not kept.
+  cache->set_limits(abnet::dns_cache::default_max_entries, abnet::dns_cache::default_max_ttl, 0);
+  cache->clear();
+  cache->resolve("missing.example.test", 0, hints, ec);
+  cache->resolve("missing.example.test", 0, hints, ec);
+  ASSERT_EQ(ec, abnet::error::host_not_found);
+  ASSERT_EQ(server.queries(), 3);
+}
+
+TEST_F(DnsCacheT, entry_expires_with_its_ttl) {
+  abnet::error_code ec;
+  abnet::addrinfo_type hints = make_hints(AF_INET, SOCK_STREAM);
+  cache->set_refresh(100, 1000);
+  ASSERT_TRUE(cache->resolve("short.example.test", 0, hints, ec));
+  ASSERT_TRUE(cache->resolve("short.example.test", 0, hints, ec));
+  ASSERT_EQ(server.queries(), 1);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  ASSERT_TRUE(cache->resolve("short.example.test", 0, hints, ec));
+  ASSERT_EQ(cache->misses(), 2u);
+  ASSERT_EQ(server.queries(), 2);
+}
+
+TEST_F(DnsCacheT, popular_entry_refreshed_in_background) {
+  abnet::error_code ec;
+  abnet::addrinfo_type hints = make_hints(AF_INET, SOCK_STREAM);
+
+  // Refresh as soon as an entry has been hit twice.
+  cache->set_refresh(0, 2);
+  abnet::dns_cache::result_type first = cache->resolve("edge.example.test", 0, hints, ec);
+  cache->resolve("edge.example.test", 0, hints, ec);
+  ASSERT_EQ(cache->refreshes(), 0u);
+  abnet::dns_cache::result_type hit = cache->resolve("edge.example.test", 0, hints, ec);
+  ASSERT_EQ(hit.get(), first.get());
+  ASSERT_EQ(cache->refreshes(), 1u);
+  ASSERT_TRUE(wait_for_queries(2));
+
+  // The refreshed answer replaces the old one without a miss.
+  abnet::dns_cache::result_type refreshed;
+  for (int i = 0; i < 200 && (!refreshed || refreshed.get() == first.get()); ++i) {
+    refreshed = cache->resolve("edge.example.test", 0, hints, ec);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_NE(refreshed.get(), first.get());
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("resolve failed with error: ") << ec.message();
+  ASSERT_EQ(cache->misses(), 1u);
+}
+
+TEST_F(DnsCacheT, concurrent_misses_share_a_query) {
+  enum { thread_count = 8 };
+  abnet::addrinfo_type hints = make_hints(AF_UNSPEC, SOCK_STREAM);
+  std::vector<abnet::dns_cache::result_type> results(thread_count);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < thread_count; ++i)
+    threads.push_back(std::thread([&, i] {
+      abnet::error_code ec;
+      results[i] = cache->resolve("www.example.test", "443", hints, ec);
+    }));
+  for (int i = 0; i < thread_count; ++i)
+    threads[i].join();
+
+  for (int i = 0; i < thread_count; ++i) {
+    ASSERT_TRUE(results[i]);
+    ASSERT_EQ(results[i].get(), results[0].get());
+  }
+  ASSERT_EQ(cache->hits() + cache->misses(), std::size_t(thread_count));
+
+  // One A and one AAAA query.
+  ASSERT_EQ(server.queries(), 2);
+}
+
+TEST_F(DnsCacheT, least_recently_used_evicted) {
+  abnet::error_code ec;
+  abnet::addrinfo_type hints = make_hints(AF_INET, SOCK_STREAM);
+  cache->set_limits(2, abnet::dns_cache::default_max_ttl, abnet::dns_cache::default_max_negative_ttl);
+  cache->resolve("edge.example.test", 0, hints, ec);
+  cache->resolve("noedns.example.test", 0, hints, ec);
+  cache->resolve("edge.example.test", 0, hints, ec);
+  cache->resolve("big.example.test", 0, hints, ec);
+  ASSERT_EQ(cache->size(), 2u);
+  ASSERT_EQ(cache->evictions(), 1u);
+
+  // The entry used last survived.
+  std::size_t misses = cache->misses();
+  cache->resolve("edge.example.test", 0, hints, ec);
+  ASSERT_EQ(cache->misses(), misses);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,279 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/dns_resolver.hpp"
+#include "dns_stub_server.hpp"
+#include "test_util.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using dns_stub::stub_dns_server;
+
+namespace {
+
+struct outcome {
+  outcome() : done(false), result(0), ttl(0) {}
+  ~outcome() { abnet::dns_resolver::freeaddrinfo(result); }
+
+  abnet::dns_resolver::handler_type handler() {
+    return [this](const abnet::error_code &e, abnet::addrinfo_type *r, uint32_t t) {
+      done = true;
+      ec = e;
+      result = r;
+      ttl = t;
+    };
+  }
+
+  std::size_t count() const {
+    std::size_t n = 0;
+    for (abnet::addrinfo_type *ai = result; ai; ai = ai->ai_next)
+      ++n;
+    return n;
+  }
+
+  bool done;
+  abnet::error_code ec;
+  abnet::addrinfo_type *result;
+  uint32_t ttl;
+};
+
+abnet::addrinfo_type make_hints(int family, int socktype, int flags = 0) {
+  abnet::addrinfo_type hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = family;
+  hints.ai_socktype = socktype;
+  hints.ai_flags = flags;
+  return hints;
+}
+
+} // namespace
+
+TEST(DnsResolverT, follows_cname_to_a_and_aaaa) {
+  stub_dns_server server;
+  abnet::dns_resolver resolver;
+  abnet::error_code ec;
+  resolver.add_nameserver("127.0.0.1", server.port(), ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("add_nameserver failed with error: ") << ec.message();
+
+  outcome out;
+  resolver.async_resolve("WWW.example.test.", "8080", make_hints(AF_UNSPEC, SOCK_STREAM, AI_CANONNAME),
+                         out.handler());
+  ASSERT_EQ(resolver.outstanding(), 1u);
+  ASSERT_EQ(resolver.run(ec), 1u);
+  ASSERT_TRUE(out.done);
+  ASSERT_EQ(out.ec.value(), 0) << ERRMSG("resolve failed with error: ") << out.ec.message();
+
+  // The A record comes first and the TTL is the smallest along the chain.
+  ASSERT_EQ(out.count(), 2u);
+  ASSERT_EQ(out.ttl, 60u);
+  ASSERT_STREQ(out.result->ai_canonname, "edge.example.test");
+  ASSERT_EQ(out.result->ai_family, AF_INET);
+  ASSERT_EQ(out.result->ai_socktype, SOCK_STREAM);
+  const abnet::sockaddr_in4_type *v4 = reinterpret_cast<const abnet::sockaddr_in4_type *>(out.result->ai_addr);
+  ASSERT_EQ(v4->sin_addr.s_addr, abnet::socket_ops::host_to_network_long(0xc000020a));
+  ASSERT_EQ(abnet::socket_ops::network_to_host_short(v4->sin_port), 8080);
+  abnet::addrinfo_type *next = out.result->ai_next;
+  ASSERT_EQ(next->ai_family, AF_INET6);
+  const abnet::sockaddr_in6_type *v6 = reinterpret_cast<const abnet::sockaddr_in6_type *>(next->ai_addr);
+  ASSERT_EQ(v6->sin6_addr.s6_addr[0], 0x20);
+  ASSERT_EQ(v6->sin6_addr.s6_addr[15], 0x10);
+
+  ASSERT_EQ(server.queries(), 2);
+  ASSERT_EQ(server.edns_queries(), 2);
+  ASSERT_EQ(resolver.queries_sent(), 2u);
+  ASSERT_EQ(resolver.retries(), 0u);
+  ASSERT_EQ(resolver.outstanding(), 0u);
+}
+
+TEST(DnsResolverT, moves_past_a_silent_server) {
+  stub_dns_server server;
+  abnet::error_code ec;
+
+  // A bound socket that never answers.
+  abnet::sockaddr_in4_type addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = abnet::socket_ops::host_to_network_long(0x7f000001);
+  abnet::socket_type silent = abnet::socket_ops::socket(AF_INET, SOCK_DGRAM, 0, ec);
+  abnet::socket_ops::bind(silent, &addr, sizeof(addr), ec);
+  std::size_t len = sizeof(addr);
+  abnet::socket_ops::getsockname(silent, &addr, &len, ec);
+
+  abnet::dns_resolver resolver;
+  resolver.add_nameserver("127.0.0.1", abnet::socket_ops::network_to_host_short(addr.sin_port), ec);
+  resolver.add_nameserver("127.0.0.1", server.port(), ec);
+  resolver.set_timeout(100);
+
+  outcome out;
+  resolver.async_resolve("edge.example.test", 0, make_hints(AF_INET, SOCK_DGRAM), out.handler());
+  resolver.run(ec);
+  ASSERT_EQ(out.ec.value(), 0) << ERRMSG("resolve failed with error: ") << out.ec.message();
+  ASSERT_EQ(out.count(), 1u);
+  ASSERT_EQ(out.ttl, 60u);
+  ASSERT_EQ(resolver.timeouts(), 1u);
+  ASSERT_EQ(resolver.retries(), 1u);
+  ASSERT_EQ(resolver.queries_sent(), 2u);
+
+  // With every try used up the failure is transient.
+  abnet::dns_resolver lonely;
+  lonely.add_nameserver("127.0.0.1", abnet::socket_ops::network_to_host_short(addr.sin_port), ec);
+  lonely.set_timeout(20);
+  lonely.set_attempts(2);
+  outcome failed;
+  lonely.async_resolve("edge.example.test", 0, make_hints(AF_INET, 0), failed.handler());
+  lonely.run(ec);
+  ASSERT_EQ(failed.ec, abnet::error::host_not_found_try_again);
+  ASSERT_EQ(failed.ttl, 0u);
+  ASSERT_EQ(lonely.timeouts(), 2u);
+  abnet::socket_ops::close(silent, 0, false, ec);
+}
+
+TEST(DnsResolverT, truncated_answer_retried_over_tcp) {
+  stub_dns_server server;
+  abnet::dns_resolver resolver;
+  abnet::error_code ec;
+  resolver.add_nameserver("127.0.0.1", server.port(), ec);
+
+  outcome out;
+  resolver.async_resolve("big.example.test", "53", make_hints(AF_INET, 0), out.handler());
+  resolver.run(ec);
+  ASSERT_EQ(out.ec.value(), 0) << ERRMSG("resolve failed with error: ") << out.ec.message();
+
+  // Without a socket type there is an entry for each.
+  ASSERT_EQ(out.count(), 2u);
+  ASSERT_EQ(out.result->ai_socktype, SOCK_STREAM);
+  ASSERT_EQ(out.result->ai_next->ai_socktype, SOCK_DGRAM);
+  ASSERT_EQ(out.ttl, 30u);
+  ASSERT_EQ(resolver.tcp_fallbacks(), 1u);
+  ASSERT_EQ(server.tcp_queries(), 1);
+}
+
+TEST(DnsResolverT, truncated_tcp_answer_is_not_empty_answer) {
+  stub_dns_server server;
+  abnet::dns_resolver resolver;
+  abnet::error_code ec;
+  resolver.add_nameserver("127.0.0.1", server.port(), ec);
+
+  // A reply still truncated over TCP carries no answers, which must not be
+  // read as the name having no records.
+  outcome out;
+  resolver.async_resolve("huge.example.test", 0, make_hints(AF_INET, SOCK_STREAM), out.handler());
+  resolver.run(ec);
+  ASSERT_EQ(out.ec, abnet::error::no_recovery);
+  ASSERT_EQ(out.result, nullptr);
+  ASSERT_GE(resolver.tcp_fallbacks(), 1u);
+  ASSERT_GE(server.tcp_queries(), 1);
+}
+
+TEST(DnsResolverT, formerr_retried_without_edns) {
+  stub_dns_server server;
+  abnet::dns_resolver resolver;
+  abnet::error_code ec;
+  resolver.add_nameserver("127.0.0.1", server.port(), ec);
+
+  outcome out;
+  resolver.async_resolve("noedns.example.test", 0, make_hints(AF_INET, SOCK_STREAM), out.handler());
+  resolver.run(ec);
+  ASSERT_EQ(out.ec.value(), 0) << ERRMSG("resolve failed with error: ") << out.ec.message();
+  ASSERT_EQ(out.ttl, 90u);
+  ASSERT_EQ(resolver.retries(), 1u);
+  ASSERT_EQ(server.edns_queries(), 1);
+  ASSERT_EQ(server.queries(), 2);
+}
+
+TEST(DnsResolverT, nxdomain_carries_negative_ttl) {
+  stub_dns_server server;
+  abnet::dns_resolver resolver;
+  abnet::error_code ec;
+  resolver.add_nameserver("127.0.0.1", server.port(), ec);
+
+  outcome out;
+  resolver.async_resolve("missing.example.test", 0, make_hints(AF_UNSPEC, SOCK_STREAM), out.handler());
+  resolver.run(ec);
+  ASSERT_EQ(out.ec, abnet::error::host_not_found);
+  ASSERT_EQ(out.result, nullptr);
+  ASSERT_EQ(out.ttl, 45u);
+
+  // A name with no records of the type asked for.
+  outcome empty;
+  resolver.async_resolve("big.example.test", 0, make_hints(AF_INET6, SOCK_STREAM), empty.handler());
+  resolver.run(ec);
+  ASSERT_EQ(empty.ec, abnet::error::no_data);
+}
+
+TEST(DnsResolverT, numeric_host_and_cancel) {
+  abnet::dns_resolver resolver;
+  abnet::error_code ec;
+
+  outcome numeric;
+  resolver.async_resolve("192.0.2.1", "80", make_hints(AF_UNSPEC, 0), numeric.handler());
+  ASSERT_FALSE(numeric.done);
+  ASSERT_EQ(resolver.timeout_msec(), 0);
+  ASSERT_EQ(resolver.process(), 1u);
+  ASSERT_EQ(numeric.ec.value(), 0) << ERRMSG("resolve failed with error: ") << numeric.ec.message();
+  ASSERT_EQ(numeric.count(), 2u);
+  ASSERT_EQ(numeric.ttl, abnet::dns_resolver::literal_ttl);
+  ASSERT_EQ(resolver.queries_sent(), 0u);
+
+  outcome unreachable;
+  resolver.async_resolve("edge.example.test", 0, make_hints(AF_INET, 0), unreachable.handler());
+  ASSERT_EQ(unreachable.ec.value(), 0);
+  resolver.process();
+  ASSERT_EQ(unreachable.ec, abnet::error::host_not_found_try_again);
+
+  // A cancelled resolution completes on the next process().
+  stub_dns_server server;
+  resolver.add_nameserver("127.0.0.1", server.port(), ec);
+  outcome cancelled;
+  resolver.async_resolve("www.example.test", 0, make_hints(AF_UNSPEC, 0), cancelled.handler());
+  std::vector<pollfd> fds;
+  ASSERT_EQ(resolver.fill_pollfds(fds), 2u);
+  resolver.cancel();
+  ASSERT_EQ(resolver.outstanding(), 1u);
+  resolver.process();
+  ASSERT_EQ(cancelled.ec, abnet::error::operation_aborted);
+  ASSERT_EQ(resolver.outstanding(), 0u);
+}
+
+TEST(DnsResolverT, reads_resolv_conf) {
+  char path[] = "/tmp/abnet_resolv_XXXXXX";
+  int fd = ::mkstemp(path);
+  ASSERT_GE(fd, 0);
+  const char contents[] = "# comment\n"
+                          "search example.test\n"
+                          "nameserver 127.0.0.1\n"
+                          "nameserver not-an-address\n"
+                          "nameserver ::1\n"
+                          "options ndots:1 timeout:3 attempts:4\n";
+  ASSERT_EQ(::write(fd, contents, sizeof(contents) - 1), ssize_t(sizeof(contents) - 1));
+  ::close(fd);
+
+  abnet::dns_resolver resolver;
+  abnet::error_code ec;
+  resolver.load_resolv_conf(path, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("load_resolv_conf failed with error: ") << ec.message();
+  ASSERT_EQ(resolver.nameserver_count(), 2u);
+  ASSERT_EQ(resolver.timeout(), 3000);
+  ASSERT_EQ(resolver.attempts(), 4);
+
+  // Without nameserver lines the local server is assumed.
+  FILE *f = std::fopen(path, "w");
+  std::fputs("options attempts:1\n", f);
+  std::fclose(f);
+  abnet::dns_resolver fallback;
+  fallback.load_resolv_conf(path, ec);
+  ASSERT_EQ(fallback.nameserver_count(), 1u);
+  ::unlink(path);
+
+  fallback.load_resolv_conf("/nonexistent/resolv.conf", ec);
+  ASSERT_TRUE(ec);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,224 @@
+#ifndef DNS_STUB_SERVER
+#define DNS_STUB_SERVER
+
+#include "abnet/abnet.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace dns_stub {
+
+inline void put16(std::string &out, unsigned value) {
+  out += char(value >> 8);
+  out += char(value);
+}
+
+inline void put32(std::string &out, uint32_t value) {
+  put16(out, value >> 16);
+  put16(out, value & 0xffff);
+}
+
+inline void put_name(std::string &out, const std::string &name) {
+  std::size_t start = 0;
+  while (start < name.size()) {
+    std::size_t dot = name.find('.', start);
+    if (dot == std::string::npos)
+      dot = name.size();
+    out += char(dot - start);
+    out += name.substr(start, dot - start);
+    start = dot + 1;
+  }
+  out += char(0);
+}
+
+inline void put_record(std::string &out, const std::string &owner, unsigned type, uint32_t ttl,
+                       const std::string &rdata) {
+  if (owner.empty()) {
+    // Point back at the question name.
+    out += char(0xc0);
+    out += char(12);
+  } else {
+    put_name(out, owner);
+  }
+  put16(out, type);
+  put16(out, 1);
+  put32(out, ttl);
+  put16(out, rdata.size());
+  out += rdata;
+}
+
+inline std::string name_rdata(const std::string &name) {
+  std::string rdata;
+  put_name(rdata, name);
+  return rdata;
+}
+
+// A loopback DNS server answering from a fixed zone over UDP and TCP on the
+// same port.
+class stub_dns_server {
+public:
+  stub_dns_server() : stop_(false), queries_(0), edns_queries_(0), tcp_queries_(0) {
+    abnet::error_code ec;
+    abnet::sockaddr_in4_type addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = abnet::socket_ops::host_to_network_long(0x7f000001);
+    udp_ = abnet::socket_ops::socket(AF_INET, SOCK_DGRAM, 0, ec);
+    abnet::socket_ops::bind(udp_, &addr, sizeof(addr), ec);
+    std::size_t len = sizeof(addr);
+    abnet::socket_ops::getsockname(udp_, &addr, &len, ec);
+    port_ = abnet::socket_ops::network_to_host_short(addr.sin_port);
+
+    tcp_ = abnet::socket_ops::socket(AF_INET, SOCK_STREAM, 0, ec);
+    int on = 1;
+    ::setsockopt(tcp_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    abnet::socket_ops::bind(tcp_, &addr, sizeof(addr), ec);
+    ::listen(tcp_, 4);
+    thread_ = std::thread([this] { serve(); });
+  }
+
+  ~stub_dns_server() {
+    stop_ = true;
+    thread_.join();
+    abnet::error_code ec;
+    abnet::socket_ops::close(udp_, 0, false, ec);
+    abnet::socket_ops::close(tcp_, 0, false, ec);
+  }
+
+  unsigned short port() const { return port_; }
+  int queries() const { return queries_; }
+  int edns_queries() const { return edns_queries_; }
+  int tcp_queries() const { return tcp_queries_; }
+
+private:
+  void serve() {
+    while (!stop_) {
+      pollfd fds[2] = {{udp_, POLLIN, 0}, {tcp_, POLLIN, 0}};
+      if (::poll(fds, 2, 20) <= 0)
+        continue;
+      if (fds[0].revents & POLLIN) {
+        char query[512];
+        abnet::sockaddr_in4_type from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = ::recvfrom(udp_, query, sizeof(query), 0, reinterpret_cast<sockaddr *>(&from), &from_len);
+        if (n > 0) {
+          std::string response = answer(std::string(query, n), false);
+          ::sendto(udp_, response.data(), response.size(), 0, reinterpret_cast<sockaddr *>(&from), from_len);
+        }
+      }
+      if (fds[1].revents & POLLIN) {
+        int s = ::accept(tcp_, 0, 0);
+        unsigned char length[2];
+        char query[512];
+        if (::recv(s, length, 2, MSG_WAITALL) == 2) {
+          std::size_t size = length[0] << 8 | length[1];
+          if (size <= sizeof(query) && ::recv(s, query, size, MSG_WAITALL) == ssize_t(size)) {
+            std::string response;
+            put16(response, 0);
+            response += answer(std::string(query, size), true);
+            response[0] = char((response.size() - 2) >> 8);
+            response[1] = char(response.size() - 2);
+            ::send(s, response.data(), response.size(), MSG_NOSIGNAL);
+          }
+        }
+        ::close(s);
+      }
+    }
+  }
+
+  std::string answer(const std::string &query, bool tcp) {
+    ++queries_;
+    if (tcp)
+      ++tcp_queries_;
+    bool edns = query[11] == 1;
+    if (edns)
+      ++edns_queries_;
+
+    std::string name;
+    std::size_t pos = 12;
+    while (query[pos]) {
+      if (!name.empty())
+        name += '.';
+      name += query.substr(pos + 1, query[pos]);
+      pos += query[pos] + 1;
+    }
+    unsigned type = (unsigned char)query[pos + 1] << 8 | (unsigned char)query[pos + 2];
+    std::string question = query.substr(12, pos + 5 - 12);
+
+    unsigned rcode = 0;
+    bool truncated = false;
+    std::vector<std::string> answers;
+    std::vector<std::string> authority;
+    std::string record;
+    if (name == "www.example.test") {
+      put_record(record, "", 5, 300, name_rdata("edge.example.test"));
+      answers.push_back(record);
+      name = "edge.example.test";
+    }
+    if (name == "edge.example.test" && type == 1) {
+      record.clear();
+      put_record(record, name, 1, 60, std::string("\xc0\x00\x02\x0a", 4));
+      answers.push_back(record);
+    } else if (name == "edge.example.test" && type == 28) {
+      record.clear();
+      put_record(record, name, 28, 120, std::string("\x20\x01\x0d\xb8", 4) + std::string(11, '\0') + "\x10");
+      answers.push_back(record);
+    } else if (name == "big.example.test" && type == 1) {
+      truncated = !tcp;
+      if (tcp) {
+        put_record(record, "", 1, 30, std::string("\xc0\x00\x02\x14", 4));
+        answers.push_back(record);
+      }
+    } else if (name == "huge.example.test" && type == 1) {
+      // Too big even for TCP.
+      truncated = true;
+    } else if (name == "noedns.example.test" && edns) {
+      rcode = 1;
+    } else if (name == "noedns.example.test" && type == 1) {
+      put_record(record, "", 1, 90, std::string("\xc0\x00\x02\x1e", 4));
+      answers.push_back(record);
+    } else if (name == "short.example.test" && type == 1) {
+      put_record(record, "", 1, 1, std::string("\xc0\x00\x02\x28", 4));
+      answers.push_back(record);
+    } else if (name == "missing.example.test") {
+      rcode = 3;
+      std::string soa = name_rdata("ns.example.test") + name_rdata("admin.example.test");
+      for (uint32_t field : {1u, 7200u, 900u, 1209600u, 45u})
+        put32(soa, field);
+      put_record(record, "example.test", 6, 3600, soa);
+      authority.push_back(record);
+    }
+
+    std::string response;
+    response += query.substr(0, 2);
+    put16(response, 0x8180 | (truncated ? 0x0200 : 0) | rcode);
+    put16(response, 1);
+    put16(response, answers.size());
+    put16(response, authority.size());
+    put16(response, 0);
+    response += question;
+    for (std::size_t i = 0; i < answers.size(); ++i)
+      response += answers[i];
+    for (std::size_t i = 0; i < authority.size(); ++i)
+      response += authority[i];
+    return response;
+  }
+
+  abnet::socket_type udp_;
+  abnet::socket_type tcp_;
+  unsigned short port_;
+  std::thread thread_;
+  std::atomic<bool> stop_;
+  std::atomic<int> queries_;
+  std::atomic<int> edns_queries_;
+  std::atomic<int> tcp_queries_;
+};
+
+} // namespace dns_stub
+
+#endif // DNS_STUB_SERVER
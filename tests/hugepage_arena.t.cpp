@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/hugepage_arena.hpp"
+#include "test_util.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <vector>
+
+TEST(HugepageArenaT, buffers_come_from_aligned_regions) {
+  abnet::error_code ec;
+  abnet::hugepage_arena arena(16000, ec, 1, false);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("hugepage_arena failed with error: ") << ec.message();
+  ASSERT_EQ(arena.buffer_size(), 16000u);
+
+  // One 2MB region holds 131 buffers of 16000 bytes; the next one needs
+  // another region.
+  const size_t per_region = abnet::hugepage_arena::huge_page_size / 16000;
+  std::vector<void *> bufs;
+  for (size_t i = 0; i <= per_region; ++i) {
+    bufs.push_back(arena.allocate(ec));
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("allocate failed with error: ") << ec.message();
+    std::memset(bufs.back(), int(i), arena.buffer_size());
+  }
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(bufs[0]) % abnet::hugepage_arena::huge_page_size, 0u);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(bufs[per_region]) % abnet::hugepage_arena::huge_page_size, 0u);
+  ASSERT_EQ(arena.regions(), 2u);
+  ASSERT_EQ(arena.bytes_mapped(), 2u * abnet::hugepage_arena::huge_page_size);
+  ASSERT_EQ(arena.fallbacks(), 2u);
+  ASSERT_EQ(arena.hugetlb_pages(), 0u);
+  ASSERT_EQ(arena.advised_pages() + arena.advise_failures(), 2u);
+  ASSERT_EQ(arena.buffers_in_use(), per_region + 1);
+
+  // Released buffers are reused before the arena grows again.
+  arena.deallocate(bufs[5]);
+  ASSERT_EQ(arena.allocate(ec), bufs[5]);
+  for (void *p : bufs)
+    arena.deallocate(p);
+  ASSERT_EQ(arena.buffers_in_use(), 0u);
+  std::set<void *> again;
+  for (size_t i = 0; i <= per_region; ++i)
+    again.insert(arena.allocate(ec));
+  ASSERT_EQ(again, std::set<void *>(bufs.begin(), bufs.end()));
+  ASSERT_EQ(arena.regions(), 2u);
+}
+
+TEST(HugepageArenaT, hugetlb_or_fallback) {
+  abnet::error_code ec;
+  abnet::hugepage_arena arena(65536, ec);
+  void *p = arena.allocate(ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("allocate failed with error: ") << ec.message();
+
+  // Without reserved huge pages the region falls back to MADV_HUGEPAGE.
+  const size_t pages = abnet::hugepage_arena::default_region_pages;
+  if (arena.fallbacks() == 0)
+    ASSERT_EQ(arena.hugetlb_pages(), pages);
+  else
+    ASSERT_EQ(arena.advised_pages() + arena.advise_failures() * pages, pages);
+
+  abnet::socket_type pair[2];
+  abnet::socket_ops::socketpair(AF_UNIX, SOCK_STREAM, 0, pair, ec);
+  abnet::socket_ops::buf b;
+  abnet::socket_ops::init_buf(b, p, 5);
+  std::memcpy(p, "hello", 5);
+  ASSERT_EQ(abnet::socket_ops::sync_send(pair[0], 0, &b, 1, 0, false, ec), 5u);
+  char in[5];
+  ASSERT_EQ(abnet::socket_ops::sync_recv1(pair[1], abnet::socket_ops::stream_oriented, in, 5, 0, ec), 5u);
+  ASSERT_EQ(std::memcmp(in, "hello", 5), 0);
+  arena.deallocate(p);
+  abnet::socket_ops::close(pair[0], 0, false, ec);
+  abnet::socket_ops::close(pair[1], 0, false, ec);
+}
+
+TEST(HugepageArenaT, rejects_buffers_larger_than_a_region) {
+  abnet::error_code ec;
+  abnet::hugepage_arena arena(3 * abnet::hugepage_arena::huge_page_size, ec, 1);
+  ASSERT_EQ(ec, abnet::error::invalid_argument);
+  ASSERT_EQ(arena.allocate(ec), nullptr);
+  ASSERT_EQ(ec, abnet::error::invalid_argument);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,339 @@
+#include <gtest/gtest.h>
+
+#define ABNET_HAS_IO_URING 1
+#include "abnet/abnet.hpp"
+#include "abnet/io_uring_buffer_ring.hpp"
+#include "abnet/io_uring_proactor.hpp"
+#include "abnet/io_uring_registry.hpp"
+#include "test_util.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class IoUringProactorT : public ::testing::Test {
+public:
+  void SetUp() override {
+    abnet::error_code ec;
+    proactor.reset(new abnet::io_uring_proactor(ec));
+    if (ec)
+      GTEST_SKIP() << "io_uring unavailable: " << ec.message();
+
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    abnet::socket_ops::inet_pton(ABNET_OS_DEF(AF_INET), "127.0.0.1", &sa.sin_addr, 0, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("inet_pton failed with error: ") << ec.message();
+
+    serv_sock = abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("socket failed with error: ") << ec.message();
+    abnet::socket_ops::bind(serv_sock, &sa, sizeof(sa), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("bind failed with error: ") << ec.message();
+    abnet::socket_ops::listen(serv_sock, SOMAXCONN, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("listen failed with error: ") << ec.message();
+
+    size_t len = sizeof(sa);
+    abnet::socket_ops::getsockname(serv_sock, &sa, &len, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("getsockname failed with error: ") << ec.message();
+  }
+
+  void TearDown() override {
+    abnet::error_code ec;
+    if (serv_sock != abnet::invalid_socket)
+      abnet::socket_ops::close(serv_sock, 0, 0, ec);
+  }
+
+protected:
+  std::unique_ptr<abnet::io_uring_proactor> proactor;
+  abnet::sockaddr_in4_type sa;
+  abnet::socket_type serv_sock = abnet::invalid_socket;
+};
+
+struct uring_session {
+  abnet::socket_type sock = abnet::invalid_socket;
+  char data_buf[16] = {0};
+  abnet::socket_ops::buf buf;
+};
+
+TEST_F(IoUringProactorT, echo_with_batched_submission) {
+  const size_t conn_count = 32;
+  abnet::error_code ec;
+  std::vector<std::unique_ptr<uring_session>> servers;
+  std::vector<std::unique_ptr<uring_session>> clients;
+  size_t accepted = 0;
+  size_t echoed = 0;
+
+  std::function<void(const abnet::error_code &, abnet::socket_type)> on_accept;
+  on_accept = [&](const abnet::error_code &aec, abnet::socket_type s) {
+    ASSERT_EQ(aec.value(), 0) << ERRMSG("accept failed with error: ") << aec.message();
+    servers.emplace_back(new uring_session);
+    uring_session *sess = servers.back().get();
+    sess->sock = s;
+    abnet::socket_ops::init_buf(sess->buf, sess->data_buf, 5);
+    proactor->async_recvmsg(s, &sess->buf, 1, 0, true, [&, sess](const abnet::error_code &e, size_t n) {
+      ASSERT_EQ(e.value(), 0) << ERRMSG("recvmsg failed with error: ") << e.message();
+      abnet::socket_ops::init_buf(sess->buf, sess->data_buf, n);
+      proactor->async_sendmsg(sess->sock, &sess->buf, 1, 0, [](const abnet::error_code &se, size_t) {
+        ASSERT_EQ(se.value(), 0) << ERRMSG("sendmsg failed with error: ") << se.message();
+      });
+    });
+    if (++accepted < conn_count)
+      proactor->async_accept(serv_sock, nullptr, nullptr, on_accept);
+  };
+  proactor->async_accept(serv_sock, nullptr, nullptr, on_accept);
+
+  for (size_t i = 0; i < conn_count; ++i) {
+    clients.emplace_back(new uring_session);
+    uring_session *sess = clients.back().get();
+    sess->sock = abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("socket failed with error: ") << ec.message();
+
+    proactor->async_connect(sess->sock, &sa, sizeof(sa), [&, sess](const abnet::error_code &cec) {
+      ASSERT_EQ(cec.value(), 0) << ERRMSG("connect failed with error: ") << cec.message();
+      std::memcpy(sess->data_buf, "ping", 5);
+      abnet::socket_ops::init_buf(sess->buf, sess->data_buf, 5);
+      proactor->async_sendmsg(sess->sock, &sess->buf, 1, 0, [&, sess](const abnet::error_code &se, size_t) {
+        ASSERT_EQ(se.value(), 0) << ERRMSG("sendmsg failed with error: ") << se.message();
+        std::memset(sess->data_buf, 0, sizeof(sess->data_buf));
+        abnet::socket_ops::init_buf(sess->buf, sess->data_buf, 5);
+        proactor->async_recvmsg(sess->sock, &sess->buf, 1, 0, true,
+                                [&, sess](const abnet::error_code &re, size_t n) {
+                                  ASSERT_EQ(re.value(), 0) << ERRMSG("recvmsg failed with error: ") << re.message();
+                                  ASSERT_EQ(n, 5u);
+                                  ASSERT_STREQ(sess->data_buf, "ping");
+                                  ++echoed;
+                                });
+      });
+    });
+  }
+
+  proactor->run(ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("run failed with error: ") << ec.message();
+  ASSERT_EQ(accepted, conn_count);
+  ASSERT_EQ(echoed, conn_count);
+
+  // Connects issued back to back share a single io_uring_enter.
+  ASSERT_GT(proactor->sqes_submitted(), proactor->enter_calls());
+
+  for (auto *sessions : {&servers, &clients})
+    for (auto &sess : *sessions)
+      abnet::socket_ops::close(sess->sock, 0, false, ec);
+}
+
+TEST_F(IoUringProactorT, run_one_times_out) {
+  abnet::error_code ec;
+  abnet::error_code accept_ec;
+  bool called = false;
+  proactor->async_accept(serv_sock, nullptr, nullptr, [&](const abnet::error_code &e, abnet::socket_type) {
+    accept_ec = e;
+    called = true;
+  });
+  ASSERT_EQ(proactor->run_one(10, ec), 0u);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("run_one failed with error: ") << ec.message();
+  ASSERT_FALSE(called);
+
+  // Complete the pending accept so the proactor can be destroyed cleanly.
+  abnet::socket_type client = abnet::socket_ops::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP, ec);
+  abnet::socket_ops::connect(client, &sa, sizeof(sa), ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("connect failed with error: ") << ec.message();
+  proactor->run(ec);
+  ASSERT_TRUE(called);
+  ASSERT_EQ(accept_ec.value(), 0);
+  abnet::socket_ops::close(client, 0, false, ec);
+}
+
+TEST_F(IoUringProactorT, run_one_timeout_does_not_outlive_its_wait) {
+  abnet::error_code ec;
+  std::vector<abnet::socket_type> accepted;
+  auto on_accept = [&](const abnet::error_code &e, abnet::socket_type s) {
+    if (!e)
+      accepted.push_back(s);
+  };
+
+  // A completion ends the first wait long before its timeout.
+  abnet::socket_type client = abnet::socket_ops::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP, ec);
+  abnet::socket_ops::connect(client, &sa, sizeof(sa), ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("connect failed with error: ") << ec.message();
+  proactor->async_accept(serv_sock, nullptr, nullptr, on_accept);
+  ASSERT_EQ(proactor->run_one(200, ec), 1u);
+  ASSERT_EQ(accepted.size(), 1u);
+
+  // The first wait's timeout must not end the second one early.
+  proactor->async_accept(serv_sock, nullptr, nullptr, on_accept);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  ASSERT_EQ(proactor->run_one(400, ec), 0u);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("run_one failed with error: ") << ec.message();
+  ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(400));
+
+  abnet::socket_type second = abnet::socket_ops::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP, ec);
+  abnet::socket_ops::connect(second, &sa, sizeof(sa), ec);
+  proactor->run(ec);
+  ASSERT_EQ(accepted.size(), 2u);
+  for (abnet::socket_type s : accepted)
+    abnet::socket_ops::close(s, 0, false, ec);
+  abnet::socket_ops::close(client, 0, false, ec);
+  abnet::socket_ops::close(second, 0, false, ec);
+}
+
+TEST_F(IoUringProactorT, multishot_accept_batches) {
+  const size_t conn_count = 16;
+  abnet::error_code ec;
+
+  std::vector<abnet::socket_type> clients;
+  for (size_t i = 0; i < conn_count; ++i) {
+    clients.push_back(abnet::socket_ops::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP, ec));
+    abnet::socket_ops::connect(clients.back(), &sa, sizeof(sa), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("connect failed with error: ") << ec.message();
+  }
+
+  std::vector<abnet::socket_type> accepted;
+  size_t wakeups = 0;
+  abnet::error_code final_ec;
+  abnet::io_uring_op *op = nullptr;
+  op = proactor->async_multishot_accept(
+      serv_sock, [&](const abnet::error_code &e, abnet::socket_type *sockets, size_t count) {
+        if (e) {
+          final_ec = e;
+          return;
+        }
+        ++wakeups;
+        accepted.insert(accepted.end(), sockets, sockets + count);
+        if (accepted.size() == conn_count)
+          proactor->cancel_op(op);
+      });
+  proactor->run(ec);
+  if (final_ec == abnet::error::invalid_argument)
+    GTEST_SKIP() << "multishot accept unsupported by this kernel";
+
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("run failed with error: ") << ec.message();
+  ASSERT_EQ(final_ec, abnet::error::operation_aborted);
+  ASSERT_EQ(accepted.size(), conn_count);
+  ASSERT_LT(wakeups, conn_count);
+
+  for (abnet::socket_type s : accepted)
+    abnet::socket_ops::close(s, 0, false, ec);
+  for (abnet::socket_type s : clients)
+    abnet::socket_ops::close(s, 0, false, ec);
+}
+
+TEST_F(IoUringProactorT, provided_buffers_taken_on_data_only) {
+  const size_t conn_count = 8;
+  abnet::error_code ec;
+  abnet::io_uring_buffer_ring ring(*proactor, 1, 4, 256, ec);
+  if (ec == abnet::error::invalid_argument)
+    GTEST_SKIP() << "provided buffer rings unsupported by this kernel";
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("io_uring_buffer_ring failed with error: ") << ec.message();
+
+  // Many idle receives share a pool smaller than the number of connections.
+  abnet::socket_type pairs[conn_count][2];
+  std::vector<unsigned> bids;
+  std::vector<std::string> received;
+  size_t eofs = 0;
+  for (size_t i = 0; i < conn_count; ++i) {
+    abnet::socket_ops::socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i], ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("socketpair failed with error: ") << ec.message();
+    ring.async_recv(pairs[i][0], 0, true, [&](const abnet::error_code &e, unsigned bid, size_t n) {
+      if (e == abnet::error::eof) {
+        ++eofs;
+        return;
+      }
+      ASSERT_EQ(e.value(), 0) << ERRMSG("recv failed with error: ") << e.message();
+      ASSERT_NE(bid, unsigned(abnet::io_uring_buffer_ring::no_buffer));
+      bids.push_back(bid);
+      received.emplace_back(static_cast<char *>(ring.buffer(bid)), n);
+    });
+  }
+  ASSERT_EQ(proactor->poll(ec), 0u);
+  ASSERT_EQ(ring.buffers_in_use(), 0u);
+
+  abnet::socket_ops::send1(pairs[2][1], "hello", 5, 0, ec);
+  abnet::socket_ops::send1(pairs[5][1], "world", 5, 0, ec);
+  while (received.size() < 2)
+    proactor->run_one(-1, ec);
+  ASSERT_EQ(ring.buffers_in_use(), 2u);
+  ASSERT_EQ(received[0].size() + received[1].size(), 10u);
+  for (unsigned bid : bids)
+    ring.recycle(bid);
+  ASSERT_EQ(ring.buffers_in_use(), 0u);
+
+  // Close the remaining peers so every outstanding receive completes.
+  for (size_t i = 0; i < conn_count; ++i)
+    abnet::socket_ops::close(pairs[i][1], 0, false, ec);
+  proactor->run(ec);
+  ASSERT_EQ(eofs, conn_count - 2);
+  for (size_t i = 0; i < conn_count; ++i)
+    abnet::socket_ops::close(pairs[i][0], 0, false, ec);
+}
+
+TEST_F(IoUringProactorT, registered_files_recycled_on_close) {
+  abnet::error_code ec;
+  abnet::io_uring_registry registry(*proactor, 2, 2, 4096, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("io_uring_registry failed with error: ") << ec.message();
+
+  abnet::socket_type pair[2];
+  abnet::socket_ops::socketpair(AF_UNIX, SOCK_STREAM, 0, pair, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("socketpair failed with error: ") << ec.message();
+  ASSERT_EQ(registry.register_socket(pair[0], ec), 0);
+  ASSERT_EQ(registry.register_socket(pair[1], ec), 1);
+  ASSERT_EQ(registry.register_socket(pair[1], ec), 1);
+  ASSERT_EQ(registry.slots_in_use(), 2u);
+
+  // Write from one registered buffer and read into the other.
+  unsigned out = registry.acquire_buffer();
+  unsigned in = registry.acquire_buffer();
+  ASSERT_EQ(registry.acquire_buffer(), unsigned(abnet::io_uring_registry::no_buffer));
+  std::memcpy(registry.buffer(out), "hello", 5);
+  size_t written = 0;
+  std::string received;
+  registry.async_write_fixed(pair[1], out, 0, 5, [&](const abnet::error_code &e, size_t n) {
+    ASSERT_EQ(e.value(), 0) << ERRMSG("write_fixed failed with error: ") << e.message();
+    written = n;
+  });
+  registry.async_read_fixed(pair[0], in, 16, 64, true, [&](const abnet::error_code &e, size_t n) {
+    ASSERT_EQ(e.value(), 0) << ERRMSG("read_fixed failed with error: ") << e.message();
+    received.assign(static_cast<char *>(registry.buffer(in)) + 16, n);
+  });
+  proactor->run(ec);
+  ASSERT_EQ(written, 5u);
+  ASSERT_EQ(received, "hello");
+
+  // Closing frees the slot, so the table no longer keeps the peer open.
+  abnet::socket_ops::close(pair[1], 0, false, ec);
+  ASSERT_EQ(registry.slot(pair[1]), int(abnet::io_uring_registry::no_slot));
+  ASSERT_EQ(registry.slots_in_use(), 1u);
+  ASSERT_EQ(registry.slots_recycled(), 1u);
+  abnet::error_code read_ec;
+  registry.async_read_fixed(pair[0], in, 0, 64, true, [&](const abnet::error_code &e, size_t) { read_ec = e; });
+  proactor->run(ec);
+  ASSERT_EQ(read_ec, abnet::error::eof);
+
+  // The freed slot goes to the next socket.
+  abnet::socket_type other = abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), 0, ec);
+  ASSERT_EQ(registry.register_socket(other, ec), 1);
+  ASSERT_TRUE(registry.release_socket(other, ec));
+  ASSERT_FALSE(registry.release_socket(other, ec));
+  ASSERT_EQ(ec, abnet::error::bad_descriptor);
+  ASSERT_TRUE(registry.release_buffer(out));
+  ASSERT_TRUE(registry.release_buffer(in));
+  ASSERT_EQ(registry.buffers_in_use(), 0u);
+
+  // A buffer released twice, or an index past the pool, is refused.
+  ASSERT_FALSE(registry.release_buffer(out));
+  ASSERT_FALSE(registry.release_buffer(registry.buffer_count()));
+  ASSERT_EQ(registry.buffers_in_use(), 0u);
+  unsigned first = registry.acquire_buffer();
+  unsigned second = registry.acquire_buffer();
+  ASSERT_NE(first, second);
+  ASSERT_EQ(registry.acquire_buffer(), unsigned(abnet::io_uring_registry::no_buffer));
+  ASSERT_TRUE(registry.release_buffer(first));
+  ASSERT_TRUE(registry.release_buffer(second));
+  abnet::socket_ops::close(other, 0, false, ec);
+  abnet::socket_ops::close(pair[0], 0, false, ec);
+  ASSERT_EQ(registry.slots_in_use(), 0u);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
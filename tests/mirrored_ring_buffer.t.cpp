@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/mirrored_ring_buffer.hpp"
+#include "test_util.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+TEST(MirroredRingBufferT, regions_stay_contiguous_across_the_end) {
+  abnet::error_code ec;
+  abnet::mirrored_ring_buffer ring(1, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("mirrored_ring_buffer failed with error: ") << ec.message();
+  const size_t cap = ring.capacity();
+  ASSERT_GE(cap, 4096u);
+  ASSERT_EQ(ring.space(), cap);
+
+  // Leave the head close to the end of the ring.
+  std::memset(ring.write_data(), 'a', cap - 10);
+  ring.commit(cap - 10);
+  ring.consume(cap - 20);
+  ASSERT_EQ(ring.size(), 10u);
+  ASSERT_EQ(ring.space(), cap - 10);
+
+  // A frame written across the end reads back in one piece.
+  std::string frame(100, 'x');
+  frame[0] = '<';
+  frame[99] = '>';
+  std::memcpy(ring.write_data(), frame.data(), frame.size());
+  ring.commit(frame.size());
+  ASSERT_EQ(std::string(ring.read_data() + 10, frame.size()), frame);
+
+  abnet::socket_ops::buf b = ring.readable();
+  ASSERT_EQ(b.iov_base, static_cast<const void *>(ring.read_data()));
+  ASSERT_EQ(b.iov_len, 110u);
+  ring.consume(110);
+  ASSERT_TRUE(ring.empty());
+  ASSERT_EQ(ring.space(), cap);
+}
+
+TEST(MirroredRingBufferT, frames_parsed_in_place_from_recv) {
+  abnet::error_code ec;
+  abnet::mirrored_ring_buffer ring(4096, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("mirrored_ring_buffer failed with error: ") << ec.message();
+  abnet::socket_type pair[2];
+  abnet::socket_ops::socketpair(AF_UNIX, SOCK_STREAM, 0, pair, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("socketpair failed with error: ") << ec.message();
+
+  // Length-prefixed frames whose sizes do not divide the ring, so that many
+  // of them straddle its end.
+  const size_t frame_count = 500;
+  std::vector<std::string> sent;
+  for (size_t i = 0; i < frame_count; ++i) {
+    std::string payload(1 + (i * 37) % 700, char('a' + i % 26));
+    uint16_t len = uint16_t(payload.size());
+    std::string frame(reinterpret_cast<const char *>(&len), sizeof(len));
+    frame += payload;
+    abnet::socket_ops::sync_send1(pair[0], 0, frame.data(), frame.size(), 0, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("send failed with error: ") << ec.message();
+    sent.push_back(payload);
+
+    // Drain as we go so the socket buffer never fills.
+    ring.recv(pair[1], abnet::socket_ops::stream_oriented, 0, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("recv failed with error: ") << ec.message();
+    while (ring.size() >= sizeof(len)) {
+      std::memcpy(&len, ring.read_data(), sizeof(len));
+      if (ring.size() < sizeof(len) + len)
+        break;
+      std::string payload_in(ring.read_data() + sizeof(len), len);
+      ASSERT_EQ(payload_in, sent.front());
+      sent.erase(sent.begin());
+      ring.consume(sizeof(len) + len);
+    }
+  }
+  ASSERT_TRUE(sent.empty());
+  ASSERT_TRUE(ring.empty());
+
+  abnet::socket_ops::close(pair[0], 0, false, ec);
+  abnet::socket_ops::close(pair[1], 0, false, ec);
+}
+
+TEST(MirroredRingBufferT, send_consumes_what_was_sent) {
+  abnet::error_code ec;
+  abnet::mirrored_ring_buffer ring(4096, ec);
+  abnet::socket_type pair[2];
+  abnet::socket_ops::socketpair(AF_UNIX, SOCK_STREAM, 0, pair, ec);
+  std::memcpy(ring.write_data(), "hello", 5);
+  ring.commit(5);
+  ASSERT_EQ(ring.send(pair[0], 0, 0, ec), 5u);
+  ASSERT_TRUE(ring.empty());
+
+  char in[5];
+  ASSERT_EQ(abnet::socket_ops::sync_recv1(pair[1], abnet::socket_ops::stream_oriented, in, sizeof(in), 0, ec), 5u);
+  ASSERT_EQ(std::memcmp(in, "hello", 5), 0);
+
+  ring.commit(ring.capacity());
+  ASSERT_TRUE(ring.full());
+  ring.recv(pair[1], abnet::socket_ops::stream_oriented, 0, ec);
+  ASSERT_EQ(ec, abnet::error::no_buffer_space);
+  abnet::socket_ops::close(pair[0], 0, false, ec);
+  abnet::socket_ops::close(pair[1], 0, false, ec);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
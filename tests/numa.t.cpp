@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/hugepage_arena.hpp"
+#include "abnet/numa.hpp"
+#include "test_util.hpp"
+
+#include <cstring>
+#include <vector>
+
+TEST(NumaT, parse_cpu_list) {
+  std::vector<int> cpus;
+  ASSERT_TRUE(abnet::numa_ops::parse_cpu_list("0-3,8,10-11\n", cpus));
+  ASSERT_EQ(cpus, std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  cpus.clear();
+  ASSERT_TRUE(abnet::numa_ops::parse_cpu_list("", cpus));
+  ASSERT_TRUE(cpus.empty());
+  ASSERT_FALSE(abnet::numa_ops::parse_cpu_list("3-1", cpus));
+  ASSERT_FALSE(abnet::numa_ops::parse_cpu_list("0;1", cpus));
+}
+
+TEST(NumaT, host_topology_covers_current_cpu) {
+  abnet::numa_topology topology;
+  ASSERT_GE(topology.node_count(), 1u);
+  int cpu = abnet::numa_topology::current_cpu();
+  ASSERT_GE(cpu, 0);
+  int node = topology.node_of_cpu(cpu);
+  ASSERT_GE(node, 0);
+  ASSERT_EQ(topology.node_of_cpu(-1), -1);
+
+  // An arena bound to the current node keeps working whether or not the
+  // kernel supports binding.
+  abnet::error_code ec;
+  abnet::hugepage_arena arena(4096, ec, 1, false, node);
+  void *p = arena.allocate(ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("allocate failed with error: ") << ec.message();
+  std::memset(p, 1, 4096);
+  ASSERT_EQ(arena.node(), node);
+  ASSERT_LE(arena.bind_failures(), 1u);
+  arena.deallocate(p);
+}
+
+TEST(NumaT, router_prefers_the_receiving_node) {
+  // CPUs 0-1 on node 0, 2-3 on node 1 and 4 on node 3, which has no workers.
+  abnet::numa_topology topology(std::vector<int>({0, 0, 1, 1, 3}));
+  ASSERT_EQ(topology.nodes(), std::vector<int>({0, 1, 3}));
+  abnet::numa_router router(topology, std::vector<int>({0, 1, 0, 1}));
+
+  ASSERT_EQ(router.route_cpu(2), 1u);
+  ASSERT_EQ(router.route_cpu(3), 3u);
+  ASSERT_EQ(router.route_cpu(2), 1u);
+  ASSERT_EQ(router.route_cpu(0), 0u);
+  ASSERT_EQ(router.route_cpu(1), 2u);
+  ASSERT_EQ(router.local(1), 3u);
+  ASSERT_EQ(router.local(0), 2u);
+
+  // Connections from a node without workers, or from an unknown CPU, take
+  // turns across every worker.
+  ASSERT_EQ(router.route_cpu(4), 0u);
+  ASSERT_EQ(router.route_cpu(-1), 1u);
+  ASSERT_EQ(router.route_cpu(99), 2u);
+  ASSERT_EQ(router.remote(3), 1u);
+  ASSERT_EQ(router.unknown(), 2u);
+  ASSERT_EQ(router.served(0), 4u);
+  ASSERT_EQ(router.served(1), 4u);
+  ASSERT_EQ(router.served(3), 0u);
+}
+
+TEST(NumaT, routes_accepted_sockets_by_incoming_cpu) {
+  abnet::error_code ec;
+  abnet::sockaddr_in4_type sa;
+  std::memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  abnet::socket_ops::inet_pton(ABNET_OS_DEF(AF_INET), "127.0.0.1", &sa.sin_addr, 0, ec);
+  abnet::socket_type listener =
+      abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+  abnet::socket_ops::bind(listener, &sa, sizeof(sa), ec);
+  abnet::socket_ops::listen(listener, 1, ec);
+  size_t len = sizeof(sa);
+  abnet::socket_ops::getsockname(listener, &sa, &len, ec);
+  abnet::socket_type client =
+      abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+  abnet::socket_ops::connect(client, &sa, sizeof(sa), ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("connect failed with error: ") << ec.message();
+  abnet::socket_type accepted = abnet::socket_ops::accept(listener, nullptr, nullptr, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("accept failed with error: ") << ec.message();
+
+  int cpu = abnet::socket_ops::incoming_cpu(accepted, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("incoming_cpu failed with error: ") << ec.message();
+  abnet::numa_topology topology;
+  std::vector<int> worker_nodes(topology.nodes());
+  abnet::numa_router router(topology, worker_nodes);
+  size_t worker = router.route(accepted);
+  ASSERT_LT(worker, router.worker_count());
+  if (cpu >= 0) {
+    ASSERT_EQ(worker_nodes[worker], topology.node_of_cpu(cpu));
+    ASSERT_EQ(router.local(topology.node_of_cpu(cpu)), 1u);
+  } else {
+    ASSERT_EQ(router.unknown(), 1u);
+  }
+
+  abnet::socket_ops::close(accepted, 0, false, ec);
+  abnet::socket_ops::close(client, 0, false, ec);
+  abnet::socket_ops::close(listener, 0, false, ec);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
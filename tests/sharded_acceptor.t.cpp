@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/sharded_acceptor.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+TEST(ShardedAcceptorT, connections_spread_across_shards) {
+  const size_t shard_count = 4;
+  const size_t conn_count = 200;
+  abnet::error_code ec;
+  abnet::sockaddr_in4_type sa;
+  std::memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  abnet::socket_ops::inet_pton(ABNET_OS_DEF(AF_INET), "127.0.0.1", &sa.sin_addr, 0, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("inet_pton failed with error: ") << ec.message();
+
+  abnet::sharded_acceptor acceptor(&sa, sizeof(sa), shard_count, SOMAXCONN, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sharded_acceptor failed with error: ") << ec.message();
+  ASSERT_EQ(acceptor.size(), shard_count);
+
+  // Every listener shares the ephemeral port chosen for the first one.
+  size_t len = sizeof(sa);
+  acceptor.local_endpoint(&sa, &len, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("local_endpoint failed with error: ") << ec.message();
+  for (size_t i = 1; i < shard_count; ++i) {
+    abnet::sockaddr_in4_type other;
+    len = sizeof(other);
+    abnet::socket_ops::getsockname(acceptor.listener(i), &other, &len, ec);
+    ASSERT_EQ(other.sin_port, sa.sin_port);
+  }
+
+  std::atomic<size_t> accepted(0);
+  std::atomic<size_t> wrong_thread(0);
+  std::vector<std::thread::id> shard_threads(shard_count);
+  acceptor.start([&](size_t shard, abnet::socket_type s) {
+    if (shard_threads[shard] == std::thread::id())
+      shard_threads[shard] = std::this_thread::get_id();
+    else if (shard_threads[shard] != std::this_thread::get_id())
+      ++wrong_thread;
+    abnet::error_code cec;
+    abnet::socket_ops::close(s, 0, false, cec);
+    ++accepted;
+  });
+
+  std::vector<abnet::socket_type> clients;
+  for (size_t i = 0; i < conn_count; ++i) {
+    clients.push_back(abnet::socket_ops::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP, ec));
+    abnet::socket_ops::connect(clients.back(), &sa, sizeof(sa), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("connect failed with error: ") << ec.message();
+  }
+  while (accepted.load() < conn_count)
+    std::this_thread::yield();
+  acceptor.stop();
+
+  size_t total = 0;
+  size_t busy_shards = 0;
+  for (size_t i = 0; i < shard_count; ++i) {
+    total += acceptor.accepted(i);
+    busy_shards += acceptor.accepted(i) > 0;
+  }
+  ASSERT_EQ(total, conn_count);
+  ASSERT_GT(busy_shards, 1u);
+  ASSERT_EQ(wrong_thread.load(), 0u);
+
+  for (abnet::socket_type s : clients)
+    abnet::socket_ops::close(s, 0, false, ec);
+}
+
+TEST(ShardedAcceptorT, backs_off_when_descriptors_run_out) {
+  abnet::error_code ec;
+  abnet::sockaddr_in4_type sa;
+  std::memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  abnet::socket_ops::inet_pton(ABNET_OS_DEF(AF_INET), "127.0.0.1", &sa.sin_addr, 0, ec);
+  abnet::sharded_acceptor acceptor(&sa, sizeof(sa), 1, SOMAXCONN, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sharded_acceptor failed with error: ") << ec.message();
+  size_t len = sizeof(sa);
+  acceptor.local_endpoint(&sa, &len, ec);
+
+  std::atomic<size_t> accepted(0);
+  acceptor.start([&](size_t, abnet::socket_type s) {
+    abnet::error_code cec;
+    abnet::socket_ops::close(s, 0, false, cec);
+    ++accepted;
+  });
+
+  // Cap the descriptor limit at the lowest free descriptor, so the client can
+  // connect but the acceptor has nowhere to put the new socket.
+  abnet::socket_type client = abnet::socket_ops::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("socket failed with error: ") << ec.message();
+  rlimit old_limit;
+  ASSERT_EQ(::getrlimit(RLIMIT_NOFILE, &old_limit), 0);
+  int lowest_free = ::dup(0);
+  ASSERT_GE(lowest_free, 0);
+  ::close(lowest_free);
+  rlimit limit = old_limit;
+  limit.rlim_cur = lowest_free;
+  ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &limit), 0);
+
+  abnet::socket_ops::connect(client, &sa, sizeof(sa), ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("connect failed with error: ") << ec.message();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  size_t errors = acceptor.accept_errors(0);
+  ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &old_limit), 0);
+
+  // The errors are counted, at roughly one per back off rather than a spin.
+  ASSERT_GT(errors, 0u);
+  ASSERT_LE(errors, size_t(200 / abnet::sharded_acceptor::backoff_msec + 5));
+  ASSERT_EQ(accepted.load(), 0u);
+
+  // The connection is accepted once descriptors are available again.
+  while (accepted.load() < 1)
+    std::this_thread::yield();
+  acceptor.stop();
+  ASSERT_EQ(acceptor.accepted(0), 1u);
+  abnet::socket_ops::close(client, 0, false, ec);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/splice_relay.hpp"
+#include "test_util.hpp"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+class SpliceRelayT : public ::testing::Test {
+public:
+  void SetUp() override {
+    connect_pair(client, relay_a);
+    connect_pair(relay_b, server);
+  }
+
+  void TearDown() override {
+    abnet::error_code ec;
+    abnet::socket_ops::close(client, 0, false, ec);
+    abnet::socket_ops::close(relay_a, 0, false, ec);
+    abnet::socket_ops::close(relay_b, 0, false, ec);
+    abnet::socket_ops::close(server, 0, false, ec);
+  }
+
+  static void connect_pair(abnet::socket_type &connector, abnet::socket_type &acceptor) {
+    abnet::error_code ec;
+    abnet::sockaddr_in4_type sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    abnet::socket_ops::inet_pton(ABNET_OS_DEF(AF_INET), "127.0.0.1", &sa.sin_addr, 0, ec);
+    abnet::socket_type listener =
+        abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+    abnet::socket_ops::bind(listener, &sa, sizeof(sa), ec);
+    abnet::socket_ops::listen(listener, 1, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("listen failed with error: ") << ec.message();
+    size_t len = sizeof(sa);
+    abnet::socket_ops::getsockname(listener, &sa, &len, ec);
+    connector = abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+    abnet::socket_ops::connect(connector, &sa, sizeof(sa), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("connect failed with error: ") << ec.message();
+    acceptor = abnet::socket_ops::accept(listener, nullptr, nullptr, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("accept failed with error: ") << ec.message();
+    abnet::socket_ops::close(listener, 0, false, ec);
+  }
+
+  // Read until the peer shuts down.
+  static std::vector<char> read_to_eof(abnet::socket_type s) {
+    abnet::error_code ec;
+    std::vector<char> data;
+    char chunk[16384];
+    for (;;) {
+      size_t n = abnet::socket_ops::sync_recv1(s, abnet::socket_ops::stream_oriented, chunk, sizeof(chunk), 0, ec);
+      if (ec)
+        break;
+      data.insert(data.end(), chunk, chunk + n);
+    }
+    EXPECT_EQ(ec, abnet::error::eof);
+    return data;
+  }
+
+protected:
+  abnet::socket_type client;
+  abnet::socket_type relay_a;
+  abnet::socket_type relay_b;
+  abnet::socket_type server;
+};
+
+TEST_F(SpliceRelayT, sync_relay_forwards_half_closes) {
+  abnet::error_code ec;
+  abnet::splice_relay relay(relay_a, relay_b, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("splice_relay failed with error: ") << ec.message();
+  abnet::error_code relay_ec;
+  std::thread relay_thread([&] { relay.sync_relay(relay_ec); });
+
+  // The server answers only once the request has been closed, so the reply
+  // travels back over a half-closed connection.
+  std::vector<char> request(4 * 1024 * 1024);
+  for (size_t i = 0; i < request.size(); ++i)
+    request[i] = char(i * 31);
+  const char reply[] = "received";
+  std::vector<char> received;
+  std::thread server_thread([&] {
+    received = read_to_eof(server);
+    abnet::error_code sec;
+    abnet::socket_ops::sync_send1(server, 0, reply, sizeof(reply), 0, sec);
+    abnet::socket_ops::shutdown(server, ABNET_OS_DEF(SHUT_WR), sec);
+  });
+
+  for (size_t n = 0; n < request.size() && !ec;)
+    n += abnet::socket_ops::sync_send1(client, 0, request.data() + n, request.size() - n, 0, ec);
+  abnet::socket_ops::shutdown(client, ABNET_OS_DEF(SHUT_WR), ec);
+  std::vector<char> response = read_to_eof(client);
+
+  server_thread.join();
+  relay_thread.join();
+  ASSERT_EQ(relay_ec.value(), 0) << ERRMSG("sync_relay failed with error: ") << relay_ec.message();
+  ASSERT_TRUE(relay.done());
+  ASSERT_EQ(received, request);
+  ASSERT_EQ(response, std::vector<char>(reply, reply + sizeof(reply)));
+  ASSERT_EQ(relay.bytes_relayed(abnet::splice_relay::a_to_b), request.size());
+  ASSERT_EQ(relay.bytes_relayed(abnet::splice_relay::b_to_a), sizeof(reply));
+}
+
+TEST_F(SpliceRelayT, non_blocking_relay_moves_what_is_ready) {
+  abnet::error_code ec;
+  abnet::splice_relay relay(relay_a, relay_b, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("splice_relay failed with error: ") << ec.message();
+
+  // Nothing to move yet.
+  ASSERT_FALSE(relay.non_blocking_relay(ec));
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("non_blocking_relay failed with error: ") << ec.message();
+  ASSERT_EQ(relay.poll_events(relay_a), POLLIN);
+
+  const char ping[] = "ping";
+  abnet::socket_ops::sync_send1(client, 0, ping, sizeof(ping), 0, ec);
+  while (relay.bytes_relayed(abnet::splice_relay::a_to_b) < sizeof(ping))
+    ASSERT_FALSE(relay.non_blocking_relay(ec));
+  char in[sizeof(ping)];
+  ASSERT_EQ(abnet::socket_ops::sync_recv1(server, abnet::socket_ops::stream_oriented, in, sizeof(in), 0, ec),
+            sizeof(in));
+  ASSERT_EQ(std::memcmp(in, ping, sizeof(ping)), 0);
+
+  // Closing both ends finishes the relay.
+  abnet::socket_ops::shutdown(client, ABNET_OS_DEF(SHUT_WR), ec);
+  abnet::socket_ops::shutdown(server, ABNET_OS_DEF(SHUT_WR), ec);
+  while (!relay.non_blocking_relay(ec)) {
+  }
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("non_blocking_relay failed with error: ") << ec.message();
+  ASSERT_EQ(relay.bytes_relayed(abnet::splice_relay::b_to_a), 0u);
+}
+
+TEST_F(SpliceRelayT, closed_destination_fails_without_sigpipe) {
+  // Relay into one end of a socketpair, whose writes fail with EPIPE once the
+  // other end is closed.
+  abnet::error_code ec;
+  abnet::socket_type pair[2];
+  abnet::socket_ops::socketpair(AF_UNIX, SOCK_STREAM, 0, pair, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("socketpair failed with error: ") << ec.message();
+  abnet::splice_relay relay(relay_a, pair[0], ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("splice_relay failed with error: ") << ec.message();
+
+  const char ping[] = "ping";
+  abnet::socket_ops::sync_send1(client, 0, ping, sizeof(ping), 0, ec);
+  while (relay.bytes_relayed(abnet::splice_relay::a_to_b) < sizeof(ping))
+    ASSERT_FALSE(relay.non_blocking_relay(ec));
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("non_blocking_relay failed with error: ") << ec.message();
+
+  // SIGPIPE keeps its default action, so raising it would end the test.
+  abnet::socket_ops::close(pair[1], 0, false, ec);
+  abnet::socket_ops::sync_send1(client, 0, ping, sizeof(ping), 0, ec);
+  while (!relay.non_blocking_relay(ec)) {
+  }
+  ASSERT_EQ(ec, abnet::error::broken_pipe);
+
+  sigset_t pending;
+  ASSERT_EQ(::sigpending(&pending), 0);
+  ASSERT_EQ(sigismember(&pending, SIGPIPE), 0);
+  abnet::socket_ops::close(pair[0], 0, false, ec);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
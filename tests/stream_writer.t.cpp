@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/stream_writer.hpp"
+#include "test_util.hpp"
+
+#include <cstring>
+#include <string>
+
+class StreamWriterT : public ::testing::Test {
+public:
+  void SetUp() override {
+    abnet::error_code ec;
+    abnet::sockaddr_in4_type sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    abnet::socket_ops::inet_pton(ABNET_OS_DEF(AF_INET), "127.0.0.1", &sa.sin_addr, 0, ec);
+    abnet::socket_type listener =
+        abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+    abnet::socket_ops::bind(listener, &sa, sizeof(sa), ec);
+    abnet::socket_ops::listen(listener, 1, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("listen failed with error: ") << ec.message();
+    size_t len = sizeof(sa);
+    abnet::socket_ops::getsockname(listener, &sa, &len, ec);
+    client = abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+    abnet::socket_ops::connect(client, &sa, sizeof(sa), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("connect failed with error: ") << ec.message();
+    server = abnet::socket_ops::accept(listener, nullptr, nullptr, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("accept failed with error: ") << ec.message();
+    abnet::socket_ops::close(listener, 0, false, ec);
+  }
+
+  void TearDown() override {
+    abnet::error_code ec;
+    abnet::socket_ops::close(client, 0, false, ec);
+    abnet::socket_ops::close(server, 0, false, ec);
+  }
+
+  std::string receive(size_t size) {
+    abnet::error_code ec;
+    std::string data(size, '\0');
+    for (size_t n = 0; n < size && !ec;)
+      n += abnet::socket_ops::sync_recv1(server, abnet::socket_ops::stream_oriented, &data[n], size - n, 0, ec);
+    return data;
+  }
+
+protected:
+  abnet::socket_type client;
+  abnet::socket_type server;
+};
+
+TEST_F(StreamWriterT, small_writes_share_one_send) {
+  abnet::error_code ec;
+  abnet::stream_writer writer(client, abnet::socket_ops::stream_oriented);
+  const char *parts[] = {"HTTP/1.1 200 OK\r\n", "Content-Type: text/plain\r\n", "Content-Length: 5\r\n", "\r\n",
+                         "hello"};
+  std::string expected;
+  for (const char *part : parts) {
+    ASSERT_TRUE(writer.write(part, std::strlen(part), ec));
+    expected += part;
+  }
+  ASSERT_EQ(writer.sends(), 0u);
+  ASSERT_EQ(writer.queued_buffers(), 5u);
+  ASSERT_EQ(writer.queued_bytes(), expected.size());
+
+  ASSERT_TRUE(writer.flush(ec));
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("flush failed with error: ") << ec.message();
+  ASSERT_EQ(writer.sends(), 1u);
+  ASSERT_EQ(writer.flushes(), 1u);
+  ASSERT_EQ(writer.average_buffers_per_flush(), 5.0);
+  ASSERT_EQ(writer.queued_bytes(), 0u);
+  ASSERT_EQ(receive(expected.size()), expected);
+}
+
+TEST_F(StreamWriterT, threshold_and_full_queue_flush) {
+  abnet::error_code ec;
+  char chunk[10];
+  std::memset(chunk, 'c', sizeof(chunk));
+
+  // Every tenth write reaches the threshold.
+  abnet::stream_writer by_size(client, abnet::socket_ops::stream_oriented, 100);
+  for (size_t i = 0; i < 30; ++i)
+    ASSERT_TRUE(by_size.write(chunk, sizeof(chunk), ec));
+  ASSERT_EQ(by_size.flushes(), 3u);
+  ASSERT_EQ(by_size.queued_bytes(), 0u);
+  ASSERT_TRUE(by_size.flush(ec));
+  ASSERT_EQ(by_size.flushes(), 3u);
+  ASSERT_EQ(receive(300), std::string(300, 'c'));
+
+  // The queue fills up before the threshold is reached.
+  abnet::stream_writer by_count(client, abnet::socket_ops::stream_oriented, 1 << 20);
+  for (size_t i = 0; i < abnet::stream_writer::max_buffers + 1; ++i)
+    ASSERT_TRUE(by_count.write(chunk, 1, ec));
+  ASSERT_EQ(by_count.flushes(), 1u);
+  ASSERT_EQ(by_count.queued_buffers(), 1u);
+  ASSERT_TRUE(by_count.flush(ec));
+  ASSERT_EQ(by_count.buffers_flushed(), size_t(abnet::stream_writer::max_buffers + 1));
+  ASSERT_EQ(receive(abnet::stream_writer::max_buffers + 1), std::string(abnet::stream_writer::max_buffers + 1, 'c'));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,240 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/epoll_reactor.hpp"
+#include "abnet/thread_pool.hpp"
+#include "test_util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static void wait_until(const std::atomic<size_t> &counter, size_t value) {
+  while (counter.load() < value)
+    std::this_thread::yield();
+}
+
+TEST(ThreadPoolT, affine_work_stays_on_home_worker) {
+  const size_t task_count = 1000;
+  abnet::thread_pool pool(4);
+  std::atomic<size_t> done(0);
+  std::atomic<size_t> misplaced(0);
+  for (size_t i = 0; i < task_count; ++i) {
+    size_t home = i % pool.size();
+    pool.post_affine(home, [&, home] {
+      if (pool.current_worker() != home)
+        ++misplaced;
+      ++done;
+    });
+  }
+  wait_until(done, task_count);
+  ASSERT_EQ(misplaced.load(), 0u);
+  ASSERT_EQ(pool.current_worker(), size_t(abnet::thread_pool::not_a_worker));
+}
+
+TEST(ThreadPoolT, idle_workers_steal_spawned_work) {
+  const size_t task_count = 512;
+  abnet::thread_pool pool(4);
+  std::atomic<size_t> done(0);
+
+  // All the work is spawned onto a single worker's deque, which it fits in.
+  pool.post_affine(0, [&] {
+    for (size_t i = 0; i < task_count; ++i)
+      pool.post([&] {
+        std::chrono::steady_clock::time_point until = std::chrono::steady_clock::now() + std::chrono::microseconds(100);
+        while (std::chrono::steady_clock::now() < until) {
+        }
+        ++done;
+      });
+  });
+  wait_until(done, task_count);
+
+  size_t executed = 0;
+  size_t steals = 0;
+  for (size_t i = 0; i < pool.size(); ++i) {
+    executed += pool.executed(i);
+    steals += pool.steals(i);
+  }
+  ASSERT_GE(executed, task_count);
+  ASSERT_GT(steals, 0u);
+  ASSERT_LT(pool.executed(0), executed);
+}
+
+class ThreadPoolBenchT : public ::testing::Test {
+public:
+  enum { conn_count = 32, rounds = 200, msg_size = 64 };
+
+  void SetUp() override {
+    abnet::error_code ec;
+    abnet::sockaddr_in4_type sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    abnet::socket_ops::inet_pton(ABNET_OS_DEF(AF_INET), "127.0.0.1", &sa.sin_addr, 0, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("inet_pton failed with error: ") << ec.message();
+    abnet::socket_type serv_sock =
+        abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("socket failed with error: ") << ec.message();
+    abnet::socket_ops::bind(serv_sock, &sa, sizeof(sa), ec);
+    abnet::socket_ops::listen(serv_sock, SOMAXCONN, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("listen failed with error: ") << ec.message();
+    size_t len = sizeof(sa);
+    abnet::socket_ops::getsockname(serv_sock, &sa, &len, ec);
+
+    for (size_t i = 0; i < conn_count; ++i) {
+      clients[i] = abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+      abnet::socket_ops::connect(clients[i], &sa, sizeof(sa), ec);
+      ASSERT_EQ(ec.value(), 0) << ERRMSG("connect failed with error: ") << ec.message();
+      servers[i] = abnet::socket_ops::accept(serv_sock, nullptr, nullptr, ec);
+      ASSERT_EQ(ec.value(), 0) << ERRMSG("accept failed with error: ") << ec.message();
+    }
+    abnet::socket_ops::close(serv_sock, 0, false, ec);
+  }
+
+  void TearDown() override {
+    abnet::error_code ec;
+    for (size_t i = 0; i < conn_count; ++i) {
+      abnet::socket_ops::close(clients[i], 0, false, ec);
+      abnet::socket_ops::close(servers[i], 0, false, ec);
+    }
+  }
+
+  // Drive every connection through the given number of request/response
+  // rounds from a single client thread. Returns the elapsed milliseconds.
+  double drive_clients() {
+    abnet::error_code ec;
+    char msg[msg_size];
+    std::memset(msg, 'x', sizeof(msg));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+      for (size_t i = 0; i < conn_count; ++i)
+        abnet::socket_ops::sync_send1(clients[i], 0, msg, sizeof(msg), 0, ec);
+      for (size_t i = 0; i < conn_count; ++i)
+        recv_exactly(clients[i], msg, sizeof(msg), ec);
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  static void recv_exactly(abnet::socket_type s, char *data, size_t size, abnet::error_code &ec) {
+    for (size_t n = 0; n < size && !ec;)
+      n += abnet::socket_ops::sync_recv1(s, abnet::socket_ops::stream_oriented, data + n, size - n, 0, ec);
+  }
+
+protected:
+  abnet::socket_type clients[conn_count];
+  abnet::socket_type servers[conn_count];
+};
+
+struct pooled_session {
+  abnet::socket_type sock = abnet::invalid_socket;
+  abnet::socket_ops::state_type state = abnet::socket_ops::stream_oriented;
+  abnet::epoll_reactor::per_descriptor_data data = nullptr;
+  size_t home = 0;
+  size_t rounds = 0;
+  size_t received = 0;
+  char in[ThreadPoolBenchT::msg_size];
+  char out[ThreadPoolBenchT::msg_size];
+  abnet::socket_ops::buf buf;
+};
+
+TEST_F(ThreadPoolBenchT, loopback_echo_pool_vs_thread_per_connection) {
+  abnet::error_code ec;
+
+  // One blocking thread per connection.
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < conn_count; ++i)
+    threads.emplace_back([this, i] {
+      abnet::error_code tec;
+      char msg[msg_size];
+      for (size_t r = 0; r < rounds && !tec; ++r) {
+        recv_exactly(servers[i], msg, sizeof(msg), tec);
+        abnet::socket_ops::sync_send1(servers[i], 0, msg, sizeof(msg), 0, tec);
+      }
+    });
+  double per_connection_msec = drive_clients();
+  for (std::thread &t : threads)
+    t.join();
+
+  // One reactor thread doing I/O, handlers run affine on pool workers.
+  abnet::epoll_reactor reactor(ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("epoll_reactor failed with error: ") << ec.message();
+  abnet::thread_pool pool(4);
+  std::vector<std::unique_ptr<pooled_session>> sessions;
+  size_t finished = 0;
+  std::function<void(pooled_session *)> start_recv;
+  start_recv = [&](pooled_session *sess) {
+    abnet::socket_ops::init_buf(sess->buf, sess->in + sess->received, msg_size - sess->received);
+    reactor.async_recv(sess->data, &sess->buf, 1, 0, true, [&, sess](const abnet::error_code &e, size_t n) {
+      ASSERT_EQ(e.value(), 0) << ERRMSG("recv failed with error: ") << e.message();
+      sess->received += n;
+      if (sess->received < msg_size) {
+        start_recv(sess);
+        return;
+      }
+      sess->received = 0;
+      pool.post_affine(sess->home, [&, sess] {
+        // The handler itself, away from the I/O thread.
+        std::memcpy(sess->out, sess->in, msg_size);
+        reactor.post([&, sess] {
+          abnet::socket_ops::init_buf(sess->buf, sess->out, msg_size);
+          reactor.async_send(sess->data, &sess->buf, 1, 0, [&, sess](const abnet::error_code &se, size_t) {
+            ASSERT_EQ(se.value(), 0) << ERRMSG("send failed with error: ") << se.message();
+            if (++sess->rounds < rounds)
+              start_recv(sess);
+            else if (++finished == conn_count)
+              reactor.stop();
+          });
+        });
+      });
+    });
+  };
+  for (size_t i = 0; i < conn_count; ++i) {
+    sessions.emplace_back(new pooled_session);
+    pooled_session *sess = sessions.back().get();
+    sess->sock = servers[i];
+    sess->home = i % pool.size();
+    reactor.register_descriptor(sess->sock, sess->state, sess->data, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("register_descriptor failed with error: ") << ec.message();
+    start_recv(sess);
+  }
+
+  // Posted handlers leave the reactor without outstanding operations for a
+  // moment, so keep it running with a receive that never completes.
+  abnet::socket_type guard[2];
+  abnet::socket_ops::socketpair(AF_UNIX, SOCK_STREAM, 0, guard, ec);
+  abnet::socket_ops::state_type guard_state = abnet::socket_ops::stream_oriented;
+  abnet::epoll_reactor::per_descriptor_data guard_data = nullptr;
+  reactor.register_descriptor(guard[0], guard_state, guard_data, ec);
+  char guard_byte;
+  abnet::socket_ops::buf guard_buf;
+  abnet::socket_ops::init_buf(guard_buf, &guard_byte, 1);
+  reactor.async_recv(guard_data, &guard_buf, 1, 0, true, [](const abnet::error_code &, size_t) {});
+
+  std::thread io_thread([&] {
+    abnet::error_code rec;
+    reactor.run(rec);
+  });
+  double pool_msec = drive_clients();
+  io_thread.join();
+  ASSERT_EQ(finished, size_t(conn_count));
+
+  std::printf("loopback echo, %d connections x %d rounds: thread per connection %.2f ms, work-stealing pool %.2f ms\n",
+              int(conn_count), int(rounds), per_connection_msec, pool_msec);
+
+  reactor.restart();
+  reactor.deregister_descriptor(guard[0], guard_data);
+  for (std::unique_ptr<pooled_session> &sess : sessions)
+    reactor.deregister_descriptor(sess->sock, sess->data);
+  reactor.run(ec);
+  abnet::socket_ops::close(guard[0], 0, false, ec);
+  abnet::socket_ops::close(guard[1], 0, false, ec);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
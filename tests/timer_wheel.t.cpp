@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/epoll_reactor.hpp"
+#include "abnet/timer_wheel.hpp"
+#include "test_util.hpp"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+struct deadline_session {
+  abnet::wheel_timer timer;
+  abnet::timer_wheel *wheel = nullptr;
+  std::vector<int> *fired = nullptr;
+  int id = 0;
+  uint64_t msec = 0;
+  std::chrono::steady_clock::time_point scheduled;
+  bool early = false;
+};
+
+static void schedule(deadline_session &sess, uint64_t msec) {
+  sess.msec = msec;
+  sess.scheduled = std::chrono::steady_clock::now();
+  sess.wheel->schedule(sess.timer, msec);
+}
+
+static void on_deadline(abnet::wheel_timer &, void *context) {
+  deadline_session *sess = static_cast<deadline_session *>(context);
+  sess->early = std::chrono::steady_clock::now() - sess->scheduled < std::chrono::milliseconds(sess->msec);
+  sess->fired->push_back(sess->id);
+}
+
+TEST(TimerWheelT, arm_rearm_cancel) {
+  abnet::error_code ec;
+  abnet::epoll_reactor reactor(ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("epoll_reactor failed with error: ") << ec.message();
+  abnet::timer_wheel wheel(ec, 1);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("timer_wheel failed with error: ") << ec.message();
+  reactor.register_timer_wheel(wheel, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("register_timer_wheel failed with error: ") << ec.message();
+
+  std::vector<int> fired;
+  deadline_session sessions[3];
+  for (int i = 0; i < 3; ++i) {
+    sessions[i].wheel = &wheel;
+    sessions[i].fired = &fired;
+    sessions[i].id = i;
+    sessions[i].timer.set_callback(on_deadline, &sessions[i]);
+    schedule(sessions[i], 5);
+  }
+  ASSERT_EQ(wheel.size(), 3u);
+
+  ASSERT_TRUE(wheel.cancel(sessions[1].timer));
+  ASSERT_FALSE(wheel.cancel(sessions[1].timer));
+  schedule(sessions[2], 30);
+  ASSERT_EQ(wheel.size(), 2u);
+
+  reactor.run(ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("run failed with error: ") << ec.message();
+  ASSERT_EQ(fired, (std::vector<int>{0, 2}));
+  ASSERT_EQ(wheel.size(), 0u);
+  for (deadline_session &sess : sessions) {
+    ASSERT_FALSE(sess.timer.armed());
+    ASSERT_FALSE(sess.early);
+  }
+  reactor.deregister_timer_wheel();
+}
+
+TEST(TimerWheelT, many_timers_cascade_across_levels) {
+  const int timer_count = 100000;
+  abnet::error_code ec;
+  abnet::epoll_reactor reactor(ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("epoll_reactor failed with error: ") << ec.message();
+  abnet::timer_wheel wheel(ec, 1);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("timer_wheel failed with error: ") << ec.message();
+  reactor.register_timer_wheel(wheel, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("register_timer_wheel failed with error: ") << ec.message();
+
+  // Delays beyond 256 ticks start on the second level and cascade down.
+  std::vector<int> fired;
+  std::unique_ptr<deadline_session[]> sessions(new deadline_session[timer_count]);
+  for (int i = 0; i < timer_count; ++i) {
+    sessions[i].wheel = &wheel;
+    sessions[i].fired = &fired;
+    sessions[i].id = i;
+    sessions[i].timer.set_callback(on_deadline, &sessions[i]);
+    schedule(sessions[i], i % 600);
+  }
+  int cancelled = 0;
+  for (int i = 0; i < timer_count; i += 3) {
+    wheel.cancel(sessions[i].timer);
+    ++cancelled;
+  }
+
+  reactor.run(ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("run failed with error: ") << ec.message();
+  ASSERT_EQ(fired.size(), size_t(timer_count - cancelled));
+  for (int i = 0; i < timer_count; ++i)
+    ASSERT_FALSE(sessions[i].early) << "timer " << i << " expired early";
+  reactor.deregister_timer_wheel();
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
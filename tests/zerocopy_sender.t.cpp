@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "abnet/abnet.hpp"
+#include "abnet/zerocopy_sender.hpp"
+#include "test_util.hpp"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+class ZerocopySenderT : public ::testing::Test {
+public:
+  void SetUp() override {
+    abnet::error_code ec;
+    abnet::sockaddr_in4_type sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    abnet::socket_ops::inet_pton(ABNET_OS_DEF(AF_INET), "127.0.0.1", &sa.sin_addr, 0, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("inet_pton failed with error: ") << ec.message();
+    abnet::socket_type serv_sock =
+        abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("socket failed with error: ") << ec.message();
+    abnet::socket_ops::bind(serv_sock, &sa, sizeof(sa), ec);
+    abnet::socket_ops::listen(serv_sock, SOMAXCONN, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("listen failed with error: ") << ec.message();
+    size_t len = sizeof(sa);
+    abnet::socket_ops::getsockname(serv_sock, &sa, &len, ec);
+
+    client = abnet::socket_ops::socket(AF_INET, ABNET_OS_DEF(SOCK_STREAM), ABNET_OS_DEF(IPPROTO_TCP), ec);
+    abnet::socket_ops::connect(client, &sa, sizeof(sa), ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("connect failed with error: ") << ec.message();
+    server = abnet::socket_ops::accept(serv_sock, nullptr, nullptr, ec);
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("accept failed with error: ") << ec.message();
+    abnet::socket_ops::close(serv_sock, 0, false, ec);
+  }
+
+  void TearDown() override {
+    abnet::error_code ec;
+    abnet::socket_ops::close(client, 0, false, ec);
+    abnet::socket_ops::close(server, 0, false, ec);
+  }
+
+protected:
+  abnet::socket_type client;
+  abnet::socket_type server;
+};
+
+TEST_F(ZerocopySenderT, completions_release_every_buffer) {
+  enum { chunk_size = 256 * 1024, chunk_count = 16, small_size = 100 };
+  abnet::error_code ec;
+  std::vector<char> out(chunk_size * chunk_count + small_size);
+  for (size_t i = 0; i < out.size(); ++i)
+    out[i] = char(i * 7);
+
+  // Drain the connection on another thread so that sends never stall.
+  std::vector<char> in(out.size());
+  std::thread reader([&] {
+    abnet::error_code rec;
+    for (size_t n = 0; n < in.size() && !rec;)
+      n += abnet::socket_ops::sync_recv1(server, abnet::socket_ops::stream_oriented, in.data() + n, in.size() - n, 0,
+                                         rec);
+  });
+
+  std::vector<int> completions(chunk_count + 1, 0);
+  abnet::zerocopy_sender sender(
+      client, [&](void *context, bool) { ++completions[static_cast<int *>(context) - &completions[0]]; },
+      abnet::zerocopy_sender::default_threshold, ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("zerocopy_sender failed with error: ") << ec.message();
+
+  // Each chunk keeps its own context however many sends it takes.
+  for (size_t i = 0; i < chunk_count; ++i) {
+    for (size_t n = 0; n < chunk_size && !ec;) {
+      abnet::socket_ops::buf b;
+      abnet::socket_ops::init_buf(b, out.data() + i * chunk_size + n, chunk_size - n);
+      n += sender.sync_send(0, &b, 1, 0, &completions[i], ec);
+    }
+    ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_send failed with error: ") << ec.message();
+  }
+
+  // A send below the threshold is copied and completes straight away.
+  size_t copied_before = sender.copied_sends();
+  abnet::socket_ops::buf b;
+  abnet::socket_ops::init_buf(b, out.data() + chunk_size * chunk_count, small_size);
+  ASSERT_EQ(sender.sync_send(0, &b, 1, 0, &completions[chunk_count], ec), size_t(small_size));
+  ASSERT_EQ(completions[chunk_count], 1);
+  ASSERT_EQ(sender.copied_sends(), copied_before + 1);
+
+  sender.sync_flush(ec);
+  ASSERT_EQ(ec.value(), 0) << ERRMSG("sync_flush failed with error: ") << ec.message();
+  reader.join();
+
+  ASSERT_EQ(sender.pending(), 0u);
+  if (sender.enabled()) {
+    ASSERT_GT(sender.zerocopy_sends(), 0u);
+  }
+  for (size_t i = 0; i < chunk_count; ++i)
+    ASSERT_GE(completions[i], 1);
+  ASSERT_EQ(in, out);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}